@@ -0,0 +1,78 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+struct ArenaChunk {
+    ArenaChunk *next;
+    size_t size;
+};
+
+// Chunk data starts right after the header, rounded up to ARENA_ALIGN.
+#define CHUNK_HEADER ((sizeof(ArenaChunk) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+void arena_init(Arena *arena) {
+    arena->chunks = NULL;
+    arena->ptr = arena->end = NULL;
+    arena->bytes_allocated = 0;
+}
+
+static void arena_grow(Arena *arena, size_t size) {
+    // Chunks double up to a cap so big programs need few of them; an
+    // oversized request gets a chunk of its own.
+    size_t chunk_size = arena->chunks ? arena->chunks->size * 2 : ARENA_CHUNK_SIZE;
+    if (chunk_size > 64 * ARENA_CHUNK_SIZE) chunk_size = 64 * ARENA_CHUNK_SIZE;
+    if (chunk_size < size) chunk_size = size;
+    ArenaChunk *chunk = malloc(CHUNK_HEADER + chunk_size);
+    if (!chunk) {
+        perror("arena_alloc");
+        exit(EXIT_FAILURE);
+    }
+    chunk->next = arena->chunks;
+    chunk->size = chunk_size;
+    arena->chunks = chunk;
+    arena->ptr = (char *)chunk + CHUNK_HEADER;
+    arena->end = arena->ptr + chunk_size;
+}
+
+static void *arena_bump(Arena *arena, size_t size, size_t align) {
+    size_t pad = (size_t)-(uintptr_t)arena->ptr & (align - 1);
+    if ((size_t)(arena->end - arena->ptr) < pad + size) {
+        arena_grow(arena, size);
+        pad = 0;
+    }
+    void *p = arena->ptr + pad;
+    arena->ptr += pad + size;
+    arena->bytes_allocated += size;
+    return p;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+    return arena_bump(arena, size, ARENA_ALIGN);
+}
+
+// Strings need no alignment, so they pack tightly.
+char *arena_strndup(Arena *arena, const char *s, size_t len) {
+    char *copy = arena_bump(arena, len + 1, 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char *arena_strdup(Arena *arena, const char *s) {
+    return arena_strndup(arena, s, strlen(s));
+}
+
+void arena_free(Arena *arena) {
+    ArenaChunk *chunk = arena->chunks;
+    while (chunk) {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena_init(arena);
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+#include "compile.h"
+#include "irbin.h"
+
+#ifdef _WIN32
+#include <windows.h>
+typedef HANDLE BatchThread;
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+typedef pthread_t BatchThread;
+#endif
+
+typedef struct {
+    const char **paths;
+    int count;
+    int next;               // first unclaimed file, taken atomically
+    OptOptions options;
+    const char *out_dir;
+    BatchResult *results;
+} Batch;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+int batch_default_jobs(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+// dir/name.ir for source path dir/.../name.ext.
+static void module_path(char *out, size_t size, const char *dir, const char *path) {
+    const char *base = path;
+    for (const char *s = path; *s; s++) {
+        if (*s == '/' || *s == '\\') base = s + 1;
+    }
+    const char *dot = strrchr(base, '.');
+    int len = dot && dot != base ? (int)(dot - base) : (int)strlen(base);
+    snprintf(out, size, "%s/%.*s.ir", dir, len, base);
+}
+
+typedef struct {
+    char *module;
+    int index;
+} ModuleName;
+
+static int compare_module(const void *a, const void *b) {
+    const ModuleName *x = a, *y = b;
+    int c = strcmp(x->module, y->module);
+    return c ? c : x->index - y->index;
+}
+
+// Sources with the same name would overwrite each other's module, so all
+// but the first of them fail before any work starts.
+static void reject_duplicate_modules(Batch *batch) {
+    ModuleName *names = malloc((batch->count + 1) * sizeof(ModuleName));
+    for (int i = 0; i < batch->count; i++) {
+        char out[1024];
+        module_path(out, sizeof(out), batch->out_dir, batch->paths[i]);
+        names[i].module = strdup(out);
+        names[i].index = i;
+    }
+    qsort(names, batch->count, sizeof(ModuleName), compare_module);
+    for (int i = 1, first = 0; i < batch->count; i++) {
+        if (strcmp(names[first].module, names[i].module) != 0) {
+            first = i;
+            continue;
+        }
+        BatchResult *r = &batch->results[names[i].index];
+        r->status = -1;
+        snprintf(r->error, sizeof(r->error), "%s is already written for %s", names[i].module,
+                 batch->paths[names[first].index]);
+    }
+    for (int i = 0; i < batch->count; i++) free(names[i].module);
+    free(names);
+}
+
+static void compile_one(Batch *batch, BatchResult *r) {
+    double start = now_seconds();
+    FILE *source = fopen(r->path, "r");
+    if (!source) {
+        r->status = -1;
+        snprintf(r->error, sizeof(r->error), "cannot open file");
+        return;
+    }
+    fseek(source, 0, SEEK_END);
+    r->bytes = ftell(source);
+    rewind(source);
+
+    IRList ir;
+    CompileResult compiled;
+    r->status = compile_source(source, &ir, &batch->options, &compiled) == COMPILE_OK ? 0 : -1;
+    fclose(source);
+    r->statements = compiled.statements;
+    if (r->status != 0) {
+        snprintf(r->error, sizeof(r->error), "%s", compiled.error);
+    } else {
+        r->insts = ir.count;
+        if (batch->out_dir) {
+            char out[1024];
+            module_path(out, sizeof(out), batch->out_dir, r->path);
+            IRBinStatus written = irbin_write(&ir, out);
+            if (written != IRBIN_OK) {
+                r->status = -1;
+                snprintf(r->error, sizeof(r->error), "cannot write module: %s", irbin_status_string(written));
+            }
+        }
+        ir_free(&ir);
+    }
+    r->seconds = now_seconds() - start;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker(LPVOID arg) {
+#else
+static void *worker(void *arg) {
+#endif
+    Batch *batch = arg;
+    for (;;) {
+        int i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED);
+        if (i >= batch->count) break;
+        if (batch->results[i].status == 0) compile_one(batch, &batch->results[i]);
+    }
+    return 0;
+}
+
+void batch_compile(const char **paths, int count, int jobs, const OptOptions *options,
+                   const char *out_dir, BatchResult *results, BatchStats *stats) {
+    Batch batch;
+    batch.paths = paths;
+    batch.count = count;
+    batch.next = 0;
+    batch.options = *options;
+    // Workers share the options, so none of them prints or records stats.
+    batch.options.verbose = 0;
+    batch.options.stats = NULL;
+    batch.out_dir = out_dir;
+    batch.results = results;
+    for (int i = 0; i < count; i++) {
+        memset(&results[i], 0, sizeof(BatchResult));
+        results[i].path = paths[i];
+    }
+    if (out_dir) reject_duplicate_modules(&batch);
+    if (jobs < 1) jobs = 1;
+    if (jobs > count) jobs = count > 0 ? count : 1;
+
+    double start = now_seconds();
+    // The calling thread is the first worker.
+    BatchThread *threads = malloc(jobs * sizeof(BatchThread));
+    int started = 0;
+    for (int t = 1; t < jobs; t++) {
+#ifdef _WIN32
+        threads[started] = CreateThread(NULL, 0, worker, &batch, 0, NULL);
+        if (!threads[started]) break;
+#else
+        if (pthread_create(&threads[started], NULL, worker, &batch) != 0) break;
+#endif
+        started++;
+    }
+    worker(&batch);
+    for (int t = 0; t < started; t++) {
+#ifdef _WIN32
+        WaitForSingleObject(threads[t], INFINITE);
+        CloseHandle(threads[t]);
+#else
+        pthread_join(threads[t], NULL);
+#endif
+    }
+    free(threads);
+
+    memset(stats, 0, sizeof(*stats));
+    stats->seconds = now_seconds() - start;
+    stats->threads = started + 1;
+    stats->files = count;
+    for (int i = 0; i < count; i++) {
+        if (results[i].status != 0) stats->failed++;
+        stats->bytes += results[i].bytes;
+        stats->insts += results[i].insts;
+    }
+}
+
+int batch_read_manifest(const char *path, char ***paths) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int count = 0, capacity = 0;
+    char **list = NULL;
+    char line[4096];
+    while (fgets(line, sizeof(line), f)) {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        char *s = line;
+        while (*s == ' ' || *s == '\t') s++;
+        if (*s == '\0' || *s == '#') continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            list = realloc(list, capacity * sizeof(char *));
+        }
+        list[count++] = strdup(s);
+    }
+    fclose(f);
+    *paths = list;
+    return count;
+}
+
+void batch_free_manifest(char **paths, int count) {
+    for (int i = 0; i < count; i++) free(paths[i]);
+    free(paths);
+}
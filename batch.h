@@ -0,0 +1,43 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "optimizer.h"
+
+typedef struct {
+    const char *path;
+    int status;             // 0, or -1 when the file could not be compiled
+    char error[160];
+    int statements;
+    int insts;              // after optimization
+    long long bytes;        // source size
+    double seconds;         // wall time spent on this file
+} BatchResult;
+
+typedef struct {
+    int files;
+    int failed;
+    int threads;
+    long long bytes;
+    long long insts;
+    double seconds;         // wall time of the whole batch
+} BatchStats;
+
+// Compiles count files across jobs worker threads. Workers claim the next
+// file from a shared counter, so long and short files balance out, and
+// results[i] describes paths[i]. The optimizer runs quietly. When out_dir
+// is set, every program is written there as a binary IR module (irbin.h)
+// named after its source file, as in "dir/name.ir"; a file whose name an
+// earlier file already took fails without being compiled.
+void batch_compile(const char **paths, int count, int jobs, const OptOptions *options,
+                   const char *out_dir, BatchResult *results, BatchStats *stats);
+
+// One path per line; blank lines and lines starting with '#' are skipped.
+// Returns the number of paths in a malloc'd array, or -1 if the manifest
+// cannot be read.
+int batch_read_manifest(const char *path, char ***paths);
+void batch_free_manifest(char **paths, int count);
+
+// Online processors, the default pool size.
+int batch_default_jobs(void);
+
+#endif
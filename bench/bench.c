@@ -0,0 +1,461 @@
+// Benchmark harness: times each compiler phase over a corpus of programs,
+// writes the results as JSON and compares them with a saved baseline.
+//
+//   bench [--runs N] [--corpus DIR] [--out FILE] [--baseline FILE]
+//         [--threshold PERCENT] [--no-exec]
+//
+// The corpus is every .c file in DIR plus programs generated here: deep
+// nesting, a deep nest of counted loops, long straight-line code and one
+// huge file. Every phase runs
+// --runs times per program; the fastest run is compared, since it is the
+// one least disturbed by the rest of the machine. Exits with status 1 when
+// a phase got slower than the baseline by more than the threshold.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <dirent.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "lexer.h"
+#include "parser.h"
+#include "ir.h"
+#include "optimizer.h"
+#include "vm.h"
+#include "jit.h"
+
+#define BENCH_DEFAULT_RUNS 5
+#define BENCH_DEFAULT_THRESHOLD 10.0
+// Phases faster than this are too noisy to call a regression.
+#define BENCH_NOISE_MS 0.05
+
+typedef enum {
+    PHASE_LEX,          // tokenizing alone
+    PHASE_PARSE,        // parse_program, which lexes as it goes
+    PHASE_IRGEN,
+    PHASE_OPTIMIZE,
+    PHASE_VM,           // vm_compile and vm_run
+    PHASE_JIT_COMPILE,
+    PHASE_JIT,          // native run
+    NUM_PHASES
+} Phase;
+
+static const char *phase_names[NUM_PHASES] = {
+    "lex", "parse", "irgen", "optimize", "vm", "jit_compile", "jit"
+};
+
+typedef struct {
+    char *bytes;
+    size_t size;
+    size_t capacity;
+} Text;
+
+typedef struct {
+    char name[64];
+    Text source;
+    int tokens;
+    int insts;              // after optimization
+    int result;
+    double *samples[NUM_PHASES];    // ms per run, NULL when the phase did not run
+    double min_ms[NUM_PHASES];
+    double median_ms[NUM_PHASES];
+} BenchCase;
+
+static double now_ms(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#endif
+}
+
+static void text_printf(Text *t, const char *fmt, ...) {
+    va_list args;
+    for (;;) {
+        size_t room = t->capacity - t->size;
+        va_start(args, fmt);
+        int n = vsnprintf(t->bytes ? t->bytes + t->size : NULL, room, fmt, args);
+        va_end(args);
+        if ((size_t)n < room) {
+            t->size += n;
+            return;
+        }
+        t->capacity = (t->capacity ? t->capacity * 2 : 4096) + n;
+        t->bytes = realloc(t->bytes, t->capacity);
+    }
+}
+
+static unsigned rng_state;
+
+static int rng(int n) {
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (int)((rng_state >> 16) % (unsigned)n);
+}
+
+// Blocks, ifs and loops nested depth deep, each level declaring a variable
+// and reading the one around it. Every loop runs once.
+static void gen_deep_nesting(Text *t, int depth) {
+    text_printf(t, "int v0 = 1;\n");
+    for (int d = 1; d <= depth; d++) {
+        switch (d % 4) {
+            case 0: text_printf(t, "if (v%d > 0) {\n", d - 1); break;
+            case 1: text_printf(t, "while (v%d < %d) {\n", d - 1, d + 1); break;
+            case 2: text_printf(t, "for (int i%d = 0; i%d < 1; i%d = i%d + 1) {\n", d, d, d, d); break;
+            default: text_printf(t, "{\n"); break;
+        }
+        text_printf(t, "int v%d = v%d + %d;\n", d, d - 1, d % 7 + 1);
+        if (d % 4 == 1) text_printf(t, "v%d = %d;\n", d - 1, d + 1);
+    }
+    // A deeply parenthesized expression at the innermost level.
+    text_printf(t, "v0 = ");
+    for (int d = 0; d < depth; d++) text_printf(t, "(v%d + ", depth - d);
+    text_printf(t, "1");
+    for (int d = 0; d < depth; d++) text_printf(t, ")");
+    text_printf(t, ";\n");
+    for (int d = depth; d >= 1; d--) text_printf(t, "}\n");
+    text_printf(t, "return v0;\n");
+}
+
+// Counted for and while loops nested depth deep around one update, the
+// shape that makes per-level loop passes grow with the depth. Every loop
+// runs once.
+static void gen_deep_loops(Text *t, int depth) {
+    text_printf(t, "int s = 0;\n");
+    for (int d = 0; d < depth; d++) {
+        if (d % 2 == 0) {
+            text_printf(t, "for (int i%d = 0; i%d < 1; i%d = i%d + 1) {\n", d, d, d, d);
+        } else {
+            text_printf(t, "int w%d = 0;\nwhile (w%d < 1) {\nw%d = w%d + 1;\n", d, d, d, d);
+        }
+    }
+    text_printf(t, "s = s + 3;\n");
+    for (int d = 0; d < depth; d++) text_printf(t, "}\n");
+    text_printf(t, "return s;\n");
+}
+
+// One long basic block of assignments over a small set of variables.
+static void gen_straight_line(Text *t, int statements) {
+    // Seeded from variables that are zero at start but unknown to the
+    // optimizer, so the block cannot fold away.
+    for (int v = 0; v < 32; v++) text_printf(t, "int s%d = in%d + %d;\n", v, v, v + 1);
+    for (int i = 0; i < statements; i++) {
+        text_printf(t, "s%d = s%d * %d + s%d - %d;\n", rng(32), rng(32), rng(9) + 1, rng(32), rng(100));
+    }
+    text_printf(t, "return s0 + s31;\n");
+}
+
+// Many short independent sections mixing arithmetic, branches and small
+// loops, the shape of large generated scripts.
+static void gen_huge(Text *t, int sections) {
+    text_printf(t, "int acc = 0;\n");
+    for (int s = 0; s < sections; s++) {
+        int k = rng(50) + 2;
+        text_printf(t, "{\n");
+        text_printf(t, "int a = acc %% %d + %d;\n", k, s % 100);
+        text_printf(t, "int b = a * %d - %d;\n", rng(9) + 1, rng(100));
+        text_printf(t, "if (a < b) { acc = acc + b / %d; } else { acc = acc - a %% %d; }\n", rng(9) + 1, rng(9) + 1);
+        text_printf(t, "for (int i = 0; i < %d; i = i + 1) { acc = acc + (i * a) %% %d; }\n", rng(4) + 1, k);
+        text_printf(t, "g%d = acc + a - b;\n", s % 512);
+        text_printf(t, "}\n");
+    }
+    text_printf(t, "return acc;\n");
+}
+
+static int read_file(const char *path, Text *t) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) text_printf(t, "%.*s", (int)n, chunk);
+    fclose(f);
+    return 0;
+}
+
+static int by_name(const void *a, const void *b) {
+    return strcmp(((const BenchCase *)a)->name, ((const BenchCase *)b)->name);
+}
+
+static BenchCase *add_case(BenchCase **cases, int *count, const char *name) {
+    *cases = realloc(*cases, (*count + 1) * sizeof(BenchCase));
+    BenchCase *c = &(*cases)[(*count)++];
+    memset(c, 0, sizeof(*c));
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    return c;
+}
+
+static int load_corpus(const char *dir, BenchCase **cases) {
+    int count = 0;
+    DIR *d = dir ? opendir(dir) : NULL;
+    if (dir && !d) fprintf(stderr, "bench: cannot open corpus directory %s\n", dir);
+    if (d) {
+        struct dirent *de;
+        while ((de = readdir(d)) != NULL) {
+            size_t len = strlen(de->d_name);
+            if (len < 3 || strcmp(de->d_name + len - 2, ".c") != 0) continue;
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+            char name[64];
+            snprintf(name, sizeof(name), "%.*s", (int)(len - 2), de->d_name);
+            BenchCase *c = add_case(cases, &count, name);
+            if (read_file(path, &c->source) != 0) count--;
+        }
+        closedir(d);
+        qsort(*cases, count, sizeof(BenchCase), by_name);
+    }
+    rng_state = 12345;
+    gen_deep_nesting(&add_case(cases, &count, "gen_deep_nesting")->source, 200);
+    gen_deep_loops(&add_case(cases, &count, "gen_deep_loops")->source, 400);
+    gen_straight_line(&add_case(cases, &count, "gen_straight_line")->source, 40000);
+    gen_huge(&add_case(cases, &count, "gen_huge")->source, 4000);
+    return count;
+}
+
+static void record(BenchCase *c, Phase phase, int run, int runs, double ms) {
+    if (!c->samples[phase]) c->samples[phase] = calloc(runs, sizeof(double));
+    c->samples[phase][run] = ms;
+}
+
+// One pass of every phase over c. Returns -1 if the program does not
+// compile or traps, which makes its numbers meaningless.
+static int bench_once(BenchCase *c, int run, int runs, int execute) {
+    const char *src = c->source.bytes ? c->source.bytes : "";
+    size_t size = c->source.size;
+
+    InternPool atoms;
+    intern_init(&atoms);
+    Lexer lexer;
+    double start = now_ms();
+    lexer_init_buffer(&lexer, src, size, &atoms);
+    int tokens = 0;
+    while (lexer_next_token(&lexer).type != TOKEN_EOF) tokens++;
+    record(c, PHASE_LEX, run, runs, now_ms() - start);
+    lexer_free(&lexer);
+    intern_free(&atoms);
+    c->tokens = tokens;
+
+    Arena arena;
+    arena_init(&arena);
+    intern_init(&atoms);
+    Parser parser;
+    start = now_ms();
+    parser_init_buffer(&parser, src, size, &arena, &atoms);
+    ASTList *program = parse_program(&parser);
+    record(c, PHASE_PARSE, run, runs, now_ms() - start);
+    parser_free(&parser);
+    if (parser.failed) {
+        fprintf(stderr, "bench: %s: %s\n", c->name, parser.error);
+        intern_free(&atoms);
+        arena_free(&arena);
+        return -1;
+    }
+
+    IRList ir;
+    ir_list_init(&ir);
+    char error[160];
+    start = now_ms();
+    int generated = ir_generate_program(&ir, program, &atoms, error, sizeof(error));
+    record(c, PHASE_IRGEN, run, runs, now_ms() - start);
+    intern_free(&atoms);
+    arena_free(&arena);
+    if (generated != 0) {
+        fprintf(stderr, "bench: %s: %s\n", c->name, error);
+        ir_free(&ir);
+        return -1;
+    }
+
+    OptOptions options;
+    opt_options_init(&options);
+    options.verbose = 0;
+    start = now_ms();
+    ir_optimize(&ir, &options);
+    record(c, PHASE_OPTIMIZE, run, runs, now_ms() - start);
+    c->insts = ir.count;
+
+    int status = 0;
+    if (execute) {
+        VMProgram prog;
+        int *vars = calloc(ir.var_count > 0 ? ir.var_count : 1, sizeof(int));
+        start = now_ms();
+        vm_compile(&prog, &ir);
+        VMStatus vs = vm_run(&prog, vars, &c->result);
+        record(c, PHASE_VM, run, runs, now_ms() - start);
+        vm_free(&prog);
+        if (vs != VM_OK) status = -1;
+
+        JitProgram native;
+        start = now_ms();
+        if (status == 0 && jit_available() && jit_compile(&native, &ir) == 0) {
+            record(c, PHASE_JIT_COMPILE, run, runs, now_ms() - start);
+            memset(vars, 0, (ir.var_count > 0 ? ir.var_count : 1) * sizeof(int));
+            int trap = JIT_OK;
+            start = now_ms();
+            int result = native.entry(vars, &trap);
+            record(c, PHASE_JIT, run, runs, now_ms() - start);
+            jit_free(&native);
+            if (trap != JIT_OK || result != c->result) {
+                fprintf(stderr, "bench: %s: native result %d differs from the VM's %d\n", c->name, result, c->result);
+                status = -1;
+            }
+        }
+        free(vars);
+        if (status != 0) fprintf(stderr, "bench: %s: execution failed\n", c->name);
+    }
+    ir_free(&ir);
+    return status;
+}
+
+static int compare_ms(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void summarize(BenchCase *c, int runs) {
+    for (int p = 0; p < NUM_PHASES; p++) {
+        if (!c->samples[p]) continue;
+        qsort(c->samples[p], runs, sizeof(double), compare_ms);
+        c->min_ms[p] = c->samples[p][0];
+        c->median_ms[p] = c->samples[p][runs / 2];
+    }
+}
+
+static int write_json(const char *path, BenchCase *cases, int count, int runs) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "{\n  \"version\": 1,\n  \"runs\": %d,\n  \"cases\": [\n", runs);
+    for (int i = 0; i < count; i++) {
+        BenchCase *c = &cases[i];
+        fprintf(f, "    {\n      \"name\": \"%s\",\n      \"bytes\": %zu,\n      \"tokens\": %d,\n"
+                   "      \"insts\": %d,\n      \"phases\": {", c->name, c->source.size, c->tokens, c->insts);
+        int first = 1;
+        for (int p = 0; p < NUM_PHASES; p++) {
+            if (!c->samples[p]) continue;
+            fprintf(f, "%s\n        \"%s\": { \"min_ms\": %.4f, \"median_ms\": %.4f }",
+                    first ? "" : ",", phase_names[p], c->min_ms[p], c->median_ms[p]);
+            first = 0;
+        }
+        fprintf(f, "\n      }\n    }%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    fclose(f);
+    return 0;
+}
+
+// Looks up the min_ms of a phase of a case in a results file written by
+// write_json. Returns -1 when the baseline does not have it.
+static double baseline_ms(const char *json, const char *name, const char *phase) {
+    char key[96];
+    snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+    const char *at = strstr(json, key);
+    if (!at) return -1;
+    const char *next = strstr(at + 1, "\"name\":");
+    snprintf(key, sizeof(key), "\"%s\": { \"min_ms\": ", phase);
+    const char *p = strstr(at, key);
+    if (!p || (next && p > next)) return -1;
+    return atof(p + strlen(key));
+}
+
+// Prints every phase against the baseline. Returns the number of phases
+// slower by more than threshold percent.
+static int compare_baseline(const char *path, BenchCase *cases, int count, double threshold) {
+    Text json = { 0 };
+    if (read_file(path, &json) != 0) {
+        printf("No baseline at %s; save one with 'make bench' or 'make bench-baseline'.\n", path);
+        return 0;
+    }
+    text_printf(&json, "%s", "");
+    int regressions = 0;
+    printf("\nAgainst %s (threshold %.1f%%):\n", path, threshold);
+    for (int i = 0; i < count; i++) {
+        for (int p = 0; p < NUM_PHASES; p++) {
+            if (!cases[i].samples[p]) continue;
+            double base = baseline_ms(json.bytes, cases[i].name, phase_names[p]);
+            if (base < 0) continue;
+            double now = cases[i].min_ms[p];
+            double change = base > 0 ? (now - base) * 100.0 / base : 0;
+            int slower = change > threshold && now - base > BENCH_NOISE_MS;
+            regressions += slower;
+            printf("  %-22s %-12s %10.3f -> %10.3f ms  %+7.1f%%%s\n", cases[i].name, phase_names[p],
+                   base, now, change, slower ? "  REGRESSION" : "");
+        }
+    }
+    free(json.bytes);
+    if (regressions) printf("%d phases regressed.\n", regressions);
+    return regressions;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = BENCH_DEFAULT_RUNS;
+    int execute = 1;
+    double threshold = BENCH_DEFAULT_THRESHOLD;
+    const char *corpus = NULL;
+    const char *out = NULL;
+    const char *baseline = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            corpus = argv[++i];
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--no-exec") == 0) {
+            execute = 0;
+        } else {
+            fprintf(stderr, "Usage: %s [--runs N] [--corpus DIR] [--out FILE] [--baseline FILE] "
+                            "[--threshold PERCENT] [--no-exec]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (runs < 1) runs = 1;
+
+    BenchCase *cases = NULL;
+    int count = load_corpus(corpus, &cases);
+    int failed = 0;
+    printf("%-22s %9s %8s", "program", "bytes", "insts");
+    for (int p = 0; p < NUM_PHASES; p++) printf(" %11s", phase_names[p]);
+    printf("   (fastest of %d, ms)\n", runs);
+    for (int i = 0; i < count; i++) {
+        BenchCase *c = &cases[i];
+        int ok = 1;
+        for (int r = 0; r < runs && ok; r++) ok = bench_once(c, r, runs, execute) == 0;
+        if (!ok) {
+            failed++;
+            for (int p = 0; p < NUM_PHASES; p++) {
+                free(c->samples[p]);
+                c->samples[p] = NULL;
+            }
+            continue;
+        }
+        summarize(c, runs);
+        printf("%-22s %9zu %8d", c->name, c->source.size, c->insts);
+        for (int p = 0; p < NUM_PHASES; p++) {
+            if (c->samples[p]) printf(" %11.3f", c->min_ms[p]);
+            else printf(" %11s", "-");
+        }
+        printf("\n");
+    }
+
+    if (out && write_json(out, cases, count, runs) != 0) {
+        perror("bench: cannot write results");
+        failed++;
+    }
+    int regressions = baseline ? compare_baseline(baseline, cases, count, threshold) : 0;
+
+    for (int i = 0; i < count; i++) {
+        for (int p = 0; p < NUM_PHASES; p++) free(cases[i].samples[p]);
+        free(cases[i].source.bytes);
+    }
+    free(cases);
+    return failed || regressions ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,13 @@
+int steps = 0;
+for (int n = 1; n < 30000; n = n + 1) {
+    int x = n;
+    while (x != 1) {
+        if (x % 2 == 0) {
+            x = x / 2;
+        } else {
+            x = 3 * x + 1;
+        }
+        steps = steps + 1;
+    }
+}
+return steps;
@@ -0,0 +1,11 @@
+int total = 0;
+for (int i = 0; i < 300; i = i + 1) {
+    for (int j = 0; j < 300; j = j + 1) {
+        int k = 0;
+        while (k < 10) {
+            total = total + (i * j + k) % 13;
+            k = k + 1;
+        }
+    }
+}
+return total;
@@ -0,0 +1,5 @@
+int s = 0;
+for (int i = 0; i < 2000000; i = i + 1) {
+    s = s + i % 7 * 3 - i / 5;
+}
+return s;
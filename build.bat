@@ -1,3 +1,3 @@
 @echo off
-gcc -o compiler main.c parser.c lexer.c ir.c optimizer.c -Wall -Wextra
+gcc -o compiler main.c parser.c lexer.c ir.c optimizer.c vm.c jit.c cfg.c ssa.c liveness.c regalloc.c symtab.c arena.c intern.c dce.c licm.c ivopt.c unroll.c peephole.c gvn.c tier.c cache.c irbin.c compile.c batch.c cjit.c stats.c -Wall -Wextra
 echo Build complete. Run with: compiler input.txt
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include "cache.h"
+#include "irbin.h"
+
+#define STRINGIFY(x) #x
+#define REVISION_STRING(x) STRINGIFY(x)
+static const char cache_version[] = COMPILER_VERSION " rev " REVISION_STRING(CACHE_REVISION);
+
+typedef struct {
+    char *bytes;
+    size_t size;
+    size_t capacity;
+} ByteBuf;
+
+static void buf_append(ByteBuf *buf, const void *data, size_t size) {
+    if (buf->size + size > buf->capacity) {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        if (buf->capacity < buf->size + size) buf->capacity = buf->size + size;
+        buf->bytes = realloc(buf->bytes, buf->capacity);
+    }
+    memcpy(buf->bytes + buf->size, data, size);
+    buf->size += size;
+}
+
+#define FNV_OFFSET 14695981039346656037ULL
+
+static uint64_t fnv1a(uint64_t h, const void *data, size_t size) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static char *entry_path(Cache *cache, const char *name) {
+    size_t size = strlen(cache->dir) + strlen(name) + 2;
+    char *path = malloc(size);
+    snprintf(path, size, "%s/%s", cache->dir, name);
+    return path;
+}
+
+static char *key_path(Cache *cache, const char *ext) {
+    char name[32];
+    snprintf(name, sizeof(name), "%s.%s", cache->key, ext);
+    return entry_path(cache, name);
+}
+
+static char *read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    ByteBuf buf = { NULL, 0, 0 };
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) buf_append(&buf, chunk, n);
+    fclose(f);
+    *size = buf.size;
+    return buf.bytes ? buf.bytes : malloc(1);
+}
+
+// Writes to a private temporary file first; rename replaces any entry with
+// the same name atomically, so readers never see a partial file.
+static void write_atomic(Cache *cache, const char *name, const void *data, size_t size) {
+    static unsigned serial;
+    char tmp_name[64];
+    snprintf(tmp_name, sizeof(tmp_name), ".tmp.%ld.%u", (long)getpid(), serial++);
+    char *tmp = entry_path(cache, tmp_name);
+    char *path = entry_path(cache, name);
+    FILE *f = fopen(tmp, "wb");
+    int ok = f && fwrite(data, 1, size, f) == size;
+    if (f && fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "Cache: cannot write %s\n", path);
+        remove(tmp);
+    }
+    free(tmp);
+    free(path);
+}
+
+int cache_open(Cache *cache, const char *dir, long long limit) {
+    memset(cache, 0, sizeof(*cache));
+    cache->dir = strdup(dir);
+    cache->limit = limit;
+#ifdef _WIN32
+    int made = mkdir(dir);
+#else
+    int made = mkdir(dir, 0755);
+#endif
+    if (made != 0 && errno != EEXIST) {
+        perror("Cache: cannot create directory");
+        free(cache->dir);
+        cache->dir = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void cache_set_key(Cache *cache, FILE *source, const OptOptions *options) {
+    uint64_t h = FNV_OFFSET;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), source)) > 0) h = fnv1a(h, chunk, n);
+    rewind(source);
+    char flags[64];
+    snprintf(flags, sizeof(flags), "|unroll=%d|budget=%d|", options->unroll_factor, options->unroll_budget);
+    h = fnv1a(h, flags, strlen(flags));
+    h = fnv1a(h, cache_version, sizeof(cache_version));
+    snprintf(cache->key, sizeof(cache->key), "%016llx", (unsigned long long)h);
+}
+
+// A hit refreshes the entry's age for eviction.
+static void touch(const char *path) {
+    utime(path, NULL);
+}
+
+int cache_load_ir(Cache *cache, IRList *list) {
+    char *path = key_path(cache, "ir");
+    // Unreadable or stale entries are simply rebuilt.
+    int hit = irbin_load(list, path) == IRBIN_OK;
+    if (hit) touch(path);
+    hit ? cache->run.hits++ : cache->run.misses++;
+    free(path);
+    return hit;
+}
+
+void cache_store_ir(Cache *cache, IRList *list) {
+    size_t size;
+    void *image = irbin_encode(list, &size);
+    char name[32];
+    snprintf(name, sizeof(name), "%s.ir", cache->key);
+    write_atomic(cache, name, image, size);
+    free(image);
+}
+
+// Header of a KEY.jit entry, followed by code_size bytes of machine code.
+// Native byte order: the code only runs on the host that wrote it anyway.
+#define CODE_MAGIC "CJXC"
+
+typedef struct {
+    char magic[4];
+    uint32_t revision;      // CACHE_REVISION
+    uint64_t key;           // the entry's cache key
+    uint64_t ir_hash;       // FNV-1a 64 of the IR as irbin_encode writes it
+    uint64_t code_hash;     // FNV-1a 64 of the code
+    uint64_t code_size;
+} CodeHeader;
+
+static uint64_t ir_hash(IRList *list) {
+    size_t size;
+    void *image = irbin_encode(list, &size);
+    uint64_t h = fnv1a(FNV_OFFSET, image, size);
+    free(image);
+    return h;
+}
+
+static uint64_t key_value(Cache *cache) {
+    return strtoull(cache->key, NULL, 16);
+}
+
+int cache_load_code(Cache *cache, JitProgram *prog, IRList *list) {
+    char *path = key_path(cache, "jit");
+    size_t size;
+    char *entry = read_file(path, &size);
+    CodeHeader h;
+    // Anything truncated, from another key or IR, or altered on disk is a
+    // miss; only then is the code handed to jit_load.
+    int hit = 0;
+    if (entry && size > sizeof(h)) {
+        memcpy(&h, entry, sizeof(h));
+        const char *code = entry + sizeof(h);
+        hit = memcmp(h.magic, CODE_MAGIC, 4) == 0 && h.revision == CACHE_REVISION &&
+              h.key == key_value(cache) && h.code_size == size - sizeof(h) &&
+              h.code_hash == fnv1a(FNV_OFFSET, code, h.code_size) && h.ir_hash == ir_hash(list) &&
+              jit_load(prog, list, code, h.code_size) == 0;
+    }
+    if (hit) touch(path);
+    hit ? cache->run.hits++ : cache->run.misses++;
+    free(entry);
+    free(path);
+    return hit;
+}
+
+void cache_store_code(Cache *cache, JitProgram *prog, IRList *list) {
+    CodeHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CODE_MAGIC, 4);
+    h.revision = CACHE_REVISION;
+    h.key = key_value(cache);
+    h.ir_hash = ir_hash(list);
+    h.code_hash = fnv1a(FNV_OFFSET, prog->code, prog->size);
+    h.code_size = prog->size;
+    ByteBuf buf = { NULL, 0, 0 };
+    buf_append(&buf, &h, sizeof(h));
+    buf_append(&buf, prog->code, prog->size);
+    char name[32];
+    snprintf(name, sizeof(name), "%s.jit", cache->key);
+    write_atomic(cache, name, buf.bytes, buf.size);
+    free(buf.bytes);
+}
+
+typedef struct {
+    char *name;
+    long long size;
+    time_t mtime;
+} CacheEntry;
+
+static int older_first(const void *a, const void *b) {
+    time_t x = ((const CacheEntry *)a)->mtime, y = ((const CacheEntry *)b)->mtime;
+    return (x > y) - (x < y);
+}
+
+// Removes the least recently used entries until the rest fit the limit.
+static void evict(Cache *cache) {
+    DIR *dir = opendir(cache->dir);
+    if (!dir) return;
+    int count = 0, capacity = 16;
+    CacheEntry *entries = malloc(capacity * sizeof(CacheEntry));
+    long long total = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        const char *dot = strrchr(de->d_name, '.');
+        if (de->d_name[0] == '.' || !dot || (strcmp(dot, ".ir") != 0 && strcmp(dot, ".jit") != 0)) continue;
+        char *path = entry_path(cache, de->d_name);
+        struct stat st;
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            if (count == capacity) {
+                capacity *= 2;
+                entries = realloc(entries, capacity * sizeof(CacheEntry));
+            }
+            entries[count].name = path;
+            entries[count].size = (long long)st.st_size;
+            entries[count].mtime = st.st_mtime;
+            total += entries[count].size;
+            count++;
+        } else {
+            free(path);
+        }
+    }
+    closedir(dir);
+
+    qsort(entries, count, sizeof(CacheEntry), older_first);
+    int kept = count;
+    for (int i = 0; i < count; i++) {
+        if (total > cache->limit && remove(entries[i].name) == 0) {
+            total -= entries[i].size;
+            cache->run.evicted++;
+            kept--;
+        }
+        free(entries[i].name);
+    }
+    free(entries);
+    cache->entries = kept;
+    cache->bytes = total;
+}
+
+// Adds this run to the totals in the stats file. Concurrent closes may
+// drop each other's counts, never corrupt the file.
+static void update_stats(Cache *cache) {
+    char *path = entry_path(cache, "stats");
+    size_t size;
+    char *data = read_file(path, &size);
+    CacheStats total = { 0, 0, 0 };
+    if (data) {
+        data = realloc(data, size + 1);
+        data[size] = '\0';
+        if (sscanf(data, "hits %lld misses %lld evicted %lld", &total.hits, &total.misses, &total.evicted) != 3) {
+            memset(&total, 0, sizeof(total));
+        }
+    }
+    total.hits += cache->run.hits;
+    total.misses += cache->run.misses;
+    total.evicted += cache->run.evicted;
+    cache->total = total;
+
+    char text[128];
+    int len = snprintf(text, sizeof(text), "hits %lld misses %lld evicted %lld\n", total.hits, total.misses, total.evicted);
+    write_atomic(cache, "stats", text, (size_t)len);
+    free(data);
+    free(path);
+}
+
+void cache_close(Cache *cache) {
+    evict(cache);
+    update_stats(cache);
+    free(cache->dir);
+    cache->dir = NULL;
+}
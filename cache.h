@@ -0,0 +1,55 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include "ir.h"
+#include "jit.h"
+#include "optimizer.h"
+
+// Part of every cache key, so entries from other compiler versions never
+// match. Bump CACHE_REVISION whenever a change alters the optimized IR, the
+// generated code or the entry layout without a new COMPILER_VERSION.
+#define COMPILER_VERSION "1.0"
+#define CACHE_REVISION 2
+
+// Bytes of entries kept by default; older ones are evicted on close.
+#define CACHE_DEFAULT_LIMIT (64LL << 20)
+
+typedef struct {
+    long long hits;
+    long long misses;
+    long long evicted;
+} CacheStats;
+
+// Content-addressed directory of optimized IR modules (KEY.ir, see
+// irbin.h) and the native code compiled from them (KEY.jit), keyed by a
+// hash of the source, the compiler version and the optimization flags.
+// Code entries carry the key, a hash of the IR they were compiled from and
+// a checksum of the code, all checked before the code is made executable.
+// Entries are written to a temporary file and renamed into place, so
+// concurrent compilers only ever see complete entries. Totals persist in
+// the directory's "stats" file.
+typedef struct {
+    char *dir;
+    long long limit;
+    char key[17];
+    CacheStats run;             // this process
+    CacheStats total;           // all runs, valid after cache_close
+    int entries;                // after cache_close
+    long long bytes;
+} Cache;
+
+// Creates dir if needed. Returns 0 on success.
+int cache_open(Cache *cache, const char *dir, long long limit);
+// Hashes the source (rewinding it afterwards) with the version and flags.
+void cache_set_key(Cache *cache, FILE *source, const OptOptions *options);
+// Fill list (initialising it) or prog on a hit and return 1; a miss leaves
+// nothing to free. Code is only a hit for the IR it was compiled from.
+int cache_load_ir(Cache *cache, IRList *list);
+int cache_load_code(Cache *cache, JitProgram *prog, IRList *list);
+void cache_store_ir(Cache *cache, IRList *list);
+void cache_store_code(Cache *cache, JitProgram *prog, IRList *list);
+// Evicts down to the size limit and folds this run into the totals.
+void cache_close(Cache *cache);
+
+#endif
@@ -0,0 +1,388 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cfg.h"
+
+static int is_terminator(IROp op) {
+    return op == IR_JUMP || op == IR_JUMP_IF_FALSE || op == IR_RETURN;
+}
+
+static void add_edge(CFG *cfg, int from, int to) {
+    BasicBlock *src = &cfg->blocks[from];
+    for (int i = 0; i < src->num_succs; i++) {
+        if (src->succs[i] == to) return;
+    }
+    src->succs[src->num_succs++] = to;
+    cfg->blocks[to].num_preds++;
+}
+
+static void split_blocks(CFG *cfg, IRList *list) {
+    int n = list->count;
+    cfg->inst_block = malloc((n + 1) * sizeof(int));
+    cfg->label_block = malloc((list->label_count + 1) * sizeof(int));
+    for (int i = 0; i < list->label_count; i++) cfg->label_block[i] = -1;
+
+    int num_blocks = 0;
+    for (int i = 0; i < n; i++) {
+        IRInst *inst = &list->insts[i];
+        int leader = i == 0 || inst->op == IR_LABEL || is_terminator(list->insts[i - 1].op);
+        if (leader) num_blocks++;
+        cfg->inst_block[i] = num_blocks - 1;
+        if (inst->op == IR_LABEL) cfg->label_block[inst->label] = num_blocks - 1;
+    }
+
+    cfg->num_blocks = num_blocks;
+    cfg->blocks = calloc(num_blocks + 1, sizeof(BasicBlock));
+    for (int i = 0; i < n; i++) {
+        BasicBlock *bb = &cfg->blocks[cfg->inst_block[i]];
+        if (i == 0 || cfg->inst_block[i - 1] != cfg->inst_block[i]) bb->start = i;
+        bb->end = i + 1;
+    }
+}
+
+static void link_blocks(CFG *cfg, IRList *list) {
+    for (int b = 0; b < cfg->num_blocks; b++) {
+        IRInst *last = &list->insts[cfg->blocks[b].end - 1];
+        int fallthrough = b + 1 < cfg->num_blocks ? b + 1 : -1;
+        switch (last->op) {
+            case IR_JUMP:
+                if (cfg->label_block[last->label] >= 0) add_edge(cfg, b, cfg->label_block[last->label]);
+                break;
+            case IR_JUMP_IF_FALSE:
+                if (fallthrough >= 0) add_edge(cfg, b, fallthrough);
+                if (cfg->label_block[last->label] >= 0) add_edge(cfg, b, cfg->label_block[last->label]);
+                break;
+            case IR_RETURN:
+                break;
+            default:
+                if (fallthrough >= 0) add_edge(cfg, b, fallthrough);
+                break;
+        }
+    }
+
+    for (int b = 0; b < cfg->num_blocks; b++) {
+        cfg->blocks[b].preds = malloc((cfg->blocks[b].num_preds + 1) * sizeof(int));
+        cfg->blocks[b].num_preds = 0;
+    }
+    for (int b = 0; b < cfg->num_blocks; b++) {
+        for (int s = 0; s < cfg->blocks[b].num_succs; s++) {
+            BasicBlock *succ = &cfg->blocks[cfg->blocks[b].succs[s]];
+            succ->preds[succ->num_preds++] = b;
+        }
+    }
+}
+
+// Iterative DFS from the entry block producing reverse postorder.
+static void compute_rpo(CFG *cfg) {
+    int n = cfg->num_blocks;
+    cfg->rpo = malloc((n + 1) * sizeof(int));
+    cfg->num_rpo = 0;
+    for (int b = 0; b < n; b++) cfg->blocks[b].rpo_index = -1;
+    if (n == 0) return;
+
+    int *stack = malloc(n * sizeof(int));
+    int *next_succ = calloc(n, sizeof(int));
+    unsigned char *visited = calloc(n, 1);
+    int *postorder = malloc(n * sizeof(int));
+    int num_post = 0, sp = 0;
+
+    stack[sp++] = 0;
+    visited[0] = 1;
+    while (sp > 0) {
+        int b = stack[sp - 1];
+        BasicBlock *bb = &cfg->blocks[b];
+        if (next_succ[b] < bb->num_succs) {
+            int s = bb->succs[next_succ[b]++];
+            if (!visited[s]) {
+                visited[s] = 1;
+                stack[sp++] = s;
+            }
+        } else {
+            postorder[num_post++] = b;
+            sp--;
+        }
+    }
+
+    for (int i = 0; i < num_post; i++) {
+        int b = postorder[num_post - 1 - i];
+        cfg->rpo[i] = b;
+        cfg->blocks[b].rpo_index = i;
+    }
+    cfg->num_rpo = num_post;
+
+    free(stack);
+    free(next_succ);
+    free(visited);
+    free(postorder);
+}
+
+static int intersect(CFG *cfg, int a, int b) {
+    while (a != b) {
+        while (cfg->blocks[a].rpo_index > cfg->blocks[b].rpo_index) a = cfg->blocks[a].idom;
+        while (cfg->blocks[b].rpo_index > cfg->blocks[a].rpo_index) b = cfg->blocks[b].idom;
+    }
+    return a;
+}
+
+// Cooper, Harvey and Kennedy's iterative dominator algorithm over RPO.
+static void compute_dominators(CFG *cfg) {
+    for (int b = 0; b < cfg->num_blocks; b++) cfg->blocks[b].idom = -1;
+    if (cfg->num_rpo == 0) return;
+
+    int entry = cfg->rpo[0];
+    cfg->blocks[entry].idom = entry;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 1; i < cfg->num_rpo; i++) {
+            BasicBlock *bb = &cfg->blocks[cfg->rpo[i]];
+            int new_idom = -1;
+            for (int p = 0; p < bb->num_preds; p++) {
+                int pred = bb->preds[p];
+                if (cfg->blocks[pred].idom < 0) continue;
+                new_idom = new_idom < 0 ? pred : intersect(cfg, pred, new_idom);
+            }
+            if (new_idom != bb->idom) {
+                bb->idom = new_idom;
+                changed = 1;
+            }
+        }
+    }
+    cfg->blocks[entry].idom = -1;
+
+    // Number the dominator tree so dominance is an interval check.
+    int n = cfg->num_blocks;
+    int *first_child = malloc(n * sizeof(int));
+    int *next_sibling = malloc(n * sizeof(int));
+    for (int b = 0; b < n; b++) {
+        first_child[b] = next_sibling[b] = -1;
+        cfg->blocks[b].dom_pre = cfg->blocks[b].dom_post = -1;
+    }
+    for (int i = cfg->num_rpo - 1; i > 0; i--) {
+        int b = cfg->rpo[i];
+        int parent = cfg->blocks[b].idom;
+        next_sibling[b] = first_child[parent];
+        first_child[parent] = b;
+    }
+
+    int *stack = malloc(n * sizeof(int));
+    int sp = 0, counter = 0;
+    stack[sp++] = entry;
+    cfg->blocks[entry].dom_pre = counter++;
+    while (sp > 0) {
+        int b = stack[sp - 1];
+        int child = first_child[b];
+        if (child >= 0) {
+            first_child[b] = next_sibling[child];
+            cfg->blocks[child].dom_pre = counter++;
+            stack[sp++] = child;
+        } else {
+            cfg->blocks[b].dom_post = counter++;
+            sp--;
+        }
+    }
+
+    free(first_child);
+    free(next_sibling);
+    free(stack);
+}
+
+int cfg_dominates(CFG *cfg, int a, int b) {
+    BasicBlock *x = &cfg->blocks[a], *y = &cfg->blocks[b];
+    if (x->dom_pre < 0 || y->dom_pre < 0) return 0;
+    return x->dom_pre <= y->dom_pre && y->dom_post <= x->dom_post;
+}
+
+static int compare_loop_size(const void *a, const void *b) {
+    const Loop *x = a, *y = b;
+    if (x->num_blocks != y->num_blocks) return y->num_blocks - x->num_blocks;
+    return x->header - y->header;
+}
+
+static int compare_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// Natural loops: every back edge latch -> header where the header dominates
+// the latch. Back edges sharing a header are merged into one loop.
+static void find_loops(CFG *cfg) {
+    int n = cfg->num_blocks;
+    int *loop_of_header = malloc((n + 1) * sizeof(int));
+    int *mark = malloc((n + 1) * sizeof(int));
+    int *stack = malloc((n + 1) * sizeof(int));
+    int *members = malloc((n + 1) * sizeof(int));
+    for (int b = 0; b < n; b++) {
+        loop_of_header[b] = -1;
+        mark[b] = -1;
+        cfg->blocks[b].loop = -1;
+    }
+
+    int capacity = 8;
+    cfg->loops = malloc(capacity * sizeof(Loop));
+    cfg->num_loops = 0;
+
+    for (int i = 0; i < cfg->num_rpo; i++) {
+        int h = cfg->rpo[i];
+        BasicBlock *header = &cfg->blocks[h];
+        for (int p = 0; p < header->num_preds; p++) {
+            int latch = header->preds[p];
+            if (!cfg_dominates(cfg, h, latch)) continue;
+
+            int id = loop_of_header[h];
+            if (id < 0) {
+                if (cfg->num_loops == capacity) {
+                    capacity *= 2;
+                    cfg->loops = realloc(cfg->loops, capacity * sizeof(Loop));
+                }
+                id = loop_of_header[h] = cfg->num_loops++;
+                Loop *loop = &cfg->loops[id];
+                loop->header = h;
+                loop->parent = -1;
+                loop->depth = 1;
+                loop->blocks = malloc(sizeof(int));
+                loop->blocks[0] = h;
+                loop->num_blocks = 1;
+                loop->latches = NULL;
+                loop->num_latches = 0;
+                mark[h] = id;
+            }
+            Loop *loop = &cfg->loops[id];
+            loop->latches = realloc(loop->latches, (loop->num_latches + 1) * sizeof(int));
+            loop->latches[loop->num_latches++] = latch;
+
+            // Walk predecessors backwards from the latch until the header.
+            int sp = 0, found = 0;
+            if (mark[latch] != id) {
+                mark[latch] = id;
+                stack[sp++] = latch;
+            }
+            while (sp > 0) {
+                int b = stack[--sp];
+                members[found++] = b;
+                for (int q = 0; q < cfg->blocks[b].num_preds; q++) {
+                    int pred = cfg->blocks[b].preds[q];
+                    if (mark[pred] != id && cfg->blocks[pred].rpo_index >= 0) {
+                        mark[pred] = id;
+                        stack[sp++] = pred;
+                    }
+                }
+            }
+            loop->blocks = realloc(loop->blocks, (loop->num_blocks + found) * sizeof(int));
+            memcpy(loop->blocks + loop->num_blocks, members, found * sizeof(int));
+            loop->num_blocks += found;
+        }
+    }
+
+    qsort(cfg->loops, cfg->num_loops, sizeof(Loop), compare_loop_size);
+    for (int i = 0; i < cfg->num_loops; i++) {
+        Loop *loop = &cfg->loops[i];
+        qsort(loop->blocks, loop->num_blocks, sizeof(int), compare_int);
+        loop->parent = cfg->blocks[loop->header].loop;
+        loop->depth = loop->parent >= 0 ? cfg->loops[loop->parent].depth + 1 : 1;
+        for (int j = 0; j < loop->num_blocks; j++) cfg->blocks[loop->blocks[j]].loop = i;
+    }
+
+    // Number the loop tree the way the dominator tree is numbered, so
+    // membership is an interval check instead of a walk up the parents.
+    int *first_child = malloc((cfg->num_loops + 1) * sizeof(int));
+    int *next_sibling = malloc((cfg->num_loops + 1) * sizeof(int));
+    for (int i = 0; i < cfg->num_loops; i++) first_child[i] = next_sibling[i] = -1;
+    for (int i = cfg->num_loops - 1; i >= 0; i--) {
+        int parent = cfg->loops[i].parent;
+        if (parent < 0) continue;
+        next_sibling[i] = first_child[parent];
+        first_child[parent] = i;
+    }
+    int *loop_stack = malloc((cfg->num_loops + 1) * sizeof(int));
+    int counter = 0;
+    for (int root = 0; root < cfg->num_loops; root++) {
+        if (cfg->loops[root].parent >= 0) continue;
+        int sp = 0;
+        loop_stack[sp++] = root;
+        cfg->loops[root].loop_pre = counter++;
+        while (sp > 0) {
+            int l = loop_stack[sp - 1];
+            int child = first_child[l];
+            if (child >= 0) {
+                first_child[l] = next_sibling[child];
+                cfg->loops[child].loop_pre = counter++;
+                loop_stack[sp++] = child;
+            } else {
+                cfg->loops[l].loop_post = counter++;
+                sp--;
+            }
+        }
+    }
+
+    free(first_child);
+    free(next_sibling);
+    free(loop_stack);
+    free(loop_of_header);
+    free(mark);
+    free(stack);
+    free(members);
+}
+
+void cfg_build(CFG *cfg, IRList *list) {
+    memset(cfg, 0, sizeof(*cfg));
+    split_blocks(cfg, list);
+    link_blocks(cfg, list);
+    compute_rpo(cfg);
+    compute_dominators(cfg);
+    find_loops(cfg);
+}
+
+int cfg_loop_contains(CFG *cfg, int loop, int block) {
+    int l = cfg->blocks[block].loop;
+    if (l < 0) return 0;
+    Loop *outer = &cfg->loops[loop], *inner = &cfg->loops[l];
+    return outer->loop_pre <= inner->loop_pre && inner->loop_post <= outer->loop_post;
+}
+
+int cfg_loop_depth(CFG *cfg, int block) {
+    int loop = cfg->blocks[block].loop;
+    return loop >= 0 ? cfg->loops[loop].depth : 0;
+}
+
+void cfg_print(CFG *cfg, IRList *list) {
+    for (int b = 0; b < cfg->num_blocks; b++) {
+        BasicBlock *bb = &cfg->blocks[b];
+        printf("B%d", b);
+        if (list->insts[bb->start].op == IR_LABEL) printf(" (%s)", ir_label_name(list, list->insts[bb->start].label));
+        printf(": insts %d..%d", bb->start, bb->end - 1);
+        if (bb->rpo_index < 0) {
+            printf(" unreachable\n");
+            continue;
+        }
+        printf(" preds [");
+        for (int i = 0; i < bb->num_preds; i++) printf(i ? " B%d" : "B%d", bb->preds[i]);
+        printf("] succs [");
+        for (int i = 0; i < bb->num_succs; i++) printf(i ? " B%d" : "B%d", bb->succs[i]);
+        printf("]");
+        if (bb->idom >= 0) printf(" idom B%d", bb->idom);
+        if (bb->loop >= 0) printf(" loop L%d depth %d", bb->loop, cfg->loops[bb->loop].depth);
+        printf("\n");
+    }
+    for (int i = 0; i < cfg->num_loops; i++) {
+        Loop *loop = &cfg->loops[i];
+        printf("L%d: header B%d depth %d", i, loop->header, loop->depth);
+        if (loop->parent >= 0) printf(" parent L%d", loop->parent);
+        printf(" blocks [");
+        for (int j = 0; j < loop->num_blocks; j++) printf(j ? " B%d" : "B%d", loop->blocks[j]);
+        printf("]\n");
+    }
+}
+
+void cfg_free(CFG *cfg) {
+    for (int b = 0; b < cfg->num_blocks; b++) free(cfg->blocks[b].preds);
+    for (int i = 0; i < cfg->num_loops; i++) {
+        free(cfg->loops[i].blocks);
+        free(cfg->loops[i].latches);
+    }
+    free(cfg->blocks);
+    free(cfg->loops);
+    free(cfg->inst_block);
+    free(cfg->label_block);
+    free(cfg->rpo);
+    memset(cfg, 0, sizeof(*cfg));
+}
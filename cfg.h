@@ -0,0 +1,50 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include "ir.h"
+
+typedef struct {
+    int start;          // index of the first instruction (the label, if any)
+    int end;            // one past the last instruction
+    int succs[2];
+    int num_succs;
+    int *preds;
+    int num_preds;
+    int idom;           // immediate dominator, -1 for the entry and unreachable blocks
+    int rpo_index;      // position in reverse postorder, -1 if unreachable
+    int loop;           // innermost natural loop containing the block, -1 if none
+    int dom_pre;        // dominator tree DFS interval, for O(1) dominance queries
+    int dom_post;
+} BasicBlock;
+
+typedef struct {
+    int header;
+    int parent;         // enclosing loop, -1 for outermost loops
+    int depth;          // 1 for outermost loops
+    int *blocks;        // body including the header, in increasing block order
+    int num_blocks;
+    int *latches;       // sources of the back edges into the header
+    int num_latches;
+    int loop_pre;       // loop tree DFS interval, for O(1) membership queries
+    int loop_post;
+} Loop;
+
+typedef struct {
+    BasicBlock *blocks;
+    int num_blocks;
+    int *inst_block;    // instruction index -> block id
+    int *label_block;   // label id -> block id, -1 if the label is never placed
+    int *rpo;           // reachable blocks in reverse postorder
+    int num_rpo;
+    Loop *loops;        // outer loops come before the loops they contain
+    int num_loops;
+} CFG;
+
+void cfg_build(CFG *cfg, IRList *list);
+int cfg_dominates(CFG *cfg, int a, int b);
+int cfg_loop_contains(CFG *cfg, int loop, int block);
+int cfg_loop_depth(CFG *cfg, int block);
+void cfg_print(CFG *cfg, IRList *list);
+void cfg_free(CFG *cfg);
+
+#endif
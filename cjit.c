@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cjit.h"
+#include "compile.h"
+#include "vm.h"
+#include "jit.h"
+#include "tier.h"
+
+struct CJitContext {
+    OptOptions options;
+    int optimize;
+    CJitExecMode mode;
+    TierOptions tier;
+    char error[160];
+};
+
+struct CJitProgram {
+    CJitExecMode mode;
+    IRList ir;
+    VMProgram vm;
+    JitProgram native;
+    TieredProgram tiered;
+};
+
+CJitContext *cjit_create(void) {
+    CJitContext *ctx = calloc(1, sizeof(CJitContext));
+    if (!ctx) return NULL;
+    opt_options_init(&ctx->options);
+    ctx->optimize = 1;
+    ctx->mode = CJIT_EXEC_VM;
+    tier_options_init(&ctx->tier);
+    return ctx;
+}
+
+void cjit_destroy(CJitContext *ctx) {
+    free(ctx);
+}
+
+void cjit_set_optimize(CJitContext *ctx, int enabled) {
+    ctx->optimize = enabled;
+}
+
+void cjit_set_exec_mode(CJitContext *ctx, CJitExecMode mode) {
+    ctx->mode = mode;
+}
+
+const char *cjit_last_error(const CJitContext *ctx) {
+    return ctx->error;
+}
+
+CJitStatus cjit_compile(CJitContext *ctx, const char *source, size_t size, CJitProgram **out) {
+    *out = NULL;
+    ctx->error[0] = '\0';
+    if (!source) {
+        snprintf(ctx->error, sizeof(ctx->error), "no source");
+        return CJIT_ERR_ARGUMENT;
+    }
+    CJitProgram *prog = calloc(1, sizeof(CJitProgram));
+    CompileResult compiled;
+    CompileStatus status = compile_buffer(source, size, &prog->ir, ctx->optimize ? &ctx->options : NULL, &compiled);
+    if (status != COMPILE_OK) {
+        snprintf(ctx->error, sizeof(ctx->error), "%s", compiled.error);
+        free(prog);
+        return status == COMPILE_ERR_SYNTAX ? CJIT_ERR_SYNTAX : CJIT_ERR_SEMANTIC;
+    }
+
+    prog->mode = ctx->mode;
+    if (prog->mode == CJIT_EXEC_JIT && (!jit_available() || jit_compile(&prog->native, &prog->ir) != 0)) {
+        prog->mode = CJIT_EXEC_VM;
+    }
+    if (prog->mode == CJIT_EXEC_TIER) {
+        tier_compile(&prog->tiered, &prog->ir, &ctx->tier);
+    } else if (prog->mode == CJIT_EXEC_VM) {
+        vm_compile(&prog->vm, &prog->ir);
+    }
+    *out = prog;
+    return CJIT_OK;
+}
+
+CJitStatus cjit_run(CJitProgram *prog, const CJitBinding *bindings, int num_bindings, int *result) {
+    if (!prog || (num_bindings > 0 && !bindings)) return CJIT_ERR_ARGUMENT;
+    int *vars = calloc(prog->ir.var_count > 0 ? prog->ir.var_count : 1, sizeof(int));
+    for (int i = 0; i < num_bindings; i++) {
+        int slot = bindings[i].name ? ir_name_map_get(&prog->ir.var_ids, bindings[i].name) : -1;
+        if (slot >= 0) vars[slot] = bindings[i].value;
+    }
+
+    int trapped;
+    *result = 0;
+    if (prog->mode == CJIT_EXEC_JIT) {
+        int trap = JIT_OK;
+        *result = prog->native.entry(vars, &trap);
+        trapped = trap != JIT_OK;
+    } else if (prog->mode == CJIT_EXEC_TIER) {
+        trapped = tier_run(&prog->tiered, vars, result) != VM_OK;
+    } else {
+        trapped = vm_run(&prog->vm, vars, result) != VM_OK;
+    }
+    free(vars);
+    return trapped ? CJIT_ERR_DIV_ZERO : CJIT_OK;
+}
+
+void cjit_program_free(CJitProgram *prog) {
+    if (!prog) return;
+    if (prog->mode == CJIT_EXEC_JIT) jit_free(&prog->native);
+    else if (prog->mode == CJIT_EXEC_TIER) tier_free(&prog->tiered);
+    else vm_free(&prog->vm);
+    ir_free(&prog->ir);
+    free(prog);
+}
+
+const char *cjit_status_string(CJitStatus status) {
+    switch (status) {
+        case CJIT_OK: return "ok";
+        case CJIT_ERR_SYNTAX: return "syntax error";
+        case CJIT_ERR_SEMANTIC: return "semantic error";
+        case CJIT_ERR_DIV_ZERO: return "division by zero";
+        case CJIT_ERR_ARGUMENT: return "invalid argument";
+    }
+    return "unknown status";
+}
@@ -0,0 +1,56 @@
+#ifndef CJIT_H
+#define CJIT_H
+
+#include <stddef.h>
+
+// Embedding API (libcjit). A context holds compile settings and the last
+// error message; compiling source text yields a program handle that can be
+// run any number of times. Nothing exits the process: every failure is a
+// CJitStatus. Contexts share no state, so each thread may own one. A
+// program must be run by one thread at a time and stays valid after its
+// context is destroyed.
+typedef struct CJitContext CJitContext;
+typedef struct CJitProgram CJitProgram;
+
+typedef enum {
+    CJIT_OK,
+    CJIT_ERR_SYNTAX,
+    CJIT_ERR_SEMANTIC,      // redeclaration, use before declaration, ...
+    CJIT_ERR_DIV_ZERO,      // runtime trap
+    CJIT_ERR_ARGUMENT
+} CJitStatus;
+
+typedef enum {
+    CJIT_EXEC_VM,           // interpret
+    CJIT_EXEC_JIT,          // compile to native code up front
+    CJIT_EXEC_TIER          // interpret, compiling hot loops
+} CJitExecMode;
+
+// Starting value of a program variable for one run. Names the program does
+// not use are ignored.
+typedef struct {
+    const char *name;
+    int value;
+} CJitBinding;
+
+CJitContext *cjit_create(void);
+void cjit_destroy(CJitContext *ctx);
+
+// Settings for later compiles: optimization is on by default, the mode is
+// CJIT_EXEC_VM. Native modes fall back to the VM on hosts without the JIT.
+void cjit_set_optimize(CJitContext *ctx, int enabled);
+void cjit_set_exec_mode(CJitContext *ctx, CJitExecMode mode);
+
+// Compiles size bytes of source. On failure *out is NULL and
+// cjit_last_error describes the problem.
+CJitStatus cjit_compile(CJitContext *ctx, const char *source, size_t size, CJitProgram **out);
+const char *cjit_last_error(const CJitContext *ctx);
+
+// Runs prog with every variable zero except the bound ones, storing the
+// returned value (0 when the program ends without a return) in *result.
+CJitStatus cjit_run(CJitProgram *prog, const CJitBinding *bindings, int num_bindings, int *result);
+void cjit_program_free(CJitProgram *prog);
+
+const char *cjit_status_string(CJitStatus status);
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdio.h>
+#include "compile.h"
+#include "parser.h"
+#include "intern.h"
+
+// Runs an initialised parser to the end and releases it.
+static CompileStatus compile_parsed(Parser *parser, Arena *ast_arena, InternPool *atoms, IRList *ir,
+                                    const OptOptions *options, CompileResult *result) {
+    Stats *stats = options ? options->stats : NULL;
+    StatTimer timer;
+    parser->stats = stats;
+    stats_begin(stats, &timer);
+    ASTList *program = parse_program(parser);
+    stats_end(stats, STAT_PARSE, &timer, 0);
+    parser_free(parser);
+    if (parser->failed) {
+        snprintf(result->error, sizeof(result->error), "%s", parser->error);
+        return COMPILE_ERR_SYNTAX;
+    }
+
+    for (ASTList *p = program; p; p = p->next) {
+        result->statements++;
+    }
+    if (options && options->verbose) printf("Parsed %d statements\n", result->statements);
+    if (stats) {
+        stats->statements = result->statements;
+        stats->ast_nodes = parser->nodes;
+        stats->ast_bytes = ast_arena->bytes_allocated;
+        stats->atoms = atom_count(atoms);
+    }
+
+    ir_list_init(ir);
+    stats_begin(stats, &timer);
+    int status = ir_generate_program(ir, program, atoms, result->error, sizeof(result->error));
+    stats_end(stats, STAT_IRGEN, &timer, 0);
+    if (status != 0) {
+        ir_free(ir);
+        return COMPILE_ERR_SEMANTIC;
+    }
+    if (stats) stats->ir_generated = ir->count;
+    return COMPILE_OK;
+}
+
+static void compile_start(Arena *ast_arena, InternPool *atoms, CompileResult *result) {
+    result->statements = 0;
+    result->error[0] = '\0';
+    arena_init(ast_arena);
+    intern_init(atoms);
+}
+
+// The IR keeps its own copy of every name, so the AST and the atoms can go
+// before the optimizer runs.
+static CompileStatus compile_finish(CompileStatus status, Arena *ast_arena, InternPool *atoms, IRList *ir,
+                                    const OptOptions *options) {
+    intern_free(atoms);
+    arena_free(ast_arena);
+    if (status != COMPILE_OK || !options) return status;
+    ir_optimize(ir, options);
+    if (options->stats) {
+        options->stats->ir_optimized = ir->count;
+        options->stats->temps = ir->temp_count;
+        options->stats->vars = ir->var_count;
+        options->stats->labels = ir->label_count;
+    }
+    return status;
+}
+
+CompileStatus compile_source(FILE *source, IRList *ir, const OptOptions *options, CompileResult *result) {
+    Arena ast_arena;
+    InternPool atoms;
+    Parser parser;
+    compile_start(&ast_arena, &atoms, result);
+    parser_init(&parser, source, &ast_arena, &atoms);
+    CompileStatus status = compile_parsed(&parser, &ast_arena, &atoms, ir, options, result);
+    return compile_finish(status, &ast_arena, &atoms, ir, options);
+}
+
+CompileStatus compile_buffer(const char *src, size_t size, IRList *ir, const OptOptions *options,
+                             CompileResult *result) {
+    Arena ast_arena;
+    InternPool atoms;
+    Parser parser;
+    compile_start(&ast_arena, &atoms, result);
+    parser_init_buffer(&parser, src, size, &ast_arena, &atoms);
+    CompileStatus status = compile_parsed(&parser, &ast_arena, &atoms, ir, options, result);
+    return compile_finish(status, &ast_arena, &atoms, ir, options);
+}
@@ -0,0 +1,28 @@
+#ifndef COMPILE_H
+#define COMPILE_H
+
+#include <stdio.h>
+#include "ir.h"
+#include "optimizer.h"
+
+typedef enum {
+    COMPILE_OK,
+    COMPILE_ERR_SYNTAX,
+    COMPILE_ERR_SEMANTIC        // redeclarations, unsupported statements
+} CompileStatus;
+
+typedef struct {
+    int statements;         // top-level statements parsed
+    char error[160];        // why compilation failed, empty otherwise
+} CompileResult;
+
+// Parses, lowers and optimizes source into ir; a NULL options skips the
+// optimizer. Every compilation has its own lexer, parser and intern pool,
+// so separate calls may run on separate threads. On failure the reason is
+// in result->error and nothing is left allocated in ir.
+CompileStatus compile_source(FILE *source, IRList *ir, const OptOptions *options, CompileResult *result);
+// The same for size bytes of source text in memory.
+CompileStatus compile_buffer(const char *src, size_t size, IRList *ir, const OptOptions *options,
+                             CompileResult *result);
+
+#endif
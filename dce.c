@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+#include "dce.h"
+#include "cfg.h"
+
+static void kill(IRInst *inst) {
+    inst->op = IR_NOP;
+    inst->dest = inst->src1 = inst->src2 = -1;
+}
+
+static int remove_unreachable(IRList *list, CFG *cfg) {
+    int removed = 0;
+    for (int b = 0; b < cfg->num_blocks; b++) {
+        if (cfg->blocks[b].rpo_index >= 0) continue;
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            if (list->insts[i].op == IR_NOP) continue;
+            kill(&list->insts[i]);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+typedef struct {
+    int var;
+    int at;             // block for an exposed load, instruction for a store
+} VarRef;
+
+static void push_ref(VarRef **refs, int *count, int *capacity, int var, int at) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *refs = realloc(*refs, *capacity * sizeof(VarRef));
+    }
+    (*refs)[*count].var = var;
+    (*refs)[*count].at = at;
+    (*count)++;
+}
+
+// Groups refs by variable: refs of var v end up in sorted[first[v],
+// first[v + 1]).
+static VarRef *group_by_var(VarRef *refs, int count, int nv, int *first) {
+    VarRef *sorted = malloc((count + 1) * sizeof(VarRef));
+    memset(first, 0, (nv + 1) * sizeof(int));
+    for (int k = 0; k < count; k++) first[refs[k].var + 1]++;
+    for (int v = 0; v < nv; v++) first[v + 1] += first[v];
+    int *fill = malloc((nv + 1) * sizeof(int));
+    memcpy(fill, first, (nv + 1) * sizeof(int));
+    for (int k = 0; k < count; k++) sorted[fill[refs[k].var]++] = refs[k];
+    free(fill);
+    return sorted;
+}
+
+// Stores followed in their block by another store of the variable go in a
+// backward scan of each block. The last store in a block is dead unless the
+// variable is live out of it, which is found per variable by walking
+// predecessors back from the blocks that load it before storing it, so the
+// work follows the live ranges rather than variables x blocks. Variables
+// are not observable once the program returns, so nothing is live at exit.
+static int remove_dead_stores(IRList *list, CFG *cfg) {
+    int nv = list->var_count, nb = cfg->num_blocks;
+    if (nv <= 0 || nb <= 0) return 0;
+    int *next_access = malloc((size_t)nv * sizeof(int));    // what follows in the block
+    int *access_block = malloc((size_t)nv * sizeof(int));
+    for (int v = 0; v < nv; v++) access_block[v] = -1;
+    VarRef *exposed = NULL, *exits = NULL;
+    int num_exposed = 0, exposed_capacity = 0, num_exits = 0, exit_capacity = 0;
+    int *touched = malloc((size_t)nv * sizeof(int));
+
+    int removed = 0;
+    for (int r = 0; r < cfg->num_rpo; r++) {
+        int b = cfg->rpo[r], num_touched = 0;
+        for (int i = cfg->blocks[b].end - 1; i >= cfg->blocks[b].start; i--) {
+            IRInst *inst = &list->insts[i];
+            if (inst->op != IR_LOAD_VAR && inst->op != IR_STORE_VAR) continue;
+            int v = inst->var;
+            if (access_block[v] != b) {
+                access_block[v] = b;
+                touched[num_touched++] = v;
+                if (inst->op == IR_STORE_VAR) push_ref(&exits, &num_exits, &exit_capacity, v, i);
+            } else if (inst->op == IR_STORE_VAR && next_access[v] == IR_STORE_VAR) {
+                kill(inst);
+                removed++;
+                continue;
+            }
+            next_access[v] = inst->op;
+        }
+        for (int k = 0; k < num_touched; k++) {
+            if (next_access[touched[k]] == IR_LOAD_VAR) push_ref(&exposed, &num_exposed, &exposed_capacity, touched[k], b);
+        }
+    }
+
+    int *first_exposed = malloc((nv + 1) * sizeof(int));
+    int *first_exit = malloc((nv + 1) * sizeof(int));
+    VarRef *uses = group_by_var(exposed, num_exposed, nv, first_exposed);
+    VarRef *stores = group_by_var(exits, num_exits, nv, first_exit);
+    int *live_in = malloc((size_t)nb * sizeof(int));     // var live into the block, -1 for none
+    int *live_out = malloc((size_t)nb * sizeof(int));
+    int *stored = malloc((size_t)nb * sizeof(int));
+    int *work = malloc((size_t)nb * sizeof(int));
+    for (int b = 0; b < nb; b++) live_in[b] = live_out[b] = stored[b] = -1;
+
+    for (int v = 0; v < nv; v++) {
+        if (first_exit[v] == first_exit[v + 1]) continue;
+        for (int k = first_exit[v]; k < first_exit[v + 1]; k++) stored[cfg->inst_block[stores[k].at]] = v;
+        int sp = 0;
+        for (int k = first_exposed[v]; k < first_exposed[v + 1]; k++) {
+            live_in[uses[k].at] = v;
+            work[sp++] = uses[k].at;
+        }
+        while (sp > 0) {
+            BasicBlock *bb = &cfg->blocks[work[--sp]];
+            for (int k = 0; k < bb->num_preds; k++) {
+                int p = bb->preds[k];
+                if (cfg->blocks[p].rpo_index < 0) continue;
+                live_out[p] = v;
+                if (stored[p] == v || live_in[p] == v) continue;
+                live_in[p] = v;
+                work[sp++] = p;
+            }
+        }
+        for (int k = first_exit[v]; k < first_exit[v + 1]; k++) {
+            if (live_out[cfg->inst_block[stores[k].at]] == v) continue;
+            kill(&list->insts[stores[k].at]);
+            removed++;
+        }
+    }
+
+    free(next_access);
+    free(access_block);
+    free(touched);
+    free(exposed);
+    free(exits);
+    free(uses);
+    free(stores);
+    free(first_exposed);
+    free(first_exit);
+    free(live_in);
+    free(live_out);
+    free(stored);
+    free(work);
+    return removed;
+}
+
+// Division and modulo trap on a zero divisor, so they are only dead when
+// the divisor is a constant other than zero.
+static int may_trap(IRInst *inst, IRInst **const_def) {
+    if (inst->op != IR_DIV && inst->op != IR_MOD) return 0;
+    IRInst *d = const_def[inst->src2];
+    return !d || d->value == 0;
+}
+
+// Mark-free sweep driven by use counts: deleting an unused instruction
+// releases its operands, which may in turn become unused.
+static int remove_dead_temps(IRList *list) {
+    int n = list->temp_count;
+    int *uses = calloc(n + 1, sizeof(int));
+    int *defs = calloc(n + 1, sizeof(int));
+    IRInst **const_def = calloc(n + 1, sizeof(IRInst *));
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int srcs = ir_num_srcs(inst->op);
+        if (srcs > 0 && inst->src1 >= 0) uses[inst->src1]++;
+        if (srcs > 1 && inst->src2 >= 0) uses[inst->src2]++;
+        if (inst->op == IR_PHI) {
+            for (int k = 0; k < inst->src2; k++) {
+                if (list->phi_args[inst->src1 + k].temp >= 0) uses[list->phi_args[inst->src1 + k].temp]++;
+            }
+        }
+        if (ir_has_dest(inst->op) && inst->dest >= 0) {
+            defs[inst->dest]++;
+            if (inst->op == IR_LOAD_CONST) const_def[inst->dest] = inst;
+        }
+    }
+    for (int t = 0; t < n; t++) {
+        if (defs[t] != 1) const_def[t] = NULL;
+    }
+
+    int removed = 0;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = list->count - 1; i >= 0; i--) {
+            IRInst *inst = &list->insts[i];
+            if (!ir_has_dest(inst->op) || inst->dest < 0 || uses[inst->dest] > 0) continue;
+            if (may_trap(inst, const_def)) continue;
+            int srcs = ir_num_srcs(inst->op);
+            if (srcs > 0 && inst->src1 >= 0) uses[inst->src1]--;
+            if (srcs > 1 && inst->src2 >= 0) uses[inst->src2]--;
+            if (inst->op == IR_PHI) {
+                for (int k = 0; k < inst->src2; k++) {
+                    if (list->phi_args[inst->src1 + k].temp >= 0) uses[list->phi_args[inst->src1 + k].temp]--;
+                }
+            }
+            kill(inst);
+            removed++;
+            changed = 1;
+        }
+    }
+
+    free(uses);
+    free(defs);
+    free(const_def);
+    return removed;
+}
+
+// A branch whose target is reached by falling through anyway is dropped,
+// then labels nothing jumps to are deleted so their blocks merge.
+static int remove_redundant_jumps(IRList *list) {
+    int removed = 0;
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op != IR_JUMP && inst->op != IR_JUMP_IF_FALSE) continue;
+        for (int j = i + 1; j < list->count; j++) {
+            IRInst *next = &list->insts[j];
+            if (next->op == IR_NOP) continue;
+            if (next->op != IR_LABEL) break;
+            if (next->label == inst->label) {
+                kill(inst);
+                removed++;
+                break;
+            }
+        }
+    }
+
+    // Phi arguments name predecessor blocks, so block boundaries must stay
+    // put while the IR is in SSA form.
+    if (list->phi_arg_count > 0) return removed;
+
+    int *refs = calloc(list->label_count + 1, sizeof(int));
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op == IR_JUMP || inst->op == IR_JUMP_IF_FALSE) refs[inst->label]++;
+    }
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op == IR_LABEL && refs[inst->label] == 0) {
+            kill(inst);
+            removed++;
+        }
+    }
+    free(refs);
+    return removed;
+}
+
+int ir_eliminate_dead_code(IRList *list) {
+    int removed = 0, changed;
+    do {
+        CFG cfg;
+        cfg_build(&cfg, list);
+        changed = remove_unreachable(list, &cfg);
+        changed += remove_dead_stores(list, &cfg);
+        cfg_free(&cfg);
+        changed += remove_dead_temps(list);
+        changed += remove_redundant_jumps(list);
+        ir_remove_nops(list);
+        removed += changed;
+    } while (changed);
+    return removed;
+}
@@ -0,0 +1,14 @@
+#ifndef DCE_H
+#define DCE_H
+
+#include "ir.h"
+
+// Dead code elimination, repeated until nothing changes:
+//  - blocks unreachable from the entry (code after a return or jump)
+//  - jumps to the label that immediately follows, and unreferenced labels
+//  - stores to variables that are overwritten or never read again
+//  - instructions whose result is never used and that cannot trap
+// Returns the number of instructions removed.
+int ir_eliminate_dead_code(IRList *list);
+
+#endif
@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <string.h>
+#include "gvn.h"
+
+// An operand is either a temp or, when it is known, a constant value.
+typedef struct {
+    int is_const;
+    int value;
+} Operand;
+
+typedef struct {
+    int op;
+    int block;          // LOAD_CONST only, -1 otherwise
+    Operand a, b;
+} ValueKey;
+
+typedef struct {
+    ValueKey key;
+    int temp;
+    int bucket;
+    int next;           // next entry of the bucket, -1 at the end
+} ValueEntry;
+
+typedef struct {
+    IRList *list;
+    int *defs;          // definitions per temp
+    int *def_inst;      // the definition of single-def temps, else -1
+    int *repl;          // temp -> temp it was found equal to
+    int *heads;         // bucket -> newest entry, -1 if empty
+    int num_buckets;
+    ValueEntry *entries;
+    int num_entries;
+    int entry_capacity;
+} ValueTable;
+
+static int resolve(int *repl, int t) {
+    int root = t;
+    while (repl[root] != root) root = repl[root];
+    while (repl[t] != root) {
+        int next = repl[t];
+        repl[t] = root;
+        t = next;
+    }
+    return root;
+}
+
+static void substitute(ValueTable *vt, int32_t *operand) {
+    if (*operand >= 0) *operand = resolve(vt->repl, *operand);
+}
+
+static Operand operand_of(ValueTable *vt, int temp) {
+    Operand o = { 0, temp };
+    if (temp >= 0 && vt->def_inst[temp] >= 0) {
+        IRInst *def = &vt->list->insts[vt->def_inst[temp]];
+        if (def->op == IR_LOAD_CONST) {
+            o.is_const = 1;
+            o.value = def->value;
+        }
+    }
+    return o;
+}
+
+static int operand_less(Operand x, Operand y) {
+    if (x.is_const != y.is_const) return x.is_const < y.is_const;
+    return x.value < y.value;
+}
+
+static int operand_equal(Operand x, Operand y) {
+    return x.is_const == y.is_const && x.value == y.value;
+}
+
+static int is_commutative(IROp op) {
+    return op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NEQ || op == IR_AND || op == IR_OR;
+}
+
+// a > b is keyed as b < a and a >= b as b <= a; commutative operands are
+// sorted, so each computation has one key however it was written.
+static void normalise(ValueKey *key) {
+    if (key->op == IR_GT || key->op == IR_GE) {
+        key->op = key->op == IR_GT ? IR_LT : IR_LE;
+    } else if (!is_commutative((IROp)key->op) || !operand_less(key->b, key->a)) {
+        return;
+    }
+    Operand t = key->a;
+    key->a = key->b;
+    key->b = t;
+}
+
+static unsigned hash_key(const ValueKey *key) {
+    unsigned h = (unsigned)key->op * 0x9e3779b1u;
+    h = (h ^ (unsigned)key->block) * 0x85ebca6bu;
+    h = (h ^ (unsigned)key->a.is_const ^ ((unsigned)key->a.value << 1)) * 0xc2b2ae35u;
+    h = (h ^ (unsigned)key->b.is_const ^ ((unsigned)key->b.value << 1)) * 0x27d4eb2fu;
+    return h ^ (h >> 15);
+}
+
+static int key_equal(const ValueKey *x, const ValueKey *y) {
+    return x->op == y->op && x->block == y->block && operand_equal(x->a, y->a) && operand_equal(x->b, y->b);
+}
+
+static int lookup(ValueTable *vt, const ValueKey *key) {
+    unsigned bucket = hash_key(key) & (vt->num_buckets - 1);
+    for (int e = vt->heads[bucket]; e >= 0; e = vt->entries[e].next) {
+        if (key_equal(&vt->entries[e].key, key)) return vt->entries[e].temp;
+    }
+    return -1;
+}
+
+static void insert(ValueTable *vt, const ValueKey *key, int temp) {
+    if (vt->num_entries == vt->entry_capacity) {
+        vt->entry_capacity = vt->entry_capacity ? vt->entry_capacity * 2 : 64;
+        vt->entries = realloc(vt->entries, vt->entry_capacity * sizeof(ValueEntry));
+    }
+    unsigned bucket = hash_key(key) & (vt->num_buckets - 1);
+    ValueEntry *entry = &vt->entries[vt->num_entries];
+    entry->key = *key;
+    entry->temp = temp;
+    entry->bucket = bucket;
+    entry->next = vt->heads[bucket];
+    vt->heads[bucket] = vt->num_entries++;
+}
+
+// Drops the entries made since the table held count of them. Entries are
+// pushed onto the front of their bucket, so popping them in reverse order
+// restores every bucket.
+static void pop_scope(ValueTable *vt, int count) {
+    while (vt->num_entries > count) {
+        ValueEntry *entry = &vt->entries[--vt->num_entries];
+        vt->heads[entry->bucket] = entry->next;
+    }
+}
+
+static int single_def(ValueTable *vt, int temp) {
+    return temp < 0 || vt->defs[temp] == 1;
+}
+
+static void delete_inst(IRInst *inst) {
+    inst->op = IR_NOP;
+    inst->dest = inst->src1 = inst->src2 = -1;
+}
+
+// The one value a phi merges, ignoring its own back-edge arguments, or -1.
+static int trivial_phi(ValueTable *vt, IRInst *phi) {
+    int same = -1;
+    for (int k = 0; k < phi->src2; k++) {
+        int arg = vt->list->phi_args[phi->src1 + k].temp;
+        if (arg < 0) return -1;
+        arg = resolve(vt->repl, arg);
+        if (arg == phi->dest || arg == same) continue;
+        if (same >= 0) return -1;
+        same = arg;
+    }
+    return same;
+}
+
+static int number_block(ValueTable *vt, CFG *cfg, int b) {
+    IRList *list = vt->list;
+    int removed = 0;
+    for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+        IRInst *inst = &list->insts[i];
+        int srcs = ir_num_srcs(inst->op);
+        if (srcs > 0) substitute(vt, &inst->src1);
+        if (srcs > 1) substitute(vt, &inst->src2);
+        if (!ir_has_dest(inst->op) || inst->dest < 0 || vt->defs[inst->dest] != 1) continue;
+
+        if (inst->op == IR_PHI) {
+            int same = trivial_phi(vt, inst);
+            if (same >= 0) {
+                vt->repl[inst->dest] = same;
+                delete_inst(inst);
+                removed++;
+            }
+            continue;
+        }
+        if (inst->op == IR_COPY) {
+            if (!single_def(vt, inst->src1)) continue;
+            vt->repl[inst->dest] = inst->src1;
+            delete_inst(inst);
+            continue;
+        }
+
+        ValueKey key;
+        memset(&key, 0, sizeof(key));
+        key.op = inst->op;
+        key.block = -1;
+        if (inst->op == IR_LOAD_CONST) {
+            key.block = b;
+            key.a.is_const = 1;
+            key.a.value = inst->value;
+        } else if (ir_is_binop(inst->op) || ir_is_unop(inst->op)) {
+            // A reused division cannot trap: the dominating one already ran.
+            if (!single_def(vt, inst->src1) || (srcs > 1 && !single_def(vt, inst->src2))) continue;
+            key.a = operand_of(vt, inst->src1);
+            if (srcs > 1) key.b = operand_of(vt, inst->src2);
+            normalise(&key);
+        } else {
+            continue;
+        }
+
+        int leader = lookup(vt, &key);
+        if (leader >= 0) {
+            vt->repl[inst->dest] = leader;
+            delete_inst(inst);
+            removed++;
+        } else {
+            insert(vt, &key, inst->dest);
+        }
+    }
+    return removed;
+}
+
+int ir_value_number(IRList *list, CFG *cfg) {
+    int nb = cfg->num_blocks, n = list->temp_count;
+    if (cfg->num_rpo == 0) return 0;
+
+    ValueTable vt;
+    memset(&vt, 0, sizeof(vt));
+    vt.list = list;
+    vt.defs = calloc(n + 1, sizeof(int));
+    vt.def_inst = malloc((n + 1) * sizeof(int));
+    vt.repl = malloc((n + 1) * sizeof(int));
+    for (int t = 0; t < n; t++) {
+        vt.def_inst[t] = -1;
+        vt.repl[t] = t;
+    }
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (!ir_has_dest(inst->op) || inst->dest < 0) continue;
+        vt.defs[inst->dest]++;
+        vt.def_inst[inst->dest] = i;
+    }
+    for (int t = 0; t < n; t++) {
+        if (vt.defs[t] != 1) vt.def_inst[t] = -1;
+    }
+    vt.num_buckets = 64;
+    while (vt.num_buckets < list->count) vt.num_buckets *= 2;
+    vt.heads = malloc(vt.num_buckets * sizeof(int));
+    for (int k = 0; k < vt.num_buckets; k++) vt.heads[k] = -1;
+
+    // Preorder walk of the dominator tree: a block sees exactly the entries
+    // of the blocks dominating it.
+    int *first_child = malloc(nb * sizeof(int));
+    int *next_sibling = malloc(nb * sizeof(int));
+    for (int b = 0; b < nb; b++) first_child[b] = next_sibling[b] = -1;
+    for (int i = cfg->num_rpo - 1; i > 0; i--) {
+        int b = cfg->rpo[i];
+        next_sibling[b] = first_child[cfg->blocks[b].idom];
+        first_child[cfg->blocks[b].idom] = b;
+    }
+
+    int removed = 0;
+    int *stack = malloc(nb * sizeof(int));
+    int *mark = malloc(nb * sizeof(int));
+    int sp = 0;
+    stack[sp++] = cfg->rpo[0];
+    int visiting = 1;
+    while (sp > 0) {
+        int b = stack[sp - 1];
+        if (visiting) {
+            mark[b] = vt.num_entries;
+            removed += number_block(&vt, cfg, b);
+        }
+        int child = first_child[b];
+        if (child >= 0) {
+            first_child[b] = next_sibling[child];
+            stack[sp++] = child;
+            visiting = 1;
+        } else {
+            pop_scope(&vt, mark[b]);
+            sp--;
+            visiting = 0;
+        }
+    }
+
+    // Phi arguments flowing along back edges were read before their
+    // definitions were numbered.
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int srcs = ir_num_srcs(inst->op);
+        if (srcs > 0) substitute(&vt, &inst->src1);
+        if (srcs > 1) substitute(&vt, &inst->src2);
+        if (inst->op == IR_PHI) {
+            for (int k = 0; k < inst->src2; k++) substitute(&vt, &list->phi_args[inst->src1 + k].temp);
+        }
+    }
+
+    free(vt.defs);
+    free(vt.def_inst);
+    free(vt.repl);
+    free(vt.heads);
+    free(vt.entries);
+    free(first_child);
+    free(next_sibling);
+    free(stack);
+    free(mark);
+    return removed;
+}
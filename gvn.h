@@ -0,0 +1,17 @@
+#ifndef GVN_H
+#define GVN_H
+
+#include "ir.h"
+#include "cfg.h"
+
+// Value numbering over SSA form (see ssa_enter), walking the dominator tree
+// with a scoped hash table of (op, operands) -> temp. An instruction whose
+// key a dominating instruction already computed is deleted and its uses
+// read that temp instead; constant operands are keyed by value, and phis
+// whose arguments all agree become that value. Stores need no special care
+// as every variable is a versioned SSA temp by then. Constants are only
+// shared within a block to keep their live ranges short.
+// Returns the number of instructions removed.
+int ir_value_number(IRList *list, CFG *cfg);
+
+#endif
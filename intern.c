@@ -0,0 +1,70 @@
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "arena.h"
+
+void intern_init(InternPool *pool) {
+    memset(pool, 0, sizeof(*pool));
+    arena_init(&pool->strings);
+}
+
+static unsigned hash_bytes(const char *s, size_t len) {
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static void grow_table(InternPool *pool) {
+    unsigned size = pool->table ? (pool->mask + 1) * 2 : 1024;
+    free(pool->table);
+    pool->table = calloc(size, sizeof(int));
+    pool->mask = size - 1;
+    for (int a = 0; a < pool->count; a++) {
+        unsigned i = pool->hashes[a] & pool->mask;
+        while (pool->table[i]) i = (i + 1) & pool->mask;
+        pool->table[i] = a + 1;
+    }
+}
+
+Atom intern(InternPool *pool, const char *s, size_t len) {
+    if (!pool->table) grow_table(pool);
+    unsigned h = hash_bytes(s, len);
+    unsigned i = h & pool->mask;
+    while (pool->table[i]) {
+        Atom a = pool->table[i] - 1;
+        if (pool->hashes[a] == h && strncmp(pool->names[a], s, len) == 0 && pool->names[a][len] == '\0') return a;
+        i = (i + 1) & pool->mask;
+    }
+
+    if (pool->count == pool->capacity) {
+        pool->capacity = pool->capacity ? pool->capacity * 2 : 256;
+        pool->names = realloc(pool->names, pool->capacity * sizeof(char *));
+        pool->hashes = realloc(pool->hashes, pool->capacity * sizeof(unsigned));
+    }
+    Atom atom = pool->count++;
+    pool->names[atom] = arena_strndup(&pool->strings, s, len);
+    pool->hashes[atom] = h;
+    pool->table[i] = atom + 1;
+    if ((unsigned)pool->count * 2 > pool->mask + 1) grow_table(pool);
+    return atom;
+}
+
+Atom intern_cstr(InternPool *pool, const char *s) {
+    return intern(pool, s, strlen(s));
+}
+
+const char *atom_name(InternPool *pool, Atom atom) {
+    return pool->names[atom];
+}
+
+int atom_count(InternPool *pool) {
+    return pool->count;
+}
+
+void intern_free(InternPool *pool) {
+    arena_free(&pool->strings);
+    free(pool->names);
+    free(pool->hashes);
+    free(pool->table);
+    memset(pool, 0, sizeof(*pool));
+}
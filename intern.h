@@ -0,0 +1,29 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include "arena.h"
+
+// Identifier pool of one compilation. Each distinct name is stored once
+// and identified by a dense atom id, so names compare as integers. Pools
+// share nothing, so separate compilations may run on separate threads.
+typedef int Atom;
+
+typedef struct InternPool {
+    Arena strings;
+    const char **names;     // atom -> NUL-terminated name
+    unsigned *hashes;       // atom -> hash, so rehashing skips the strings
+    int count;
+    int capacity;
+    int *table;             // open addressing, atom + 1, 0 if empty
+    unsigned mask;
+} InternPool;
+
+void intern_init(InternPool *pool);
+Atom intern(InternPool *pool, const char *s, size_t len);
+Atom intern_cstr(InternPool *pool, const char *s);
+const char *atom_name(InternPool *pool, Atom atom);
+int atom_count(InternPool *pool);
+void intern_free(InternPool *pool);
+
+#endif
@@ -3,103 +3,225 @@
 #include <string.h>
 #include "ir.h"
 #include "parser.h"
+#include "symtab.h"
+#include "irbin.h"
 
 void ir_list_init(IRList *list) {
-    list->head = list->tail = NULL;
+    list->count = 0;
+    list->capacity = 256;
+    list->insts = malloc(list->capacity * sizeof(IRInst));
     list->temp_count = 0;
     list->label_count = 0;
+    list->label_capacity = 0;
+    list->label_names = NULL;
+    list->var_count = 0;
+    list->var_capacity = 0;
+    list->var_names = NULL;
+    ir_name_map_init(&list->var_ids);
+    arena_init(&list->names);
+    list->phi_args = NULL;
+    list->phi_arg_count = 0;
+    list->phi_arg_capacity = 0;
+    list->image = NULL;
+    list->image_size = 0;
 }
 
-static IRInst *ir_inst_new() {
-    IRInst *inst = malloc(sizeof(IRInst));
-    inst->next = NULL;
-    inst->var_name = NULL;
-    inst->label = NULL;
-    return inst;
+// Instructions of a module loaded in place live in its image until the
+// first time the list has to grow.
+static int ir_owns_insts(IRList *list) {
+    char *p = (char *)list->insts, *image = list->image;
+    return !image || p < image || p >= image + list->image_size;
 }
 
-static void ir_list_append(IRList *list, IRInst *inst) {
-    if (list->tail) {
-        list->tail->next = inst;
-        list->tail = inst;
-    } else {
-        list->head = list->tail = inst;
+int ir_var_id(IRList *list, const char *var_name) {
+    int id = ir_name_map_get(&list->var_ids, var_name);
+    if (id >= 0) return id;
+    if (list->var_count == list->var_capacity) {
+        list->var_capacity = list->var_capacity ? list->var_capacity * 2 : 16;
+        list->var_names = realloc(list->var_names, list->var_capacity * sizeof(char *));
     }
+    id = list->var_count++;
+    list->var_names[id] = arena_strdup(&list->names, var_name);
+    return ir_name_map_put(&list->var_ids, list->var_names[id], id);
+}
+
+const char *ir_var_name(IRList *list, int var) {
+    return list->var_names[var];
+}
+
+int ir_new_label(IRList *list, const char *prefix) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s_%d", prefix, list->label_count);
+    return ir_named_label(list, buf);
+}
+
+int ir_named_label(IRList *list, const char *name) {
+    if (list->label_count == list->label_capacity) {
+        list->label_capacity = list->label_capacity ? list->label_capacity * 2 : 16;
+        list->label_names = realloc(list->label_names, list->label_capacity * sizeof(char *));
+    }
+    list->label_names[list->label_count] = arena_strdup(&list->names, name);
+    return list->label_count++;
+}
+
+const char *ir_label_name(IRList *list, int label) {
+    return list->label_names[label];
+}
+
+void ir_append(IRList *list, IRInst inst) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 256;
+        if (ir_owns_insts(list)) {
+            list->insts = realloc(list->insts, list->capacity * sizeof(IRInst));
+        } else {
+            IRInst *insts = malloc(list->capacity * sizeof(IRInst));
+            memcpy(insts, list->insts, list->count * sizeof(IRInst));
+            list->insts = insts;
+        }
+    }
+    list->insts[list->count++] = inst;
+}
+
+int ir_is_binop(IROp op) {
+    return (op >= IR_ADD && op <= IR_MOD) || (op >= IR_EQ && op <= IR_OR);
+}
+
+int ir_is_unop(IROp op) {
+    return op == IR_NEG || op == IR_LOG_NOT || op == IR_BIT_NOT;
+}
+
+// Whether the instruction writes a temp through dest.
+int ir_has_dest(IROp op) {
+    return op == IR_LOAD_CONST || op == IR_LOAD_VAR || op == IR_COPY || op == IR_PHI ||
+           ir_is_binop(op) || ir_is_unop(op);
+}
+
+// Number of temp operands held in src1/src2 (phi arguments are separate).
+int ir_num_srcs(IROp op) {
+    if (ir_is_binop(op)) return 2;
+    if (ir_is_unop(op) || op == IR_COPY || op == IR_STORE_VAR || op == IR_JUMP_IF_FALSE || op == IR_RETURN) return 1;
+    return 0;
+}
+
+void ir_remove_nops(IRList *list) {
+    int out = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (list->insts[i].op != IR_NOP) list->insts[out++] = list->insts[i];
+    }
+    list->count = out;
+}
+
+// Stable merge sort of insertions by position.
+static void sort_insertions(IRInsertion *items, IRInsertion *scratch, int count) {
+    if (count < 2) return;
+    int half = count / 2;
+    sort_insertions(items, scratch, half);
+    sort_insertions(items + half, scratch, count - half);
+    int i = 0, j = half, k = 0;
+    while (i < half && j < count) scratch[k++] = items[j].pos < items[i].pos ? items[j++] : items[i++];
+    while (i < half) scratch[k++] = items[i++];
+    while (j < count) scratch[k++] = items[j++];
+    memcpy(items, scratch, count * sizeof(IRInsertion));
+}
+
+// Splices a batch of instructions into the list in one pass. Insertions at
+// the same position keep their relative order.
+void ir_insert(IRList *list, IRInsertion *insertions, int count) {
+    if (count == 0) return;
+    IRInsertion *sorted = malloc(count * sizeof(IRInsertion));
+    IRInsertion *scratch = malloc(count * sizeof(IRInsertion));
+    memcpy(sorted, insertions, count * sizeof(IRInsertion));
+    sort_insertions(sorted, scratch, count);
+
+    int total = list->count + count;
+    IRInst *insts = malloc((total + 1) * sizeof(IRInst));
+    int out = 0, k = 0;
+    for (int i = 0; i <= list->count; i++) {
+        while (k < count && sorted[k].pos <= i) insts[out++] = sorted[k++].inst;
+        if (i < list->count) insts[out++] = list->insts[i];
+    }
+    if (ir_owns_insts(list)) free(list->insts);
+    free(sorted);
+    free(scratch);
+    list->insts = insts;
+    list->count = total;
+    list->capacity = total + 1;
+}
+
+// Reserves count consecutive phi argument slots and returns the first index.
+int ir_new_phi_args(IRList *list, int count) {
+    if (list->phi_arg_count + count > list->phi_arg_capacity) {
+        while (list->phi_arg_count + count > list->phi_arg_capacity) {
+            list->phi_arg_capacity = list->phi_arg_capacity ? list->phi_arg_capacity * 2 : 64;
+        }
+        list->phi_args = realloc(list->phi_args, list->phi_arg_capacity * sizeof(IRPhiArg));
+    }
+    int first = list->phi_arg_count;
+    list->phi_arg_count += count;
+    return first;
+}
+
+static void ir_emit(IRList *list, IROp op, int dest, int src1, int src2) {
+    IRInst inst;
+    inst.op = op;
+    inst.dest = dest;
+    inst.src1 = src1;
+    inst.src2 = src2;
+    ir_append(list, inst);
 }
 
 int ir_emit_const(IRList *list, int value) {
-    IRInst *inst = ir_inst_new();
-    inst->op = IR_LOAD_CONST;
-    inst->dest = list->temp_count++;
-    inst->value = value;
-    ir_list_append(list, inst);
-    return inst->dest;
+    int dest = list->temp_count++;
+    ir_emit(list, IR_LOAD_CONST, dest, -1, value);
+    return dest;
 }
 
 int ir_emit_binop(IRList *list, IROp op, int left, int right) {
-    IRInst *inst = ir_inst_new();
-    inst->op = op;
-    inst->dest = list->temp_count++;
-    inst->src1 = left;
-    inst->src2 = right;
-    ir_list_append(list, inst);
-    return inst->dest;
-}
-
-int ir_emit_assign(IRList *list, const char *var_name, int src) {
-    IRInst *inst = ir_inst_new();
-    inst->op = IR_STORE_VAR;
-    inst->src1 = src;
-    inst->var_name = strdup(var_name);
-    ir_list_append(list, inst);
-    return -1;
+    int dest = list->temp_count++;
+    ir_emit(list, op, dest, left, right);
+    return dest;
 }
 
-int ir_emit_load_var(IRList *list, const char *var_name) {
-    IRInst *inst = ir_inst_new();
-    inst->op = IR_LOAD_VAR;
-    inst->dest = list->temp_count++;
-    inst->var_name = strdup(var_name);
-    ir_list_append(list, inst);
-    return inst->dest;
+int ir_emit_unop(IRList *list, IROp op, int operand) {
+    int dest = list->temp_count++;
+    ir_emit(list, op, dest, operand, -1);
+    return dest;
 }
 
-void ir_emit_label(IRList *list, const char *label) {
-    IRInst *inst = ir_inst_new();
-    inst->op = IR_LABEL;
-    inst->label = strdup(label);
-    ir_list_append(list, inst);
+int ir_emit_copy(IRList *list, int src) {
+    int dest = list->temp_count++;
+    ir_emit(list, IR_COPY, dest, src, -1);
+    return dest;
 }
 
-void ir_emit_jump(IRList *list, const char *label) {
-    IRInst *inst = ir_inst_new();
-    inst->op = IR_JUMP;
-    inst->label = strdup(label);
-    ir_list_append(list, inst);
+int ir_emit_assign(IRList *list, int var, int src) {
+    ir_emit(list, IR_STORE_VAR, -1, src, var);
+    return -1;
 }
 
-void ir_emit_jump_if_false(IRList *list, int cond, const char *label) {
-    IRInst *inst = ir_inst_new();
-    inst->op = IR_JUMP_IF_FALSE;
-    inst->src1 = cond;
-    inst->label = strdup(label);
-    ir_list_append(list, inst);
+int ir_emit_load_var(IRList *list, int var) {
+    int dest = list->temp_count++;
+    ir_emit(list, IR_LOAD_VAR, dest, -1, var);
+    return dest;
 }
 
-void ir_emit_return(IRList *list, int value) {
-    IRInst *inst = ir_inst_new();
-    inst->op = IR_RETURN;
-    inst->src1 = value;
-    ir_list_append(list, inst);
+void ir_emit_label(IRList *list, int label) {
+    ir_emit(list, IR_LABEL, -1, -1, label);
 }
 
-static char *ir_new_label(IRList *list, const char *prefix) {
-    char buf[32];
-    snprintf(buf, sizeof(buf), "%s_%d", prefix, list->label_count++);
-    return strdup(buf);
+void ir_emit_jump(IRList *list, int label) {
+    ir_emit(list, IR_JUMP, -1, -1, label);
+}
+
+void ir_emit_jump_if_false(IRList *list, int cond, int label) {
+    ir_emit(list, IR_JUMP_IF_FALSE, -1, cond, label);
+}
+
+void ir_emit_return(IRList *list, int value) {
+    ir_emit(list, IR_RETURN, -1, value, -1);
 }
 
-int ir_generate_expr(IRList *list, ASTNode *node) {
+int ir_generate_expr(IRList *list, SymbolTable *symbols, ASTNode *node) {
     if (!node) return -1;
 
     switch (node->type) {
@@ -107,17 +229,17 @@ int ir_generate_expr(IRList *list, ASTNode *node) {
             return ir_emit_const(list, node->number);
 
         case AST_VAR:
-            return ir_emit_load_var(list, node->var_name);
+            return ir_emit_load_var(list, symtab_resolve(symbols, node->var));
 
         case AST_ASSIGN: {
-            int rhs = ir_generate_expr(list, node->assign.rhs);
-            ir_emit_assign(list, node->assign.lhs->var_name, rhs);
+            int rhs = ir_generate_expr(list, symbols, node->assign.rhs);
+            ir_emit_assign(list, symtab_resolve(symbols, node->assign.lhs->var), rhs);
             return rhs;
         }
 
         case AST_BINARY_OP: {
-            int left = ir_generate_expr(list, node->binop.left);
-            int right = ir_generate_expr(list, node->binop.right);
+            int left = ir_generate_expr(list, symbols, node->binop.left);
+            int right = ir_generate_expr(list, symbols, node->binop.right);
             IROp op;
 
             switch (node->binop.op) {
@@ -142,20 +264,17 @@ int ir_generate_expr(IRList *list, ASTNode *node) {
         }
 
         case AST_UNARY_OP: {
-            int operand = ir_generate_expr(list, node->unop.operand);
-            IRInst *inst = ir_inst_new();
+            int operand = ir_generate_expr(list, symbols, node->unop.operand);
+            IROp op;
             switch (node->unop.op) {
-                case '-': inst->op = IR_NEG; break;
-                case '!': inst->op = IR_LOG_NOT; break;
-                case '~': inst->op = IR_BIT_NOT; break;
+                case '-': op = IR_NEG; break;
+                case '!': op = IR_LOG_NOT; break;
+                case '~': op = IR_BIT_NOT; break;
                 default:
                     fprintf(stderr, "Unknown unary op '%c'\n", node->unop.op);
                     exit(1);
             }
-            inst->dest = list->temp_count++;
-            inst->src1 = operand;
-            ir_list_append(list, inst);
-            return inst->dest;
+            return ir_emit_unop(list, op, operand);
         }
 
 
@@ -166,134 +285,156 @@ int ir_generate_expr(IRList *list, ASTNode *node) {
 }
 
 
-void ir_generate(IRList *list, ASTNode *node) {
-    if (!node) return;
+// Statements nested under if/while/for open their own scope, so a
+// declaration there never leaks into the enclosing block.
+static int ir_generate_scoped(IRList *list, SymbolTable *symbols, ASTNode *node) {
+    symtab_push_scope(symbols);
+    int status = ir_generate(list, symbols, node);
+    symtab_pop_scope(symbols);
+    return status;
+}
+
+int ir_generate(IRList *list, SymbolTable *symbols, ASTNode *node) {
+    if (!node) return 0;
+    int status;
 
     switch (node->type) {
-        case AST_DECL:
-        if (node->decl.init) {
-            int val = ir_generate_expr(list, node->decl.init);
-            ir_emit_assign(list, node->decl.var_name, val);
-        }
+        case AST_DECL: {
+            // The initializer is evaluated before the name comes into scope;
+            // a declaration without one starts the variable at 0.
+            int val = node->decl.init ? ir_generate_expr(list, symbols, node->decl.init)
+                                      : ir_emit_const(list, 0);
+            int var = symtab_declare(symbols, node->decl.var);
+            if (var < 0) return var;
+            ir_emit_assign(list, var, val);
             break;
+        }
 
         case AST_ASSIGN: {
-            int src = ir_generate_expr(list, node->assign.rhs);
-            ir_emit_assign(list, node->assign.lhs->var_name, src);
+            int src = ir_generate_expr(list, symbols, node->assign.rhs);
+            ir_emit_assign(list, symtab_resolve(symbols, node->assign.lhs->var), src);
             break;
         }
 
         case AST_EXPR_STMT:
-            ir_generate_expr(list, node->expr);
+            ir_generate_expr(list, symbols, node->expr);
             break;
 
         case AST_BLOCK: {
+            symtab_push_scope(symbols);
             ASTList *cur = node->block.stmts;
             while (cur) {
-                ir_generate(list, cur->stmt);
+                if ((status = ir_generate(list, symbols, cur->stmt)) != 0) return status;
                 cur = cur->next;
             }
+            symtab_pop_scope(symbols);
             break;
         }
 
         case AST_IF: {
-            int cond = ir_generate_expr(list, node->if_stmt.condition);
-            char *label_else = ir_new_label(list, "else");
-            char *label_end = ir_new_label(list, "endif");
+            int cond = ir_generate_expr(list, symbols, node->if_stmt.condition);
+            int label_else = ir_new_label(list, "else");
+            int label_end = ir_new_label(list, "endif");
 
             ir_emit_jump_if_false(list, cond, label_else);
-            ir_generate(list, node->if_stmt.then_stmt);
+            if ((status = ir_generate_scoped(list, symbols, node->if_stmt.then_stmt)) != 0) return status;
             ir_emit_jump(list, label_end);
 
             ir_emit_label(list, label_else);
             if (node->if_stmt.else_branch) {
-                ir_generate(list, node->if_stmt.else_branch);
+                if ((status = ir_generate_scoped(list, symbols, node->if_stmt.else_branch)) != 0) return status;
             }
             ir_emit_label(list, label_end);
-
-            free(label_else);
-            free(label_end);
             break;
         }
 
         case AST_WHILE: {
-            char *label_start = ir_new_label(list, "while_start");
-            char *label_end = ir_new_label(list, "while_end");
+            int label_start = ir_new_label(list, "while_start");
+            int label_end = ir_new_label(list, "while_end");
 
             ir_emit_label(list, label_start);
-            int cond = ir_generate_expr(list, node->while_stmt.condition);
+            int cond = ir_generate_expr(list, symbols, node->while_stmt.condition);
             ir_emit_jump_if_false(list, cond, label_end);
 
-            ir_generate(list, node->while_stmt.do_stmt);
+            if ((status = ir_generate_scoped(list, symbols, node->while_stmt.do_stmt)) != 0) return status;
             ir_emit_jump(list, label_start);
 
             ir_emit_label(list, label_end);
-
-            free(label_start);
-            free(label_end);
             break;
         }
 
         case AST_FOR: {
+            // A declaration in the init clause is scoped to the loop.
+            symtab_push_scope(symbols);
             if (node->for_stmt.init) {
-                ir_generate(list, node->for_stmt.init);
+                if ((status = ir_generate(list, symbols, node->for_stmt.init)) != 0) return status;
             }
 
-            char *label_start = ir_new_label(list, "for_start");
-            char *label_end = ir_new_label(list, "for_end");
+            int label_start = ir_new_label(list, "for_start");
+            int label_end = ir_new_label(list, "for_end");
 
             ir_emit_label(list, label_start);
 
             if (node->for_stmt.condition) {
-                int cond_val = ir_generate_expr(list, node->for_stmt.condition);
+                int cond_val = ir_generate_expr(list, symbols, node->for_stmt.condition);
                 ir_emit_jump_if_false(list, cond_val, label_end);
             }
 
-            ir_generate(list, node->for_stmt.body);
+            if ((status = ir_generate_scoped(list, symbols, node->for_stmt.body)) != 0) return status;
 
             if (node->for_stmt.update) {
-                ir_generate_expr(list, node->for_stmt.update);
+                ir_generate_expr(list, symbols, node->for_stmt.update);
             }
 
             ir_emit_jump(list, label_start);
             ir_emit_label(list, label_end);
-
-            free(label_start);
-            free(label_end);
+            symtab_pop_scope(symbols);
             break;
         }
 
 
         case AST_RETURN: {
-            int val = ir_generate_expr(list, node->expr);
+            int val = ir_generate_expr(list, symbols, node->expr);
             ir_emit_return(list, val);
             break;
         }
 
         default:
-            fprintf(stderr, "Unsupported statement node type %d\n", node->type);
-            exit(1);
+            return IR_ERR_UNSUPPORTED;
     }
+    return 0;
 }
 
-void ir_generate_program(IRList *list, ASTList *program) {
-    while (program) {
-        ir_generate(list, program->stmt);
-        program = program->next;
+int ir_generate_program(IRList *list, ASTList *program, InternPool *atoms, char *error, size_t error_size) {
+    SymbolTable symbols;
+    symtab_init(&symbols, list, atoms);
+    int status = 0;
+    for (; program && status == 0; program = program->next) {
+        status = ir_generate(list, &symbols, program->stmt);
+        if (status == SYM_ERR_REDECLARED) {
+            snprintf(error, error_size, "Error: redeclaration of '%s'", atom_name(atoms, symbols.rejected));
+        } else if (status == SYM_ERR_USED_BEFORE_DECL) {
+            snprintf(error, error_size, "Error: '%s' used before its declaration", atom_name(atoms, symbols.rejected));
+        } else if (status != 0) {
+            snprintf(error, error_size, "Error: unsupported statement");
+        }
     }
+    symtab_free(&symbols);
+    return status == 0 ? 0 : -1;
 }
 
 void ir_print(IRList *list) {
-    for (IRInst *inst = list->head; inst; inst = inst->next) {
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
         switch (inst->op) {
             case IR_LOAD_CONST:
                 printf("t%d = %d\n", inst->dest, inst->value);
                 break;
             case IR_LOAD_VAR:
-                printf("t%d = load %s\n", inst->dest, inst->var_name);
+                printf("t%d = load %s\n", inst->dest, ir_var_name(list, inst->var));
                 break;
             case IR_STORE_VAR:
-                printf("store %s, t%d\n", inst->var_name, inst->src1);
+                printf("store %s, t%d\n", ir_var_name(list, inst->var), inst->src1);
                 break;
             case IR_ADD:
                 printf("t%d = t%d + t%d\n", inst->dest, inst->src1, inst->src2);
@@ -335,13 +476,13 @@ void ir_print(IRList *list) {
                 printf("t%d = t%d || t%d\n", inst->dest, inst->src1, inst->src2);
                 break;
             case IR_LABEL:
-                printf("%s:\n", inst->label);
+                printf("%s:\n", ir_label_name(list, inst->label));
                 break;
             case IR_JUMP:
-                printf("jump %s\n", inst->label);
+                printf("jump %s\n", ir_label_name(list, inst->label));
                 break;
             case IR_JUMP_IF_FALSE:
-                printf("jump_if_false t%d, %s\n", inst->src1, inst->label);
+                printf("jump_if_false t%d, %s\n", inst->src1, ir_label_name(list, inst->label));
                 break;
             case IR_RETURN:
                 printf("return t%d\n", inst->src1);
@@ -356,6 +497,20 @@ void ir_print(IRList *list) {
             case IR_BIT_NOT:
                 printf("t%d = ~t%d\n", inst->dest, inst->src1);
                 break;
+            case IR_COPY:
+                printf("t%d = t%d\n", inst->dest, inst->src1);
+                break;
+            case IR_PHI:
+                printf("t%d = phi", inst->dest);
+                for (int k = 0; k < inst->src2; k++) {
+                    IRPhiArg *arg = &list->phi_args[inst->src1 + k];
+                    printf("%s[B%d: t%d]", k ? ", " : " ", arg->pred, arg->temp);
+                }
+                printf("\n");
+                break;
+            case IR_NOP:
+                printf("nop\n");
+                break;
 
             default:
                 printf("Unknown IR instruction\n");
@@ -365,13 +520,80 @@ void ir_print(IRList *list) {
 }
 
 void ir_free(IRList *list) {
-    IRInst *inst = list->head;
-    while (inst) {
-        IRInst *next = inst->next;
-        if (inst->var_name) free(inst->var_name);
-        if (inst->label) free(inst->label);
-        free(inst);
-        inst = next;
+    free(list->label_names);
+    free(list->var_names);
+    if (ir_owns_insts(list)) free(list->insts);
+    free(list->phi_args);
+    ir_name_map_free(&list->var_ids);
+    arena_free(&list->names);
+    if (list->image) irbin_free_image(list->image, list->image_size);
+    list->image = NULL;
+    list->image_size = 0;
+    list->insts = NULL;
+    list->phi_args = NULL;
+    list->phi_arg_count = list->phi_arg_capacity = 0;
+    list->label_names = NULL;
+    list->var_names = NULL;
+    list->count = list->capacity = 0;
+    list->label_count = list->label_capacity = 0;
+    list->var_count = list->var_capacity = 0;
+}
+
+static unsigned ir_hash_name(const char *s) {
+    unsigned h = 2166136261u;
+    while (*s) h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+void ir_name_map_init(IRNameMap *map) {
+    map->count = 0;
+    map->capacity = 64;
+    map->keys = calloc(map->capacity, sizeof(char *));
+    map->values = malloc(map->capacity * sizeof(int));
+}
+
+static int ir_name_map_find(IRNameMap *map, const char *name) {
+    unsigned mask = map->capacity - 1;
+    unsigned i = ir_hash_name(name) & mask;
+    while (map->keys[i] && strcmp(map->keys[i], name) != 0) i = (i + 1) & mask;
+    return i;
+}
+
+int ir_name_map_get(IRNameMap *map, const char *name) {
+    int i = ir_name_map_find(map, name);
+    return map->keys[i] ? map->values[i] : -1;
+}
+
+int ir_name_map_put(IRNameMap *map, const char *name, int value) {
+    if ((map->count + 1) * 2 > map->capacity) {
+        const char **old_keys = map->keys;
+        int *old_values = map->values;
+        int old_capacity = map->capacity;
+        map->capacity *= 2;
+        map->keys = calloc(map->capacity, sizeof(char *));
+        map->values = malloc(map->capacity * sizeof(int));
+        for (int i = 0; i < old_capacity; i++) {
+            if (!old_keys[i]) continue;
+            int j = ir_name_map_find(map, old_keys[i]);
+            map->keys[j] = old_keys[i];
+            map->values[j] = old_values[i];
+        }
+        free(old_keys);
+        free(old_values);
+    }
+    int i = ir_name_map_find(map, name);
+    if (!map->keys[i]) {
+        map->keys[i] = name;
+        map->count++;
     }
-    list->head = list->tail = NULL;
+    map->values[i] = value;
+    return value;
+}
+
+void ir_name_map_free(IRNameMap *map) {
+    free(map->keys);
+    free(map->values);
+    map->keys = NULL;
+    map->values = NULL;
+    map->count = map->capacity = 0;
 }
@@ -1,8 +1,14 @@
 #ifndef IR_H
 #define IR_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
 struct ASTNode;
 struct ASTList;
+struct SymbolTable;
+struct InternPool;
 
 typedef enum {
     IR_LOAD_CONST,
@@ -27,42 +33,111 @@ typedef enum {
     IR_LABEL,
     IR_JUMP,
     IR_JUMP_IF_FALSE,
-    IR_RETURN
+    IR_RETURN,
+    IR_COPY,      // dest = src1
+    IR_PHI,       // dest = phi(args), src1 = first IRPhiArg, src2 = arg count
+    IR_NOP        // deleted by a pass, dropped by ir_remove_nops
 } IROp;
 
-typedef struct IRInst {
-    IROp op;
-    int dest;
-    int src1;
-    int src2;
-    int value;
-    char *var_name;
-    char *label;
-    struct IRInst *next;
+// Fixed-size, index-addressed instruction. Variables and labels are
+// referenced by id; their names live once in the owning IRList.
+typedef struct {
+    uint8_t op;         // IROp
+    int32_t dest;
+    int32_t src1;
+    union {
+        int32_t src2;
+        int32_t value;  // IR_LOAD_CONST
+        int32_t var;    // IR_LOAD_VAR, IR_STORE_VAR
+        int32_t label;  // IR_LABEL, IR_JUMP, IR_JUMP_IF_FALSE
+    };
 } IRInst;
 
+// Incoming value of a phi: the temp flowing in from predecessor block pred
+// (a block id of the CFG the SSA form was built from).
 typedef struct {
-    IRInst *head;
-    IRInst *tail;
+    int32_t pred;
+    int32_t temp;
+} IRPhiArg;
+
+// Pending instruction for ir_insert: placed before the instruction
+// currently at index pos (or appended when pos == count).
+typedef struct {
+    int pos;
+    IRInst inst;
+} IRInsertion;
+
+// Maps names (variables, labels) to dense indices. Keys are borrowed, not
+// copied: they must outlive the map.
+typedef struct {
+    const char **keys;
+    int *values;
+    int count;
+    int capacity;
+} IRNameMap;
+
+typedef struct {
+    IRInst *insts;
+    int count;
+    int capacity;
     int temp_count;
     int label_count;
+    int label_capacity;
+    char **label_names;
+    int var_count;
+    int var_capacity;
+    char **var_names;
+    IRNameMap var_ids;
+    IRPhiArg *phi_args;
+    int phi_arg_count;
+    int phi_arg_capacity;
+    Arena names;        // label and variable name strings
+    void *image;        // binary module insts and names may point into (irbin.h)
+    size_t image_size;
 } IRList;
 
 void ir_list_init(IRList *list);
+int ir_var_id(IRList *list, const char *var_name);
+const char *ir_var_name(IRList *list, int var);
+int ir_new_label(IRList *list, const char *prefix);
+// Adds a label with exactly this name, for restoring a saved list.
+int ir_named_label(IRList *list, const char *name);
+const char *ir_label_name(IRList *list, int label);
+void ir_append(IRList *list, IRInst inst);
+int ir_is_binop(IROp op);
+int ir_is_unop(IROp op);
+int ir_has_dest(IROp op);
+int ir_num_srcs(IROp op);
+void ir_remove_nops(IRList *list);
+void ir_insert(IRList *list, IRInsertion *insertions, int count);
+int ir_new_phi_args(IRList *list, int count);
 int ir_emit_const(IRList *list, int value);
 int ir_emit_binop(IRList *list, IROp op, int left, int right);
-int ir_emit_assign(IRList *list, const char *var_name, int src);
-int ir_emit_load_var(IRList *list, const char *var_name);
-void ir_emit_label(IRList *list, const char *label);
-void ir_emit_jump(IRList *list, const char *label);
-void ir_emit_jump_if_false(IRList *list, int cond, const char *label);
+int ir_emit_unop(IRList *list, IROp op, int operand);
+int ir_emit_copy(IRList *list, int src);
+int ir_emit_assign(IRList *list, int var, int src);
+int ir_emit_load_var(IRList *list, int var);
+void ir_emit_label(IRList *list, int label);
+void ir_emit_jump(IRList *list, int label);
+void ir_emit_jump_if_false(IRList *list, int cond, int label);
 void ir_emit_return(IRList *list, int value);
 
-int ir_generate_expr(IRList *list, struct ASTNode *node);
-void ir_generate(IRList *list, struct ASTNode *node);
-void ir_generate_program(IRList *list, struct ASTList *program);
+int ir_generate_expr(IRList *list, struct SymbolTable *symbols, struct ASTNode *node);
+// Lowers one statement. Returns 0, a negative SymStatus for a rejected
+// declaration (its name is in symbols->rejected), or IR_ERR_UNSUPPORTED
+// for a statement the IR cannot express.
+#define IR_ERR_UNSUPPORTED (-3)
+int ir_generate(IRList *list, struct SymbolTable *symbols, struct ASTNode *node);
+// Lowers the whole program. Returns 0, or -1 with a message in error.
+int ir_generate_program(IRList *list, struct ASTList *program, struct InternPool *atoms,
+                        char *error, size_t error_size);
 
 void ir_print(IRList *list);
 void ir_free(IRList *list);
 
+void ir_name_map_init(IRNameMap *map);
+int ir_name_map_get(IRNameMap *map, const char *name);
+int ir_name_map_put(IRNameMap *map, const char *name, int value);
+void ir_name_map_free(IRNameMap *map);
+
 #endif
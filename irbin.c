@@ -0,0 +1,335 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "irbin.h"
+
+#if !defined(_WIN32)
+#define IRBIN_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define IRBIN_MMAP 0
+#include <process.h>
+#define getpid _getpid
+#endif
+
+#define HEADER_SIZE 48
+#define CHECKSUM_AT 40
+#define RECORD_SIZE 16
+
+typedef struct {
+    unsigned char *bytes;
+    size_t size;
+    size_t capacity;
+} ByteBuf;
+
+static void buf_reserve(ByteBuf *buf, size_t size) {
+    if (buf->size + size <= buf->capacity) return;
+    while (buf->size + size > buf->capacity) buf->capacity = buf->capacity ? buf->capacity * 2 : 4096;
+    buf->bytes = realloc(buf->bytes, buf->capacity);
+}
+
+static void buf_append(ByteBuf *buf, const void *data, size_t size) {
+    buf_reserve(buf, size);
+    memcpy(buf->bytes + buf->size, data, size);
+    buf->size += size;
+}
+
+static void buf_pad(ByteBuf *buf, size_t align) {
+    static const unsigned char zeros[16];
+    buf_append(buf, zeros, (align - buf->size % align) % align);
+}
+
+static void put_u16(unsigned char *p, unsigned v) {
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xff;
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (v >> (8 * i)) & 0xff;
+}
+
+static unsigned get_u16(const unsigned char *p) {
+    return p[0] | (unsigned)p[1] << 8;
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static uint64_t fnv1a(uint64_t h, const unsigned char *p, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static uint64_t image_checksum(const unsigned char *image, size_t size) {
+    static const unsigned char zeros[8];
+    uint64_t h = fnv1a(14695981039346656037ULL, image, CHECKSUM_AT);
+    h = fnv1a(h, zeros, sizeof(zeros));
+    return fnv1a(h, image + HEADER_SIZE, size - HEADER_SIZE);
+}
+
+// Records can be used in place when IRInst has the on-disk layout.
+static int native_layout(void) {
+    const uint32_t one = 1;
+    return *(const unsigned char *)&one == 1 && sizeof(IRInst) == RECORD_SIZE &&
+           offsetof(IRInst, dest) == 4 && offsetof(IRInst, src1) == 8 && offsetof(IRInst, src2) == 12;
+}
+
+void *irbin_encode(IRList *list, size_t *size) {
+    ByteBuf buf = { NULL, 0, 0 };
+    unsigned char header[HEADER_SIZE] = { 0 };
+    buf_append(&buf, header, sizeof(header));
+
+    buf_pad(&buf, RECORD_SIZE);
+    uint32_t inst_offset = (uint32_t)buf.size;
+    buf_reserve(&buf, (size_t)list->count * RECORD_SIZE);
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        unsigned char *rec = buf.bytes + buf.size;
+        memset(rec, 0, RECORD_SIZE);
+        rec[0] = inst->op;
+        put_u32(rec + 4, (uint32_t)inst->dest);
+        put_u32(rec + 8, (uint32_t)inst->src1);
+        put_u32(rec + 12, (uint32_t)inst->src2);
+        buf.size += RECORD_SIZE;
+    }
+
+    // Name index first, then the strings it points into.
+    uint32_t names_offset = (uint32_t)buf.size;
+    int num_names = list->var_count + list->label_count;
+    buf_reserve(&buf, (size_t)num_names * 4);
+    buf.size += (size_t)num_names * 4;
+    uint32_t strings_offset = (uint32_t)buf.size;
+    for (int k = 0; k < num_names; k++) {
+        const char *name = k < list->var_count ? ir_var_name(list, k) : ir_label_name(list, k - list->var_count);
+        put_u32(buf.bytes + names_offset + 4 * k, (uint32_t)(buf.size - strings_offset));
+        buf_append(&buf, name, strlen(name) + 1);
+    }
+    uint32_t strings_size = (uint32_t)(buf.size - strings_offset);
+
+    unsigned char *h = buf.bytes;
+    memcpy(h, IRBIN_MAGIC, 4);
+    put_u16(h + 4, IRBIN_VERSION);
+    put_u16(h + 6, HEADER_SIZE);
+    put_u32(h + 8, (uint32_t)list->count);
+    put_u32(h + 12, (uint32_t)list->temp_count);
+    put_u32(h + 16, (uint32_t)list->var_count);
+    put_u32(h + 20, (uint32_t)list->label_count);
+    put_u32(h + 24, inst_offset);
+    put_u32(h + 28, names_offset);
+    put_u32(h + 32, strings_offset);
+    put_u32(h + 36, strings_size);
+    put_u64(h + CHECKSUM_AT, image_checksum(buf.bytes, buf.size));
+    *size = buf.size;
+    return buf.bytes;
+}
+
+IRBinStatus irbin_write(IRList *list, const char *path) {
+    static unsigned serial;
+    size_t size;
+    void *image = irbin_encode(list, &size);
+    size_t len = strlen(path) + 32;
+    char *tmp = malloc(len);
+    snprintf(tmp, len, "%s.tmp.%ld.%u", path, (long)getpid(), __atomic_fetch_add(&serial, 1, __ATOMIC_RELAXED));
+    FILE *f = fopen(tmp, "wb");
+    int ok = f && fwrite(image, 1, size, f) == size;
+    if (f && fclose(f) != 0) ok = 0;
+#ifdef _WIN32
+    if (ok) remove(path);   // rename does not replace a file there
+#endif
+    if (ok && rename(tmp, path) != 0) ok = 0;
+    if (!ok) remove(tmp);
+    free(tmp);
+    free(image);
+    return ok ? IRBIN_OK : IRBIN_ERR_IO;
+}
+
+int irbin_is_module(const void *bytes, size_t size) {
+    return size >= 4 && memcmp(bytes, IRBIN_MAGIC, 4) == 0;
+}
+
+const char *irbin_status_string(IRBinStatus status) {
+    switch (status) {
+        case IRBIN_OK: return "ok";
+        case IRBIN_ERR_IO: return "cannot read or write the file";
+        case IRBIN_ERR_FORMAT: return "not a valid IR module";
+        case IRBIN_ERR_VERSION: return "unsupported IR module version";
+        default: return "checksum mismatch";
+    }
+}
+
+static int valid_inst(const IRInst *inst, const IRBinHeader *h) {
+    if (inst->op >= IR_PHI) return inst->op == IR_NOP;
+    int temps = (int)h->temp_count;
+    if (ir_has_dest(inst->op) && (inst->dest < 0 || inst->dest >= temps)) return 0;
+    int srcs = ir_num_srcs(inst->op);
+    if (srcs > 0 && (inst->src1 < 0 || inst->src1 >= temps)) return 0;
+    if (srcs > 1 && (inst->src2 < 0 || inst->src2 >= temps)) return 0;
+    switch (inst->op) {
+        case IR_LOAD_VAR:
+        case IR_STORE_VAR:
+            return inst->var >= 0 && inst->var < (int)h->var_count;
+        case IR_LABEL:
+        case IR_JUMP:
+        case IR_JUMP_IF_FALSE:
+            return inst->label >= 0 && inst->label < (int)h->label_count;
+        default:
+            return 1;
+    }
+}
+
+// Every label is placed at most once and every jump goes to a placed one,
+// so the interpreter and the JIT never meet an unknown target.
+static int labels_resolve(const IRInst *insts, const IRBinHeader *h) {
+    unsigned char *placed = calloc((size_t)h->label_count + 1, 1);
+    int ok = 1;
+    for (uint32_t i = 0; i < h->inst_count && ok; i++) {
+        if (insts[i].op != IR_LABEL) continue;
+        ok = !placed[insts[i].label];
+        placed[insts[i].label] = 1;
+    }
+    for (uint32_t i = 0; i < h->inst_count && ok; i++) {
+        if (insts[i].op == IR_JUMP || insts[i].op == IR_JUMP_IF_FALSE) ok = placed[insts[i].label];
+    }
+    free(placed);
+    return ok;
+}
+
+static int section_fits(size_t size, uint64_t offset, uint64_t length) {
+    return offset <= size && length <= size - offset;
+}
+
+// Checks the image and points list into it. The image is not yet owned by
+// list, so the caller releases it on failure.
+static IRBinStatus attach(IRList *list, unsigned char *image, size_t size) {
+    if (size < HEADER_SIZE || !irbin_is_module(image, size)) return IRBIN_ERR_FORMAT;
+    IRBinHeader h;
+    memcpy(h.magic, image, 4);
+    h.version = get_u16(image + 4);
+    h.header_size = get_u16(image + 6);
+    h.inst_count = get_u32(image + 8);
+    h.temp_count = get_u32(image + 12);
+    h.var_count = get_u32(image + 16);
+    h.label_count = get_u32(image + 20);
+    h.inst_offset = get_u32(image + 24);
+    h.names_offset = get_u32(image + 28);
+    h.strings_offset = get_u32(image + 32);
+    h.strings_size = get_u32(image + 36);
+    h.checksum = get_u64(image + CHECKSUM_AT);
+    if (h.version != IRBIN_VERSION) return IRBIN_ERR_VERSION;
+    if (h.header_size != HEADER_SIZE || h.inst_offset % RECORD_SIZE != 0 ||
+        h.inst_count > INT32_MAX || h.temp_count > INT32_MAX || h.var_count > INT32_MAX || h.label_count > INT32_MAX ||
+        !section_fits(size, h.inst_offset, (uint64_t)h.inst_count * RECORD_SIZE) ||
+        !section_fits(size, h.names_offset, ((uint64_t)h.var_count + h.label_count) * 4) ||
+        !section_fits(size, h.strings_offset, h.strings_size) ||
+        (h.strings_size > 0 && image[h.strings_offset + h.strings_size - 1] != '\0')) return IRBIN_ERR_FORMAT;
+    if (image_checksum(image, size) != h.checksum) return IRBIN_ERR_CHECKSUM;
+
+    int num_names = (int)(h.var_count + h.label_count);
+    for (int k = 0; k < num_names; k++) {
+        if (get_u32(image + h.names_offset + 4 * k) >= h.strings_size) return IRBIN_ERR_FORMAT;
+    }
+    IRInst *insts;
+    if (native_layout()) {
+        insts = (IRInst *)(image + h.inst_offset);
+    } else {
+        insts = malloc(((size_t)h.inst_count + 1) * sizeof(IRInst));
+        for (uint32_t i = 0; i < h.inst_count; i++) {
+            const unsigned char *rec = image + h.inst_offset + (size_t)i * RECORD_SIZE;
+            insts[i].op = rec[0];
+            insts[i].dest = (int32_t)get_u32(rec + 4);
+            insts[i].src1 = (int32_t)get_u32(rec + 8);
+            insts[i].src2 = (int32_t)get_u32(rec + 12);
+        }
+    }
+    int valid = 1;
+    for (uint32_t i = 0; i < h.inst_count && valid; i++) valid = valid_inst(&insts[i], &h);
+    if (!valid || !labels_resolve(insts, &h)) {
+        if (!native_layout()) free(insts);
+        return IRBIN_ERR_FORMAT;
+    }
+
+    ir_list_init(list);
+    free(list->insts);
+    list->insts = insts;
+    list->count = list->capacity = (int)h.inst_count;
+    list->temp_count = (int)h.temp_count;
+    const char *strings = (const char *)image + h.strings_offset;
+    list->var_names = malloc((h.var_count + 1) * sizeof(char *));
+    list->var_count = list->var_capacity = (int)h.var_count;
+    for (int v = 0; v < list->var_count; v++) {
+        list->var_names[v] = (char *)strings + get_u32(image + h.names_offset + 4 * v);
+        ir_name_map_put(&list->var_ids, list->var_names[v], v);
+    }
+    list->label_names = malloc((h.label_count + 1) * sizeof(char *));
+    list->label_count = list->label_capacity = (int)h.label_count;
+    for (int l = 0; l < list->label_count; l++) {
+        list->label_names[l] = (char *)strings + get_u32(image + h.names_offset + 4 * (h.var_count + l));
+    }
+    list->image = image;
+    list->image_size = size;
+    return IRBIN_OK;
+}
+
+IRBinStatus irbin_load(IRList *list, const char *path) {
+#if IRBIN_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return IRBIN_ERR_IO;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return IRBIN_ERR_IO;
+    }
+    if (st.st_size < HEADER_SIZE) {
+        close(fd);
+        return IRBIN_ERR_FORMAT;
+    }
+    size_t size = (size_t)st.st_size;
+    // Private and writable: passes rewrite instructions in place without
+    // touching the file.
+    void *image = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return IRBIN_ERR_IO;
+#else
+    FILE *f = fopen(path, "rb");
+    if (!f) return IRBIN_ERR_IO;
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    rewind(f);
+    size_t size = length > 0 ? (size_t)length : 0;
+    void *image = malloc(size + 1);
+    int ok = fread(image, 1, size, f) == size;
+    fclose(f);
+    if (!ok) {
+        free(image);
+        return IRBIN_ERR_IO;
+    }
+#endif
+    IRBinStatus status = attach(list, image, size);
+    if (status != IRBIN_OK) irbin_free_image(image, size);
+    return status;
+}
+
+void irbin_free_image(void *image, size_t size) {
+#if IRBIN_MMAP
+    munmap(image, size);
+#else
+    (void)size;
+    free(image);
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef IRBIN_H
+#define IRBIN_H
+
+#include <stddef.h>
+#include "ir.h"
+
+// Binary IR modules. All integers are little-endian and every reference is
+// a file offset, so an image is valid at any address:
+//
+//   header        IRBinHeader
+//   instructions  inst_count 16-byte records at inst_offset (16-aligned):
+//                 u8 op, 3 zero bytes, i32 dest, i32 src1, i32 src2/value/
+//                 var/label
+//   name index    var_count then label_count u32 offsets into the strings
+//   strings       NUL-terminated names
+//
+// The checksum is FNV-1a 64 over the whole file with the checksum field
+// zeroed. Readers reject other major versions.
+#define IRBIN_MAGIC "CJIR"
+#define IRBIN_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t inst_count;
+    uint32_t temp_count;
+    uint32_t var_count;
+    uint32_t label_count;
+    uint32_t inst_offset;
+    uint32_t names_offset;
+    uint32_t strings_offset;
+    uint32_t strings_size;
+    uint64_t checksum;
+} IRBinHeader;
+
+typedef enum {
+    IRBIN_OK,
+    IRBIN_ERR_IO,
+    IRBIN_ERR_FORMAT,       // not a module, truncated or inconsistent
+    IRBIN_ERR_VERSION,
+    IRBIN_ERR_CHECKSUM
+} IRBinStatus;
+
+// Serializes list (which must not be in SSA form) into a malloc'd image.
+void *irbin_encode(IRList *list, size_t *size);
+// Writes a temporary file next to path and renames it over path, so a
+// reader never sees half a module.
+IRBinStatus irbin_write(IRList *list, const char *path);
+
+// Maps the file copy-on-write and points list at it: on little-endian
+// hosts the instructions and names are used in place, so loading costs one
+// checksum pass and no per-instruction work beyond validation. The list
+// owns the mapping and releases it in ir_free; on failure it is left
+// uninitialised.
+IRBinStatus irbin_load(IRList *list, const char *path);
+// Whether the first bytes of a file are a module's magic number.
+int irbin_is_module(const void *bytes, size_t size);
+const char *irbin_status_string(IRBinStatus status);
+void irbin_free_image(void *image, size_t size);
+
+#endif
@@ -0,0 +1,802 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include "ivopt.h"
+
+#define DEF_NONE -1
+#define DEF_MULTI -2
+
+// Each round rewrites one more level of a loop nest; deeper nests keep
+// their outer levels rather than paying a CFG rebuild per level.
+#define IV_MAX_ROUNDS 8
+
+typedef struct {
+    int var;
+    int store;
+    int load;           // the load of var the update adds to
+    int step;           // temp added (or subtracted) each time
+    int negate;
+    int invariant;      // step does not change inside the loop
+    int source;         // accumulates another induction variable: its index, else -1
+    int after;          // that variable is read after its own update
+} Update;
+
+typedef struct {
+    int var;
+    int factor;
+    int reduced_var;
+} Reduction;
+
+typedef struct {
+    IRList *list;
+    CFG *cfg;
+    CountedLoop *counted;
+    int *def_inst;          // temp -> defining instruction, DEF_NONE or DEF_MULTI
+    int *uses;
+    int *block_stamp;       // block -> loop stamp, marks the current loop body
+    int *var_stamp;         // var -> loop stamp, marks variables stored in it
+    int *var_stores;        // stores of each marked variable inside the loop
+    int *iv_stamp;          // var -> loop stamp once classified by is_iv
+    unsigned char *is_iv;
+    int *copy_stamp;        // temp -> loop stamp when copied to the preheader
+    int *copy;
+    int stamp;
+    int *stores;            // store instructions of the current loop
+    int num_stores;
+    unsigned char *skip;    // loops left alone because a nested loop changed
+    int *label_refs;        // jumps to each label
+    int *loads;             // loads of each variable whose value is used
+    int *loop_loads;        // the part of those inside the current loop
+    unsigned char *dead_var;    // no longer read once a replaced loop is gone
+    int num_dead;
+    IRInsertion *insertions;
+    int num_insertions;
+    int insertion_capacity;
+} IVState;
+
+static int *find_defs(IRList *list) {
+    int *def_inst = malloc((list->temp_count + 1) * sizeof(int));
+    for (int t = 0; t < list->temp_count; t++) def_inst[t] = DEF_NONE;
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (!ir_has_dest(inst->op) || inst->dest < 0) continue;
+        def_inst[inst->dest] = def_inst[inst->dest] == DEF_NONE ? i : DEF_MULTI;
+    }
+    return def_inst;
+}
+
+static IRInst *def_of(IRList *list, const int *def_inst, int temp) {
+    if (temp < 0 || def_inst[temp] < 0) return NULL;
+    return &list->insts[def_inst[temp]];
+}
+
+static int const_value(IRList *list, const int *def_inst, int temp, int *value) {
+    IRInst *def = def_of(list, def_inst, temp);
+    if (!def || def->op != IR_LOAD_CONST) return 0;
+    *value = def->value;
+    return 1;
+}
+
+static int stores_between(IRList *list, int var, int from, int to) {
+    for (int i = from + 1; i < to; i++) {
+        if (list->insts[i].op == IR_STORE_VAR && list->insts[i].var == var) return 1;
+    }
+    return 0;
+}
+
+// Matches "store v, (load v) + step" with the operands either way round,
+// or "store v, (load v) - step", where the load is the value of v just
+// before the store. Returns the step temp, or -1.
+static int match_update(IRList *list, CFG *cfg, const int *def_inst, int store, int *negate, int *load) {
+    IRInst *st = &list->insts[store];
+    IRInst *sum = def_of(list, def_inst, st->src1);
+    if (!sum || (sum->op != IR_ADD && sum->op != IR_SUB)) return -1;
+    int ops[2] = { sum->src1, sum->src2 };
+    for (int k = 0; k < (sum->op == IR_ADD ? 2 : 1); k++) {
+        int l = ops[k] >= 0 ? def_inst[ops[k]] : DEF_NONE;
+        if (l < 0 || list->insts[l].op != IR_LOAD_VAR || list->insts[l].var != st->var) continue;
+        if (cfg->inst_block[l] != cfg->inst_block[store] || l > store) continue;
+        if (stores_between(list, st->var, l, store)) continue;
+        *negate = sum->op == IR_SUB;
+        if (load) *load = l;
+        return ops[1 - k];
+    }
+    return -1;
+}
+
+static IROp swap_compare(IROp op) {
+    switch (op) {
+        case IR_LT: return IR_GT;
+        case IR_GT: return IR_LT;
+        case IR_LE: return IR_GE;
+        case IR_GE: return IR_LE;
+        default: return op;
+    }
+}
+
+// Iterations of "for (v = start; v <cmp> bound; v += step)", or -1 when the
+// loop would not stop before v wraps around.
+static long long trip_count(IROp cmp, long long start, long long step, long long bound) {
+    if (cmp == IR_LE) {
+        cmp = IR_LT;
+        bound++;
+    } else if (cmp == IR_GE) {
+        cmp = IR_GT;
+        bound--;
+    }
+    long long trips;
+    switch (cmp) {
+        case IR_LT:
+            if (start >= bound) return 0;
+            if (step <= 0) return -1;
+            trips = (bound - start + step - 1) / step;
+            break;
+        case IR_GT:
+            if (start <= bound) return 0;
+            if (step >= 0) return -1;
+            trips = (start - bound - step - 1) / -step;
+            break;
+        case IR_NEQ:
+            if ((bound - start) % step != 0 || (bound - start) / step < 0) return -1;
+            trips = (bound - start) / step;
+            break;
+        case IR_EQ:
+            trips = start == bound;
+            break;
+        default:
+            return -1;
+    }
+    // Every value the header compares must be representable, the one that
+    // ends the loop included.
+    long long last = start + trips * step;
+    if (last < INT_MIN || last > INT_MAX) return -1;
+    return trips;
+}
+
+// The constant v holds just before instruction at of block b: the last
+// store to v earlier in the block, or in the straight-line chain leading to it.
+static int reaching_const(IRList *list, CFG *cfg, const int *def_inst, int b, int at, int var, int *value) {
+    for (int steps = 0; steps < cfg->num_blocks; steps++) {
+        BasicBlock *bb = &cfg->blocks[b];
+        for (int i = at - 1; i >= bb->start; i--) {
+            IRInst *inst = &list->insts[i];
+            if (inst->op == IR_STORE_VAR && inst->var == var) return const_value(list, def_inst, inst->src1, value);
+        }
+        if (bb->num_preds != 1 || cfg->blocks[bb->preds[0]].num_succs != 1) return 0;
+        b = bb->preds[0];
+        at = cfg->blocks[b].end;
+    }
+    return 0;
+}
+
+// Value of a loop bound computed before the loop from constants and
+// variables known to hold constants there.
+static int bound_value(IRList *list, CFG *cfg, const int *def_inst, int l, int temp, int *value, int depth) {
+    IRInst *def = def_of(list, def_inst, temp);
+    if (!def || depth > 8) return 0;
+    if (def->op == IR_LOAD_CONST) {
+        *value = def->value;
+        return 1;
+    }
+    int at = (int)(def - list->insts);
+    if (cfg_loop_contains(cfg, l, cfg->inst_block[at])) return 0;
+    int a, b;
+    switch (def->op) {
+        case IR_LOAD_VAR:
+            return reaching_const(list, cfg, def_inst, cfg->inst_block[at], at, def->var, value);
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+            if (!bound_value(list, cfg, def_inst, l, def->src1, &a, depth + 1) ||
+                !bound_value(list, cfg, def_inst, l, def->src2, &b, depth + 1)) return 0;
+            if (def->op == IR_ADD) *value = (int)((unsigned)a + (unsigned)b);
+            else if (def->op == IR_SUB) *value = (int)((unsigned)a - (unsigned)b);
+            else *value = (int)((unsigned)a * (unsigned)b);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// The header's only outside predecessor, which must fall into it rather
+// than jump, so code inserted before the header label runs once on entry.
+int iv_preheader_block(IRList *list, CFG *cfg, int l) {
+    Loop *loop = &cfg->loops[l];
+    BasicBlock *header = &cfg->blocks[loop->header];
+    int entry = -1;
+    for (int p = 0; p < header->num_preds; p++) {
+        if (cfg_loop_contains(cfg, l, header->preds[p])) continue;
+        if (entry >= 0) return -1;
+        entry = header->preds[p];
+    }
+    if (entry < 0 || entry != loop->header - 1) return -1;
+    IRInst *term = &list->insts[cfg->blocks[entry].end - 1];
+    if (term->op == IR_JUMP) return -1;
+    if (term->op == IR_JUMP_IF_FALSE && term->label == list->insts[header->start].label) return -1;
+    return entry;
+}
+
+// A constant, or a temp computed before the loop is entered.
+static int invariant_bound(IRList *list, CFG *cfg, const int *def_inst, int l, int temp) {
+    IRInst *def = def_of(list, def_inst, temp);
+    if (!def) return 0;
+    return def->op == IR_LOAD_CONST || !cfg_loop_contains(cfg, l, cfg->inst_block[def - list->insts]);
+}
+
+static void find_counted(IRList *list, CFG *cfg, const int *def_inst, int l, CountedLoop *out) {
+    out->var = -1;
+    out->trips = -1;
+    Loop *loop = &cfg->loops[l];
+    BasicBlock *header = &cfg->blocks[loop->header];
+    IRInst *term = &list->insts[header->end - 1];
+    if (list->insts[header->start].op != IR_LABEL || term->op != IR_JUMP_IF_FALSE) return;
+    int exit_block = cfg->label_block[term->label];
+    if (header->num_succs != 2 || exit_block < 0 || cfg_loop_contains(cfg, l, exit_block)) return;
+
+    // The header test must be the only way out.
+    for (int k = 0; k < loop->num_blocks; k++) {
+        BasicBlock *bb = &cfg->blocks[loop->blocks[k]];
+        if (list->insts[bb->end - 1].op == IR_RETURN) return;
+        if (loop->blocks[k] == loop->header) continue;
+        for (int s = 0; s < bb->num_succs; s++) {
+            if (!cfg_loop_contains(cfg, l, bb->succs[s])) return;
+        }
+    }
+
+    IRInst *cond = def_of(list, def_inst, term->src1);
+    if (!cond || cond->op < IR_EQ || cond->op > IR_GE || cfg->inst_block[cond - list->insts] != loop->header) return;
+    IRInst *lhs = def_of(list, def_inst, cond->src1);
+    IRInst *rhs = def_of(list, def_inst, cond->src2);
+    IROp cmp = cond->op;
+    IRInst *load;
+    int bound_temp;
+    if (lhs && lhs->op == IR_LOAD_VAR && invariant_bound(list, cfg, def_inst, l, cond->src2)) {
+        load = lhs;
+        bound_temp = cond->src2;
+    } else if (rhs && rhs->op == IR_LOAD_VAR && invariant_bound(list, cfg, def_inst, l, cond->src1)) {
+        load = rhs;
+        bound_temp = cond->src1;
+        cmp = swap_compare(cmp);
+    } else {
+        return;
+    }
+    if (cfg->inst_block[load - list->insts] != loop->header) return;
+    int var = load->var;
+
+    // One update per iteration: a single store outside any nested loop, in
+    // a block every back edge passes through.
+    int store = -1;
+    for (int k = 0; k < loop->num_blocks; k++) {
+        BasicBlock *bb = &cfg->blocks[loop->blocks[k]];
+        for (int i = bb->start; i < bb->end; i++) {
+            if (list->insts[i].op != IR_STORE_VAR || list->insts[i].var != var) continue;
+            if (store >= 0) return;
+            store = i;
+        }
+    }
+    if (store < 0) return;
+    int sb = cfg->inst_block[store];
+    if (sb == loop->header || cfg->blocks[sb].loop != l) return;
+    for (int k = 0; k < loop->num_latches; k++) {
+        if (!cfg_dominates(cfg, sb, loop->latches[k])) return;
+    }
+    int negate, step;
+    int step_temp = match_update(list, cfg, def_inst, store, &negate, NULL);
+    if (step_temp < 0 || !const_value(list, def_inst, step_temp, &step)) return;
+    if (negate) step = (int)(0u - (unsigned)step);
+    if (step == 0) return;
+
+    out->var = var;
+    out->step = step;
+    out->cmp = cmp;
+    out->bound_temp = bound_temp;
+    out->exit_label = term->label;
+
+    int entry = -1;
+    for (int p = 0; p < header->num_preds; p++) {
+        if (cfg_loop_contains(cfg, l, header->preds[p])) continue;
+        if (entry >= 0) return;
+        entry = header->preds[p];
+    }
+    int start, bound;
+    if (entry < 0 || !reaching_const(list, cfg, def_inst, entry, cfg->blocks[entry].end, var, &start)) return;
+    if (!bound_value(list, cfg, def_inst, l, bound_temp, &bound, 0)) return;
+    out->start = start;
+    out->bound = bound;
+    out->trips = trip_count(cmp, start, step, bound);
+}
+
+int *iv_find_defs(IRList *list) {
+    return find_defs(list);
+}
+
+void iv_find_counted(IRList *list, CFG *cfg, const int *def_inst, int l, CountedLoop *out) {
+    find_counted(list, cfg, def_inst, l, out);
+}
+
+static void add_insertion(IVState *s, int pos, IRInst inst) {
+    if (s->num_insertions == s->insertion_capacity) {
+        s->insertion_capacity = s->insertion_capacity ? s->insertion_capacity * 2 : 64;
+        s->insertions = realloc(s->insertions, s->insertion_capacity * sizeof(IRInsertion));
+    }
+    s->insertions[s->num_insertions].pos = pos;
+    s->insertions[s->num_insertions].inst = inst;
+    s->num_insertions++;
+}
+
+// Queues an instruction before pos; returns its fresh dest temp, if any.
+static int emit(IVState *s, int pos, IROp op, int src1, int src2) {
+    IRInst inst = { op, -1, src1, { .src2 = src2 } };
+    if (ir_has_dest(op)) inst.dest = s->list->temp_count++;
+    add_insertion(s, pos, inst);
+    return inst.dest;
+}
+
+static int in_loop(IVState *s, int inst) {
+    return s->block_stamp[s->cfg->inst_block[inst]] == s->stamp;
+}
+
+static void mark_loop(IVState *s, int l) {
+    Loop *loop = &s->cfg->loops[l];
+    s->stamp++;
+    s->num_stores = 0;
+    for (int k = 0; k < loop->num_blocks; k++) {
+        BasicBlock *bb = &s->cfg->blocks[loop->blocks[k]];
+        s->block_stamp[loop->blocks[k]] = s->stamp;
+        for (int i = bb->start; i < bb->end; i++) {
+            IRInst *inst = &s->list->insts[i];
+            if (inst->op != IR_STORE_VAR) continue;
+            if (s->var_stamp[inst->var] != s->stamp) {
+                s->var_stamp[inst->var] = s->stamp;
+                s->var_stores[inst->var] = 0;
+            }
+            s->var_stores[inst->var]++;
+            s->stores[s->num_stores++] = i;
+        }
+    }
+}
+
+static int nonzero_const(IVState *s, int temp) {
+    int value;
+    return const_value(s->list, s->def_inst, temp, &value) && value != 0;
+}
+
+// Whether the instruction computes a value without side effects or traps.
+static int is_pure(IVState *s, IRInst *inst) {
+    if (inst->op == IR_DIV || inst->op == IR_MOD) return nonzero_const(s, inst->src2);
+    return ir_is_binop(inst->op) || ir_is_unop(inst->op) || inst->op == IR_COPY ||
+           inst->op == IR_LOAD_CONST || inst->op == IR_LOAD_VAR;
+}
+
+static int is_invariant(IVState *s, int temp) {
+    if (temp < 0) return 1;
+    int def = s->def_inst[temp];
+    if (def == DEF_MULTI) return 0;
+    if (def == DEF_NONE || !in_loop(s, def)) return 1;
+    IRInst *inst = &s->list->insts[def];
+    if (inst->op == IR_LOAD_VAR) return s->var_stamp[inst->var] != s->stamp;
+    if (!is_pure(s, inst)) return 0;
+    int srcs = ir_num_srcs(inst->op);
+    return (srcs < 1 || is_invariant(s, inst->src1)) && (srcs < 2 || is_invariant(s, inst->src2));
+}
+
+// Recomputes an invariant temp in front of pos, copying whatever part of
+// its definition sits inside the loop.
+static int materialize(IVState *s, int pos, int temp) {
+    int def = s->def_inst[temp];
+    if (def < 0 || !in_loop(s, def)) return temp;
+    if (s->copy_stamp[temp] == s->stamp) return s->copy[temp];
+    IRInst inst = s->list->insts[def];
+    int srcs = ir_num_srcs(inst.op);
+    int a = srcs > 0 ? materialize(s, pos, inst.src1) : inst.src1;
+    int b = srcs > 1 ? materialize(s, pos, inst.src2) : inst.src2;
+    s->copy_stamp[temp] = s->stamp;
+    s->copy[temp] = emit(s, pos, (IROp)inst.op, a, b);
+    return s->copy[temp];
+}
+
+static void kill(IRInst *inst) {
+    inst->op = IR_NOP;
+    inst->dest = inst->src1 = inst->src2 = -1;
+}
+
+static int wrap(unsigned long long value) {
+    return (int)(uint32_t)value;
+}
+
+// A counted loop made of the header test and one straight-line body whose
+// every store is "v = v + step" is replaced by the final values: T * step
+// for invariant steps, and the arithmetic series T * w0 + step_w * T(T-1)/2
+// when the step is another such variable w.
+static int replace_closed_form(IVState *s, int l) {
+    IRList *list = s->list;
+    CFG *cfg = s->cfg;
+    Loop *loop = &cfg->loops[l];
+    CountedLoop *c = &s->counted[l];
+    if (c->trips < 0 || loop->num_blocks != 2 || iv_preheader_block(list, cfg, l) < 0) return 0;
+    BasicBlock *header = &cfg->blocks[loop->header];
+    BasicBlock *body = &cfg->blocks[loop->blocks[loop->blocks[0] == loop->header]];
+    IRInst *back = &list->insts[body->end - 1];
+    if (back->op != IR_JUMP || cfg->label_block[back->label] != loop->header) return 0;
+    for (int i = header->start + 1; i < header->end - 1; i++) {
+        if (!is_pure(s, &list->insts[i])) return 0;
+    }
+    for (int i = body->start; i < body->end - 1; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op != IR_STORE_VAR && inst->op != IR_LABEL && !is_pure(s, inst)) return 0;
+    }
+
+    int n = s->num_stores;
+    Update *updates = malloc((n + 1) * sizeof(Update));
+    int ok = 1;
+    for (int k = 0; k < n && ok; k++) {
+        Update *u = &updates[k];
+        u->store = s->stores[k];
+        u->var = list->insts[u->store].var;
+        u->step = match_update(list, cfg, s->def_inst, u->store, &u->negate, &u->load);
+        u->invariant = u->step >= 0 && is_invariant(s, u->step);
+        u->source = -1;
+        ok = s->var_stores[u->var] == 1 && u->step >= 0;
+    }
+    for (int k = 0; k < n && ok; k++) {
+        Update *u = &updates[k];
+        if (u->invariant) continue;
+        IRInst *d = def_of(list, s->def_inst, u->step);
+        ok = 0;
+        if (!d || d->op != IR_LOAD_VAR || s->uses[u->step] != 1) break;
+        for (int j = 0; j < n; j++) {
+            if (updates[j].var != d->var || !updates[j].invariant) continue;
+            u->source = j;
+            u->after = d - list->insts > updates[j].store;
+            ok = 1;
+        }
+    }
+
+    // Every other read of a stored variable would need its value in the
+    // middle of the loop.
+    for (int i = body->start; i < body->end && ok; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op != IR_LOAD_VAR || s->var_stamp[inst->var] != s->stamp || s->uses[inst->dest] == 0) continue;
+        int known = 0;
+        for (int k = 0; k < n; k++) {
+            if (updates[k].load == i && s->uses[inst->dest] == 1) known = 1;
+            if (updates[k].source >= 0 && updates[k].step == inst->dest) known = 1;
+        }
+        ok = known;
+    }
+    if (!ok) {
+        free(updates);
+        return 0;
+    }
+
+    // A variable only the loop reads needs no final value, and its other
+    // stores die with the loop, unless a series starts from its value.
+    for (int k = 0; k < n; k++) s->loop_loads[updates[k].var] = 0;
+    for (int k = 0; k < loop->num_blocks; k++) {
+        BasicBlock *bb = &cfg->blocks[loop->blocks[k]];
+        for (int i = bb->start; i < bb->end; i++) {
+            IRInst *inst = &list->insts[i];
+            if (inst->op != IR_LOAD_VAR || s->var_stamp[inst->var] != s->stamp) continue;
+            if (s->uses[inst->dest] > 0) s->loop_loads[inst->var]++;
+        }
+    }
+
+    int pos = header->start;
+    int *initial = malloc((n + 1) * sizeof(int));
+    for (int k = 0; k < n; k++) {
+        int var = updates[k].var;
+        initial[k] = var == c->var ? emit(s, pos, IR_LOAD_CONST, -1, c->start) : emit(s, pos, IR_LOAD_VAR, -1, var);
+    }
+    unsigned long long trips = (unsigned long long)c->trips;
+    int t = emit(s, pos, IR_LOAD_CONST, -1, wrap(trips));
+    for (int k = 0; k < n; k++) {
+        Update *u = &updates[k];
+        int read = 0;
+        for (int j = 0; j < n; j++) read |= updates[j].source == k;
+        if (!read && s->loads[u->var] == s->loop_loads[u->var]) {
+            if (!s->dead_var[u->var]) s->num_dead++;
+            s->dead_var[u->var] = 1;
+            continue;
+        }
+        int total;
+        if (u->invariant) {
+            total = emit(s, pos, IR_MUL, materialize(s, pos, u->step), t);
+        } else {
+            Update *w = &updates[u->source];
+            unsigned long long series = trips * (trips - 1) / 2 + (u->after ? trips : 0);
+            int first = emit(s, pos, IR_MUL, initial[u->source], t);
+            int steps = emit(s, pos, IR_LOAD_CONST, -1, wrap(series));
+            int rest = emit(s, pos, IR_MUL, materialize(s, pos, w->step), steps);
+            total = emit(s, pos, w->negate ? IR_SUB : IR_ADD, first, rest);
+        }
+        int final = emit(s, pos, u->negate ? IR_SUB : IR_ADD, initial[k], total);
+        emit(s, pos, IR_STORE_VAR, final, u->var);
+    }
+
+    // Delete the loop itself so the enclosing body is straight-line for the
+    // next round. When only the header test jumps to the exit label right
+    // after the loop, the final values fall through into it.
+    int last = header->end == body->start ? body->end : -1;
+    int falls = last >= 0 && last < list->count && list->insts[last].op == IR_LABEL &&
+                list->insts[last].label == c->exit_label && s->label_refs[c->exit_label] == 1;
+    if (!falls) emit(s, pos, IR_JUMP, -1, c->exit_label);
+    for (int k = 0; k < loop->num_blocks; k++) {
+        BasicBlock *bb = &cfg->blocks[loop->blocks[k]];
+        for (int i = bb->start; i < bb->end; i++) kill(&list->insts[i]);
+    }
+    if (falls) kill(&list->insts[last]);
+    free(initial);
+    free(updates);
+    return 1;
+}
+
+// Whether every store to var inside the loop adds or subtracts a constant.
+static int is_iv(IVState *s, int var) {
+    if (s->iv_stamp[var] == s->stamp) return s->is_iv[var];
+    int result = 1;
+    for (int k = 0; k < s->num_stores && result; k++) {
+        int store = s->stores[k];
+        if (s->list->insts[store].var != var) continue;
+        int negate, step;
+        int step_temp = match_update(s->list, s->cfg, s->def_inst, store, &negate, NULL);
+        result = step_temp >= 0 && const_value(s->list, s->def_inst, step_temp, &step);
+    }
+    s->iv_stamp[var] = s->stamp;
+    s->is_iv[var] = (unsigned char)result;
+    return result;
+}
+
+// Rewrites t = i * k to read a variable that tracks i * k: it starts as
+// i * k in the preheader and gains step * k wherever i gains step.
+static int reduce_strength(IVState *s, int l) {
+    IRList *list = s->list;
+    CFG *cfg = s->cfg;
+    Loop *loop = &cfg->loops[l];
+    if (iv_preheader_block(list, cfg, l) < 0) return 0;
+    int pos = cfg->blocks[loop->header].start;
+
+    Reduction *reductions = NULL;
+    int num_reductions = 0;
+    int reduced = 0;
+    for (int b = 0; b < loop->num_blocks; b++) {
+        BasicBlock *bb = &cfg->blocks[loop->blocks[b]];
+        for (int i = bb->start; i < bb->end; i++) {
+            IRInst *mul = &list->insts[i];
+            if (mul->op != IR_MUL) continue;
+            int ops[2] = { mul->src1, mul->src2 };
+            int var = -1, factor = 0;
+            for (int k = 0; k < 2 && var < 0; k++) {
+                IRInst *load = def_of(list, s->def_inst, ops[k]);
+                if (!load || load->op != IR_LOAD_VAR || s->var_stamp[load->var] != s->stamp) continue;
+                int at = (int)(load - list->insts);
+                if (cfg->inst_block[at] != cfg->inst_block[i] || stores_between(list, load->var, at, i)) continue;
+                if (!const_value(list, s->def_inst, ops[1 - k], &factor) || !is_iv(s, load->var)) continue;
+                var = load->var;
+            }
+            if (var < 0) continue;
+
+            int r = 0;
+            while (r < num_reductions && (reductions[r].var != var || reductions[r].factor != factor)) r++;
+            if (r == num_reductions) {
+                const char *base = ir_var_name(list, var);
+                char *name = malloc(strlen(base) + 32);
+                sprintf(name, "%s.iv%d", base, list->var_count);
+                int reduced_var = ir_var_id(list, name);
+                free(name);
+
+                int init = emit(s, pos, IR_LOAD_VAR, -1, var);
+                int k = emit(s, pos, IR_LOAD_CONST, -1, factor);
+                emit(s, pos, IR_STORE_VAR, emit(s, pos, IR_MUL, init, k), reduced_var);
+                for (int j = 0; j < s->num_stores; j++) {
+                    int store = s->stores[j];
+                    if (list->insts[store].var != var) continue;
+                    // is_iv has matched every update of var to a constant
+                    // step, so both lookups succeed.
+                    int negate = 0, step = 0;
+                    const_value(list, s->def_inst, match_update(list, cfg, s->def_inst, store, &negate, NULL), &step);
+                    unsigned bump = (unsigned)step * (unsigned)factor;
+                    int cur = emit(s, store + 1, IR_LOAD_VAR, -1, reduced_var);
+                    int inc = emit(s, store + 1, IR_LOAD_CONST, -1, (int)bump);
+                    emit(s, store + 1, IR_STORE_VAR, emit(s, store + 1, negate ? IR_SUB : IR_ADD, cur, inc), reduced_var);
+                }
+                reductions = realloc(reductions, (num_reductions + 1) * sizeof(Reduction));
+                reductions[num_reductions].var = var;
+                reductions[num_reductions].factor = factor;
+                reductions[num_reductions].reduced_var = reduced_var;
+                num_reductions++;
+            }
+            mul->op = IR_LOAD_VAR;
+            mul->src1 = -1;
+            mul->var = reductions[r].reduced_var;
+            reduced++;
+        }
+    }
+    free(reductions);
+    return reduced;
+}
+
+// An induction variable whose loads all feed its own updates, and that
+// nothing outside the loop reads, only keeps itself alive.
+static int eliminate_dead_ivs(IRList *list) {
+    CFG cfg;
+    cfg_build(&cfg, list);
+    int *def_inst = find_defs(list);
+    int *uses = calloc(list->temp_count + 1, sizeof(int));
+    int *loads = calloc(list->var_count + 1, sizeof(int));
+    int *loop_loads = calloc(list->var_count + 1, sizeof(int));
+    int *own_loads = calloc(list->var_count + 1, sizeof(int));
+    int *var_stamp = calloc(list->var_count + 1, sizeof(int));
+    unsigned char *live = calloc(list->var_count + 1, 1);
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int srcs = ir_num_srcs(inst->op);
+        if (srcs > 0 && inst->src1 >= 0) uses[inst->src1]++;
+        if (srcs > 1 && inst->src2 >= 0) uses[inst->src2]++;
+    }
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op == IR_LOAD_VAR && uses[inst->dest] > 0) loads[inst->var]++;
+    }
+
+    int eliminated = 0;
+    for (int l = 0; l < cfg.num_loops; l++) {
+        Loop *loop = &cfg.loops[l];
+        int stamp = l + 1;
+        for (int k = 0; k < loop->num_blocks; k++) {
+            BasicBlock *bb = &cfg.blocks[loop->blocks[k]];
+            for (int i = bb->start; i < bb->end; i++) {
+                IRInst *inst = &list->insts[i];
+                if (inst->op != IR_LOAD_VAR && inst->op != IR_STORE_VAR) continue;
+                if (var_stamp[inst->var] != stamp) {
+                    var_stamp[inst->var] = stamp;
+                    loop_loads[inst->var] = own_loads[inst->var] = 0;
+                    live[inst->var] = 0;
+                }
+                if (inst->op == IR_LOAD_VAR) {
+                    if (uses[inst->dest] > 0) loop_loads[inst->var]++;
+                    continue;
+                }
+                int negate, load;
+                if (match_update(list, &cfg, def_inst, i, &negate, &load) < 0 ||
+                    uses[list->insts[load].dest] != 1 || uses[inst->src1] != 1) {
+                    live[inst->var] = 1;
+                } else {
+                    own_loads[inst->var]++;
+                }
+            }
+        }
+        for (int k = 0; k < loop->num_blocks; k++) {
+            BasicBlock *bb = &cfg.blocks[loop->blocks[k]];
+            for (int i = bb->start; i < bb->end; i++) {
+                IRInst *inst = &list->insts[i];
+                if (inst->op != IR_STORE_VAR) continue;
+                int var = inst->var;
+                if (live[var] || loop_loads[var] != own_loads[var] || loads[var] != loop_loads[var]) continue;
+                if (own_loads[var] > 0) {
+                    own_loads[var] = 0;
+                    eliminated++;
+                }
+                inst->op = IR_NOP;
+                inst->dest = inst->src1 = inst->src2 = -1;
+            }
+        }
+    }
+    ir_remove_nops(list);
+
+    free(def_inst);
+    free(uses);
+    free(loads);
+    free(loop_loads);
+    free(own_loads);
+    free(var_stamp);
+    free(live);
+    cfg_free(&cfg);
+    return eliminated;
+}
+
+void ir_optimize_induction_vars(IRList *list, IVStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (int round = 0; round < IV_MAX_ROUNDS; round++) {
+        CFG cfg;
+        cfg_build(&cfg, list);
+        if (cfg.num_loops == 0) {
+            cfg_free(&cfg);
+            break;
+        }
+
+        IVState s;
+        memset(&s, 0, sizeof(s));
+        s.list = list;
+        s.cfg = &cfg;
+        s.def_inst = find_defs(list);
+        s.uses = calloc(list->temp_count + 1, sizeof(int));
+        s.counted = malloc(cfg.num_loops * sizeof(CountedLoop));
+        s.block_stamp = calloc(cfg.num_blocks + 1, sizeof(int));
+        s.var_stamp = calloc(list->var_count + 1, sizeof(int));
+        s.var_stores = calloc(list->var_count + 1, sizeof(int));
+        s.iv_stamp = calloc(list->var_count + 1, sizeof(int));
+        s.is_iv = calloc(list->var_count + 1, 1);
+        s.copy_stamp = calloc(list->temp_count + 1, sizeof(int));
+        s.copy = malloc((list->temp_count + 1) * sizeof(int));
+        s.stores = malloc((list->count + 1) * sizeof(int));
+        s.skip = calloc(cfg.num_loops, 1);
+        s.label_refs = calloc(list->label_count + 1, sizeof(int));
+        s.loads = calloc(list->var_count + 1, sizeof(int));
+        s.loop_loads = calloc(list->var_count + 1, sizeof(int));
+        s.dead_var = calloc(list->var_count + 1, 1);
+        int var_count = list->var_count;
+        for (int i = 0; i < list->count; i++) {
+            IRInst *inst = &list->insts[i];
+            int srcs = ir_num_srcs(inst->op);
+            if (srcs > 0 && inst->src1 >= 0) s.uses[inst->src1]++;
+            if (srcs > 1 && inst->src2 >= 0) s.uses[inst->src2]++;
+            if (inst->op == IR_JUMP || inst->op == IR_JUMP_IF_FALSE) s.label_refs[inst->label]++;
+        }
+        for (int i = 0; i < list->count; i++) {
+            IRInst *inst = &list->insts[i];
+            if (inst->op == IR_LOAD_VAR && s.uses[inst->dest] > 0) s.loads[inst->var]++;
+        }
+        // Every loop counts towards the statistics once; later rounds only
+        // look again at the loops they may still rewrite.
+        if (round == 0) {
+            for (int l = 0; l < cfg.num_loops; l++) {
+                find_counted(list, &cfg, s.def_inst, l, &s.counted[l]);
+                if (s.counted[l].trips >= 0) stats->counted++;
+            }
+        }
+
+        // Inner loops first; a loop whose body changed leaves its parents
+        // to the next round, which sees the rewritten code.
+        int closed = 0, reduced = 0;
+        for (int l = cfg.num_loops - 1; l >= 0; l--) {
+            if (s.skip[l]) continue;
+            if (round > 0) find_counted(list, &cfg, s.def_inst, l, &s.counted[l]);
+            mark_loop(&s, l);
+            int changed;
+            if (replace_closed_form(&s, l)) {
+                closed++;
+                changed = 1;
+            } else {
+                changed = reduce_strength(&s, l);
+                reduced += changed;
+            }
+            if (!changed) continue;
+            for (int p = cfg.loops[l].parent; p >= 0 && !s.skip[p]; p = cfg.loops[p].parent) s.skip[p] = 1;
+        }
+
+        ir_insert(list, s.insertions, s.num_insertions);
+        if (s.num_dead > 0) {
+            for (int i = 0; i < list->count; i++) {
+                IRInst *inst = &list->insts[i];
+                // Variables the round added are never dead.
+                if (inst->op == IR_STORE_VAR && inst->var < var_count && s.dead_var[inst->var]) kill(inst);
+            }
+        }
+        if (closed) ir_remove_nops(list);
+        free(s.def_inst);
+        free(s.uses);
+        free(s.counted);
+        free(s.block_stamp);
+        free(s.var_stamp);
+        free(s.var_stores);
+        free(s.iv_stamp);
+        free(s.is_iv);
+        free(s.copy_stamp);
+        free(s.copy);
+        free(s.stores);
+        free(s.skip);
+        free(s.label_refs);
+        free(s.loads);
+        free(s.loop_loads);
+        free(s.dead_var);
+        free(s.insertions);
+        cfg_free(&cfg);
+
+        stats->closed_form += closed;
+        stats->reduced += reduced;
+        if (closed + reduced == 0) break;
+    }
+    stats->eliminated = eliminate_dead_ivs(list);
+}
@@ -0,0 +1,48 @@
+#ifndef IVOPT_H
+#define IVOPT_H
+
+#include "ir.h"
+#include "cfg.h"
+
+// A loop the header leaves once "var <cmp> bound" is false, where var moves
+// by a constant step exactly once per iteration and bound is a constant or
+// a temp computed before the loop. When var also starts from a known
+// constant and bound is one, the iteration count is known.
+typedef struct {
+    int var;            // -1 when the header does not test an induction variable
+    int step;
+    IROp cmp;           // normalised so the variable is the left operand
+    int bound_temp;
+    int exit_label;     // target of the header's exit branch
+    long long trips;    // times the body runs, -1 when not counted
+    int start;          // valid when trips >= 0
+    int bound;
+} CountedLoop;
+
+typedef struct {
+    int counted;        // loops with a constant trip count
+    int closed_form;    // loops replaced by their final values
+    int reduced;        // multiplications turned into running additions
+    int eliminated;     // induction variables only their own updates read
+} IVStats;
+
+// Temp -> defining instruction, as iv_find_counted expects; free() it.
+int *iv_find_defs(IRList *list);
+
+// Fills *out for loop l of cfg. Expects memory-form IR.
+void iv_find_counted(IRList *list, CFG *cfg, const int *def_inst, int l, CountedLoop *out);
+
+// The block that falls into loop l's header when it is the only way in,
+// so code placed before the header label runs once per entry; -1 if none.
+int iv_preheader_block(IRList *list, CFG *cfg, int l);
+
+// Induction variable optimizations over memory-form IR, inner loops first:
+//  - counted loops whose body only adds invariants or other induction
+//    variables into variables are replaced by the closed-form final values
+//  - "i * k" for an induction variable i and constant k becomes a new
+//    variable initialised in the preheader and bumped next to every update
+//    of i
+//  - induction variables read only by their own updates are deleted
+void ir_optimize_induction_vars(IRList *list, IVStats *stats);
+
+#endif
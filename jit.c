@@ -0,0 +1,514 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jit.h"
+#include "regalloc.h"
+
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+int jit_available(void) {
+    return JIT_SUPPORTED;
+}
+
+static void copy_var_names(JitProgram *prog, IRList *list) {
+    prog->num_vars = list->var_count;
+    prog->var_names = malloc((list->var_count + 1) * sizeof(char *));
+    for (int i = 0; i < list->var_count; i++) prog->var_names[i] = strdup(ir_var_name(list, i));
+}
+
+int jit_var_slot(JitProgram *prog, const char *name) {
+    for (int i = 0; i < prog->num_vars; i++) {
+        if (strcmp(prog->var_names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+#if JIT_SUPPORTED
+
+typedef struct {
+    unsigned char *bytes;
+    size_t size;
+    size_t capacity;
+} CodeBuf;
+
+typedef struct {
+    size_t at;          // offset of the rel32 field to patch
+    int label;
+} Fixup;
+
+static void emit_byte(CodeBuf *buf, unsigned char b) {
+    if (buf->size == buf->capacity) {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 4096;
+        buf->bytes = realloc(buf->bytes, buf->capacity);
+    }
+    buf->bytes[buf->size++] = b;
+}
+
+static void emit_bytes(CodeBuf *buf, const unsigned char *bytes, int n) {
+    for (int i = 0; i < n; i++) emit_byte(buf, bytes[i]);
+}
+
+static void emit_u32(CodeBuf *buf, unsigned v) {
+    for (int i = 0; i < 4; i++) emit_byte(buf, (v >> (8 * i)) & 0xff);
+}
+
+static void patch_rel32(CodeBuf *buf, size_t at, size_t target) {
+    int rel = (int)(target - (at + 4));
+    memcpy(buf->bytes + at, &rel, 4);
+}
+
+// Machine registers, in x86 encoding order.
+enum { EAX = 0, ECX = 1, EDX = 2, EBX = 3, EBP = 5, EDI = 7,
+       R8 = 8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Registers handed to the allocator. eax, ecx and edx stay free as scratch
+// for division and for operands that were spilled; rdi holds the variable
+// array and rsi the status pointer.
+static const int alloc_regs[] = { EBX, R12, R13, R14, R15, R8, R9, R10, R11 };
+
+// Callee-saved registers pushed below rbp by the prologue.
+#define SAVED_BYTES 40
+
+// A temp's home: a register, or a 32-bit slot at [base + disp].
+typedef struct {
+    int is_mem;
+    int reg;
+    int disp;
+} Operand;
+
+static Operand reg_operand(int reg) {
+    Operand op = { 0, reg, 0 };
+    return op;
+}
+
+static Operand mem_operand(int base, int disp) {
+    Operand op = { 1, base, disp };
+    return op;
+}
+
+static Operand temp_operand(RegAlloc *ra, int temp) {
+    if (ra->reg[temp] >= 0) return reg_operand(alloc_regs[ra->reg[temp]]);
+    return mem_operand(EBP, -SAVED_BYTES - 4 * (ra->spill_slot[temp] + 1));
+}
+
+static Operand var_operand(int slot) {
+    return mem_operand(EDI, 4 * slot);
+}
+
+// Emits [REX] opcode ModRM [disp32] for a 32-bit op with reg in the reg
+// field and rm as the register or [base + disp32] operand.
+static void emit_op(CodeBuf *buf, const unsigned char *opcode, int len, int reg, Operand rm) {
+    int rex = ((reg >> 3) << 2) | (rm.reg >> 3);
+    if (rex) emit_byte(buf, 0x40 | rex);
+    emit_bytes(buf, opcode, len);
+    if (rm.is_mem) {
+        emit_byte(buf, 0x80 | ((reg & 7) << 3) | (rm.reg & 7));
+        emit_u32(buf, (unsigned)rm.disp);
+    } else {
+        emit_byte(buf, 0xC0 | ((reg & 7) << 3) | (rm.reg & 7));
+    }
+}
+
+static void emit_op1(CodeBuf *buf, unsigned char opcode, int reg, Operand rm) {
+    emit_op(buf, &opcode, 1, reg, rm);
+}
+
+static int same_operand(Operand a, Operand b) {
+    return a.is_mem == b.is_mem && a.reg == b.reg && a.disp == b.disp;
+}
+
+// mov reg, src
+static void emit_load(CodeBuf *buf, int reg, Operand src) {
+    if (!src.is_mem && src.reg == reg) return;
+    emit_op1(buf, 0x8B, reg, src);
+}
+
+// mov dst, reg
+static void emit_store(CodeBuf *buf, Operand dst, int reg) {
+    if (!dst.is_mem && dst.reg == reg) return;
+    emit_op1(buf, 0x89, reg, dst);
+}
+
+// mov dst, src, through eax when both are in memory.
+static void emit_move(CodeBuf *buf, Operand dst, Operand src) {
+    if (same_operand(dst, src)) return;
+    if (!dst.is_mem) {
+        emit_load(buf, dst.reg, src);
+    } else if (!src.is_mem) {
+        emit_store(buf, dst, src.reg);
+    } else {
+        emit_load(buf, EAX, src);
+        emit_store(buf, dst, EAX);
+    }
+}
+
+// mov dst, imm32
+static void emit_move_imm(CodeBuf *buf, Operand dst, int value) {
+    emit_op1(buf, 0xC7, 0, dst);
+    emit_u32(buf, (unsigned)value);
+}
+
+// Sets the flags from a temp compared against zero.
+static void emit_test_zero(CodeBuf *buf, Operand src) {
+    if (src.is_mem) {
+        emit_op1(buf, 0x83, 7, src);                 // cmp dword [mem], 0
+        emit_byte(buf, 0x00);
+    } else {
+        emit_op1(buf, 0x85, src.reg, src);           // test reg, reg
+    }
+}
+
+// Restores the callee-saved registers and returns eax.
+static void emit_epilogue(CodeBuf *buf) {
+    const unsigned char seq[] = {
+        0x48, 0x8D, 0x65, (unsigned char)-SAVED_BYTES,  // lea rsp, [rbp - SAVED_BYTES]
+        0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, // pop r15; pop r14; pop r13; pop r12
+        0x5B, 0x5D, 0xC3                                // pop rbx; pop rbp; ret
+    };
+    emit_bytes(buf, seq, sizeof(seq));
+}
+
+// Shared path for division by zero: report the trap and return 0.
+static void emit_div_zero_exit(CodeBuf *buf) {
+    const unsigned char seq[] = {
+        0xC7, 0x06, JIT_ERR_DIV_ZERO, 0x00, 0x00, 0x00,   // mov dword [rsi], JIT_ERR_DIV_ZERO
+        0x31, 0xC0                                        // xor eax, eax
+    };
+    emit_bytes(buf, seq, sizeof(seq));
+    emit_epilogue(buf);
+}
+
+// eax = eax / ecx (or eax % ecx). x / -1 is lowered to a negation so that
+// INT_MIN / -1 wraps instead of raising #DE, matching the VM.
+static void emit_divide(CodeBuf *buf, int is_mod, size_t *div_zero_fixups, int *num_div_zero) {
+    const unsigned char test_ecx[] = { 0x85, 0xC9, 0x0F, 0x84 };   // test ecx, ecx; je rel32
+    emit_bytes(buf, test_ecx, sizeof(test_ecx));
+    div_zero_fixups[(*num_div_zero)++] = buf->size;
+    emit_u32(buf, 0);
+
+    const unsigned char minus_one[] = { 0x83, 0xF9, 0xFF, 0x75, 0x04 };   // cmp ecx, -1; jne +4
+    emit_bytes(buf, minus_one, sizeof(minus_one));
+    if (is_mod) {
+        const unsigned char zero[] = { 0x31, 0xC0, 0xEB, 0x05 };    // xor eax, eax; jmp past idiv/mov
+        emit_bytes(buf, zero, sizeof(zero));
+    } else {
+        const unsigned char neg[] = { 0xF7, 0xD8, 0xEB, 0x03 };     // neg eax; jmp past idiv
+        emit_bytes(buf, neg, sizeof(neg));
+    }
+    const unsigned char idiv[] = { 0x99, 0xF7, 0xF9 };              // cdq; idiv ecx
+    emit_bytes(buf, idiv, sizeof(idiv));
+    if (is_mod) {
+        emit_byte(buf, 0x89);                                       // mov eax, edx
+        emit_byte(buf, 0xD0);
+    }
+}
+
+static int count_div_ops(IRList *list) {
+    int n = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (list->insts[i].op == IR_DIV || list->insts[i].op == IR_MOD) n++;
+    }
+    return n;
+}
+
+static int *count_uses(IRList *list) {
+    int *uses = calloc(list->temp_count + 1, sizeof(int));
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int srcs = ir_num_srcs(inst->op);
+        if (srcs > 0 && inst->src1 >= 0) uses[inst->src1]++;
+        if (srcs > 1 && inst->src2 >= 0) uses[inst->src2]++;
+    }
+    return uses;
+}
+
+static unsigned char setcc_for(int op) {
+    switch (op) {
+        case IR_EQ: return 0x94;
+        case IR_NEQ: return 0x95;
+        case IR_LT: return 0x9C;
+        case IR_GT: return 0x9F;
+        case IR_LE: return 0x9E;
+        default: return 0x9D;   // IR_GE
+    }
+}
+
+static void add_fixup(Fixup **fixups, int *count, int *capacity, size_t at, int label) {
+    if (*count == *capacity) {
+        *capacity *= 2;
+        *fixups = realloc(*fixups, *capacity * sizeof(Fixup));
+    }
+    (*fixups)[*count].at = at;
+    (*fixups)[*count].label = label;
+    (*count)++;
+}
+
+// Copies code into fresh pages and flips them from writable to executable.
+static int map_code(JitProgram *prog, const void *code, size_t code_size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (code_size + page - 1) & ~(page - 1);
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    int ok = mem != MAP_FAILED;
+    if (ok) {
+        memcpy(mem, code, code_size);
+        if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(mem, size);
+            ok = 0;
+        }
+    }
+    if (!ok) perror("JIT: mapping code pages");
+
+    prog->code = ok ? mem : NULL;
+    prog->size = ok ? size : 0;
+    prog->entry = ok ? (JitFunc)mem : NULL;
+    return ok;
+}
+
+int jit_compile(JitProgram *prog, IRList *list) {
+    CodeBuf buf = { NULL, 0, 0 };
+    long *label_offsets = malloc((list->label_count + 1) * sizeof(long));
+    for (int i = 0; i < list->label_count; i++) label_offsets[i] = -1;
+
+    int num_fixups = 0, fixup_capacity = 64;
+    Fixup *fixups = malloc(fixup_capacity * sizeof(Fixup));
+    int num_div_zero = 0;
+    size_t *div_zero_fixups = malloc((count_div_ops(list) + 1) * sizeof(size_t));
+    int *uses = count_uses(list);
+
+    RegAlloc ra;
+    regalloc_run(&ra, list, JIT_NUM_REGS);
+    prog->num_spilled = ra.num_spilled;
+    prog->num_spill_slots = ra.num_spill_slots;
+
+    copy_var_names(prog, list);
+
+    // Prologue: push rbp; mov rbp, rsp; push rbx, r12-r15; sub rsp, frame;
+    // mov dword [rsi], 0. The frame keeps rsp 16-byte aligned.
+    int frame = ((4 * ra.num_spill_slots + 15) & ~15) + 8;
+    const unsigned char prologue[] = {
+        0x55, 0x48, 0x89, 0xE5,
+        0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57,
+        0x48, 0x81, 0xEC
+    };
+    emit_bytes(&buf, prologue, sizeof(prologue));
+    emit_u32(&buf, (unsigned)frame);
+    const unsigned char clear_status[] = { 0xC7, 0x06, 0x00, 0x00, 0x00, 0x00 };
+    emit_bytes(&buf, clear_status, sizeof(clear_status));
+
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        switch (inst->op) {
+            case IR_LOAD_CONST:
+                emit_move_imm(&buf, temp_operand(&ra, inst->dest), inst->value);
+                break;
+
+            case IR_LOAD_VAR:
+                emit_move(&buf, temp_operand(&ra, inst->dest), var_operand(inst->var));
+                break;
+
+            case IR_STORE_VAR:
+                emit_move(&buf, var_operand(inst->var), temp_operand(&ra, inst->src1));
+                break;
+
+            case IR_ADD: case IR_SUB: case IR_MUL: {
+                Operand dst = temp_operand(&ra, inst->dest);
+                Operand a = temp_operand(&ra, inst->src1);
+                Operand b = temp_operand(&ra, inst->src2);
+                static const unsigned char add[] = { 0x03 }, sub[] = { 0x2B }, imul[] = { 0x0F, 0xAF };
+                const unsigned char *opcode = inst->op == IR_ADD ? add : inst->op == IR_SUB ? sub : imul;
+                int len = inst->op == IR_MUL ? 2 : 1;
+                if (inst->op != IR_SUB && !dst.is_mem && same_operand(dst, b)) {
+                    Operand t = a;      // commutative: dst op= a
+                    a = b;
+                    b = t;
+                }
+                // Compute in place when dst is a register not read by the
+                // second operand, otherwise go through eax.
+                int work = (!dst.is_mem && !same_operand(dst, b)) ? dst.reg : EAX;
+                emit_load(&buf, work, a);
+                emit_op(&buf, opcode, len, work, b);
+                emit_store(&buf, dst, work);
+                break;
+            }
+
+            case IR_DIV: case IR_MOD:
+                emit_load(&buf, EAX, temp_operand(&ra, inst->src1));
+                emit_load(&buf, ECX, temp_operand(&ra, inst->src2));
+                emit_divide(&buf, inst->op == IR_MOD, div_zero_fixups, &num_div_zero);
+                emit_store(&buf, temp_operand(&ra, inst->dest), EAX);
+                break;
+
+            case IR_EQ: case IR_NEQ: case IR_LT: case IR_GT: case IR_LE: case IR_GE: {
+                Operand a = temp_operand(&ra, inst->src1);
+                if (a.is_mem) {
+                    emit_load(&buf, EAX, a);
+                    a = reg_operand(EAX);
+                }
+                emit_op1(&buf, 0x3B, a.reg, temp_operand(&ra, inst->src2));   // cmp a, b
+                unsigned char setcc = setcc_for(inst->op);
+
+                // A compare feeding only the next branch jumps on the flags
+                // directly instead of materializing 0/1.
+                IRInst *next = i + 1 < list->count ? &list->insts[i + 1] : NULL;
+                if (next && next->op == IR_JUMP_IF_FALSE && next->src1 == inst->dest && uses[inst->dest] == 1) {
+                    emit_byte(&buf, 0x0F);
+                    emit_byte(&buf, (unsigned char)((setcc ^ 1) - 0x10));   // jcc on the false condition
+                    add_fixup(&fixups, &num_fixups, &fixup_capacity, buf.size, next->label);
+                    emit_u32(&buf, 0);
+                    i++;
+                    break;
+                }
+                const unsigned char seq[] = { 0x0F, setcc, 0xC0, 0x0F, 0xB6, 0xC0 };   // setcc al; movzx eax, al
+                emit_bytes(&buf, seq, sizeof(seq));
+                emit_store(&buf, temp_operand(&ra, inst->dest), EAX);
+                break;
+            }
+
+            case IR_AND:
+            case IR_OR:
+                emit_load(&buf, EAX, temp_operand(&ra, inst->src1));
+                emit_load(&buf, ECX, temp_operand(&ra, inst->src2));
+                if (inst->op == IR_AND) {
+                    // test eax, eax; setne al; test ecx, ecx; setne cl; and al, cl; movzx eax, al
+                    const unsigned char seq[] = { 0x85, 0xC0, 0x0F, 0x95, 0xC0, 0x85, 0xC9, 0x0F, 0x95, 0xC1,
+                                                  0x20, 0xC8, 0x0F, 0xB6, 0xC0 };
+                    emit_bytes(&buf, seq, sizeof(seq));
+                } else {
+                    // or eax, ecx; setne al; movzx eax, al
+                    const unsigned char seq[] = { 0x09, 0xC8, 0x0F, 0x95, 0xC0, 0x0F, 0xB6, 0xC0 };
+                    emit_bytes(&buf, seq, sizeof(seq));
+                }
+                emit_store(&buf, temp_operand(&ra, inst->dest), EAX);
+                break;
+
+            case IR_NEG:
+            case IR_BIT_NOT: {
+                Operand dst = temp_operand(&ra, inst->dest);
+                emit_move(&buf, dst, temp_operand(&ra, inst->src1));
+                emit_op1(&buf, 0xF7, inst->op == IR_NEG ? 3 : 2, dst);   // neg/not dst
+                break;
+            }
+
+            case IR_LOG_NOT: {
+                emit_test_zero(&buf, temp_operand(&ra, inst->src1));
+                const unsigned char seq[] = { 0x0F, 0x94, 0xC0, 0x0F, 0xB6, 0xC0 };   // sete al; movzx eax, al
+                emit_bytes(&buf, seq, sizeof(seq));
+                emit_store(&buf, temp_operand(&ra, inst->dest), EAX);
+                break;
+            }
+
+            case IR_COPY:
+                emit_move(&buf, temp_operand(&ra, inst->dest), temp_operand(&ra, inst->src1));
+                break;
+
+            case IR_NOP:
+                break;
+
+            case IR_LABEL:
+                label_offsets[inst->label] = (long)buf.size;
+                break;
+
+            case IR_JUMP:
+            case IR_JUMP_IF_FALSE:
+                if (inst->op == IR_JUMP) {
+                    emit_byte(&buf, 0xE9);                              // jmp rel32
+                } else {
+                    emit_test_zero(&buf, temp_operand(&ra, inst->src1));
+                    emit_byte(&buf, 0x0F);                              // je rel32
+                    emit_byte(&buf, 0x84);
+                }
+                add_fixup(&fixups, &num_fixups, &fixup_capacity, buf.size, inst->label);
+                emit_u32(&buf, 0);
+                break;
+
+            case IR_RETURN:
+                emit_load(&buf, EAX, temp_operand(&ra, inst->src1));
+                emit_epilogue(&buf);
+                break;
+
+            default:
+                fprintf(stderr, "JIT: unsupported IR op %d\n", inst->op);
+                exit(1);
+        }
+    }
+
+    // Falling off the end returns 0.
+    emit_byte(&buf, 0x31);                                              // xor eax, eax
+    emit_byte(&buf, 0xC0);
+    emit_epilogue(&buf);
+
+    if (num_div_zero > 0) {
+        size_t stub = buf.size;
+        emit_div_zero_exit(&buf);
+        for (int i = 0; i < num_div_zero; i++) patch_rel32(&buf, div_zero_fixups[i], stub);
+    }
+
+    for (int i = 0; i < num_fixups; i++) {
+        long target = label_offsets[fixups[i].label];
+        if (target < 0) {
+            fprintf(stderr, "JIT: jump to undefined label %s\n", ir_label_name(list, fixups[i].label));
+            exit(1);
+        }
+        patch_rel32(&buf, fixups[i].at, (size_t)target);
+    }
+
+    int ok = map_code(prog, buf.bytes, buf.size);
+
+    regalloc_free(&ra);
+    free(uses);
+    free(buf.bytes);
+    free(fixups);
+    free(div_zero_fixups);
+    free(label_offsets);
+    return ok ? 0 : -1;
+}
+
+// Generated code only uses relative branches, so the bytes of an earlier
+// jit_compile of the same list run from any address.
+int jit_load(JitProgram *prog, IRList *list, const void *code, size_t size) {
+    prog->num_spilled = prog->num_spill_slots = 0;
+    copy_var_names(prog, list);
+    return map_code(prog, code, size) ? 0 : -1;
+}
+
+void jit_free(JitProgram *prog) {
+    if (prog->code) munmap(prog->code, prog->size);
+    for (int i = 0; i < prog->num_vars; i++) free(prog->var_names[i]);
+    free(prog->var_names);
+    prog->code = NULL;
+    prog->entry = NULL;
+    prog->var_names = NULL;
+    prog->size = 0;
+    prog->num_vars = 0;
+}
+
+#else
+
+int jit_compile(JitProgram *prog, IRList *list) {
+    (void)list;
+    prog->code = NULL;
+    prog->size = 0;
+    prog->entry = NULL;
+    prog->num_spilled = prog->num_spill_slots = 0;
+    copy_var_names(prog, list);
+    fprintf(stderr, "JIT: native code generation requires x86-64\n");
+    return -1;
+}
+
+int jit_load(JitProgram *prog, IRList *list, const void *code, size_t size) {
+    (void)code;
+    (void)size;
+    return jit_compile(prog, list);
+}
+
+void jit_free(JitProgram *prog) {
+    (void)prog;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+#include "ir.h"
+
+// Native entry point: vars holds one int per variable slot, status is set
+// to a nonzero JitStatus when the program traps.
+typedef int (*JitFunc)(int *vars, int *status);
+
+// Machine registers available to the allocator for temps.
+#define JIT_NUM_REGS 9
+
+typedef enum {
+    JIT_OK,
+    JIT_ERR_DIV_ZERO
+} JitStatus;
+
+typedef struct {
+    void *code;
+    size_t size;
+    JitFunc entry;
+    int num_vars;
+    char **var_names;
+    int num_spilled;        // temps that did not get a register
+    int num_spill_slots;
+} JitProgram;
+
+int jit_available(void);
+int jit_compile(JitProgram *prog, IRList *list);
+// Maps size bytes of code an earlier jit_compile of list produced.
+int jit_load(JitProgram *prog, IRList *list, const void *code, size_t size);
+int jit_var_slot(JitProgram *prog, const char *name);
+void jit_free(JitProgram *prog);
+
+#endif
@@ -1,58 +1,205 @@
 
 #include <stdio.h>
-#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include "lexer.h"
 
-static FILE *input;
+#if !defined(_WIN32)
+#define LEXER_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define LEXER_MMAP 0
+#endif
 
-void lexer_init(FILE *source) {
-    input = source;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum { CHAR_SPACE = 1, CHAR_DIGIT = 2, CHAR_IDENT = 4 };
+
+static const unsigned char char_class[256] = {
+    [' '] = CHAR_SPACE,
+    ['\t' ... '\r'] = CHAR_SPACE,
+    ['0' ... '9'] = CHAR_DIGIT | CHAR_IDENT,
+    ['a' ... 'z'] = CHAR_IDENT,
+    ['A' ... 'Z'] = CHAR_IDENT,
+    ['_'] = CHAR_IDENT,
+};
+
+static char *read_all(FILE *source, size_t *size) {
+    size_t capacity = 1 << 16, len = 0;
+    char *buf = malloc(capacity);
+    size_t n;
+    while ((n = fread(buf + len, 1, capacity - len, source)) > 0) {
+        len += n;
+        if (len == capacity) {
+            capacity *= 2;
+            buf = realloc(buf, capacity);
+        }
+    }
+    *size = len;
+    return buf;
+}
+
+void lexer_init_buffer(Lexer *lex, const char *src, size_t size, InternPool *atoms) {
+    lex->start = lex->cur = src;
+    lex->end = src + size;
+    lex->owned_buffer = NULL;
+    lex->mapped_size = 0;
+    lex->atoms = atoms;
+}
+
+void lexer_init(Lexer *lex, FILE *source, InternPool *atoms) {
+#if LEXER_MMAP
+    // Regular files are mapped read-only; pipes and empty files fall back
+    // to reading the stream.
+    struct stat st;
+    int fd = fileno(source);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && ftell(source) == 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+            lexer_init_buffer(lex, map, (size_t)st.st_size, atoms);
+            lex->mapped_size = (size_t)st.st_size;
+            return;
+        }
+    }
+#endif
+    size_t size;
+    char *buf = read_all(source, &size);
+    lexer_init_buffer(lex, buf, size, atoms);
+    lex->owned_buffer = buf;
+}
+
+void lexer_free(Lexer *lex) {
+#if LEXER_MMAP
+    if (lex->mapped_size) munmap((void *)lex->start, lex->mapped_size);
+#endif
+    free(lex->owned_buffer);
+    lex->owned_buffer = NULL;
+    lex->mapped_size = 0;
+    lex->start = lex->cur = lex->end = NULL;
 }
 
-static void skip_whitespace() {
-    int c;
-    while ((c = fgetc(input)) != EOF && isspace(c)) {}
-    if (c != EOF) ungetc(c, input);
+#if defined(__SSE2__)
+// Bit i is set when byte i of the 16-byte block is whitespace.
+static unsigned space_mask(__m128i v) {
+    __m128i sp = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    // \t \n \v \f \r are the contiguous range 9..13.
+    __m128i ctl = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(sp, ctl));
 }
 
-Token lexer_next_token() {
-    skip_whitespace();
-    Token tok = {TOKEN_UNKNOWN, 0, NULL};
-    int c = fgetc(input);
-    if (c == EOF) {
+// Bit i is set when byte i is [A-Za-z0-9_]. Bytes >= 0x80 compare as
+// negative and never match.
+static unsigned ident_mask(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return (unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+}
+#endif
+
+// Advances p past every byte of class cls before end, 16 bytes at a time
+// where SSE2 is available.
+static const char *skip_class(const char *p, const char *end, int cls) {
+#if defined(__SSE2__)
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        unsigned stop = ~(cls == CHAR_SPACE ? space_mask(v) : ident_mask(v)) & 0xFFFF;
+        if (stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+#endif
+    while (p < end && (char_class[(unsigned char)*p] & cls)) p++;
+    return p;
+}
+
+static void skip_whitespace(Lexer *lex) {
+    // Single separators are the common case; only runs go wide.
+    const char *cur = lex->cur, *end = lex->end;
+    if (cur < end && (char_class[(unsigned char)*cur] & CHAR_SPACE)) {
+        cur++;
+        if (cur < end && (char_class[(unsigned char)*cur] & CHAR_SPACE)) cur = skip_class(cur, end, CHAR_SPACE);
+        lex->cur = cur;
+    }
+}
+
+// Perfect hash over the keyword set: (6 * first + 4 * last + length) & 7
+// is distinct for every keyword, so one memcmp decides.
+typedef struct {
+    const char *text;
+    int len;
+    TokenType type;
+} Keyword;
+
+static const Keyword keywords[8] = {
+    { "if", 2, TOKEN_IF },
+    { "int", 3, TOKEN_INT },
+    { "return", 6, TOKEN_RETURN },
+    { "while", 5, TOKEN_WHILE },
+    { NULL, 0, TOKEN_IDENTIFIER },
+    { "print", 5, TOKEN_PRINT },
+    { "else", 4, TOKEN_ELSE },
+    { "for", 3, TOKEN_FOR },
+};
+
+static TokenType keyword_type(const char *s, int len) {
+    unsigned h = (6u * (unsigned char)s[0] + 4u * (unsigned char)s[len - 1] + (unsigned)len) & 7;
+    const Keyword *k = &keywords[h];
+    if (k->len == len && memcmp(k->text, s, len) == 0) return k->type;
+    return TOKEN_IDENTIFIER;
+}
+
+static int peek_is(Lexer *lex, char c) {
+    if (lex->cur < lex->end && *lex->cur == c) {
+        lex->cur++;
+        return 1;
+    }
+    return 0;
+}
+
+Token lexer_next_token(Lexer *lex) {
+    skip_whitespace(lex);
+    Token tok = {TOKEN_UNKNOWN, 0, -1};
+    const char *cur = lex->cur, *end = lex->end;
+    if (cur >= end) {
         tok.type = TOKEN_EOF;
         return tok;
     }
 
-    if (isdigit(c)) {
-        int val = c - '0';
-        while (isdigit(c = fgetc(input))) val = val * 10 + (c - '0');
-        if (c != EOF) ungetc(c, input);
+    unsigned char c = (unsigned char)*cur;
+    int cls = char_class[c];
+
+    if (cls & CHAR_DIGIT) {
+        // Accumulate unsigned so oversized literals wrap like int arithmetic.
+        unsigned val = 0;
+        while (cur < end && (char_class[(unsigned char)*cur] & CHAR_DIGIT)) {
+            val = val * 10 + (unsigned)(*cur++ - '0');
+        }
+        lex->cur = cur;
         tok.type = TOKEN_NUMBER;
-        tok.value = val;
+        tok.value = (int)val;
         return tok;
     }
 
-    if (isalpha(c) || c == '_') {
-        char buf[256]; int len = 0;
-        buf[len++] = c;
-        while (isalnum(c = fgetc(input)) || c == '_') buf[len++] = c;
-        if (c != EOF) ungetc(c, input);
-        buf[len] = '\0';
-        if (strcmp(buf, "int") == 0) tok.type = TOKEN_INT;
-        else if (strcmp(buf, "if") == 0) tok.type = TOKEN_IF;
-        else if (strcmp(buf, "else") == 0) tok.type = TOKEN_ELSE;
-        else if (strcmp(buf, "while") == 0) tok.type = TOKEN_WHILE;
-        else if (strcmp(buf, "for") == 0) tok.type = TOKEN_FOR;
-        else if (strcmp(buf, "print") == 0) tok.type = TOKEN_PRINT;
-        else if (strcmp(buf, "return") == 0) tok.type = TOKEN_RETURN;
-        else { tok.type = TOKEN_IDENTIFIER; tok.text = strdup(buf); }
+    if (cls & CHAR_IDENT) {
+        const char *start = cur;
+        cur = skip_class(cur + 1, end, CHAR_IDENT);
+        lex->cur = cur;
+        int len = (int)(cur - start);
+        tok.type = keyword_type(start, len);
+        if (tok.type == TOKEN_IDENTIFIER) tok.atom = intern(lex->atoms, start, len);
         return tok;
     }
 
-    int next;
+    lex->cur = cur + 1;
     switch (c) {
         case '+': tok.type = TOKEN_PLUS; break;
         case '-': tok.type = TOKEN_MINUS; break;
@@ -60,53 +207,21 @@ Token lexer_next_token() {
         case '/': tok.type = TOKEN_SLASH; break;
         case '~': tok.type = TOKEN_BIT_NOT; break;
         case '%': tok.type = TOKEN_PERCENT; break;
-        case '=': next = fgetc(input);
-                  tok.type = (next == '=') ? TOKEN_EQ : TOKEN_ASSIGN;
-                  if (next != '=') {
-                      ungetc(next, input);
-                  }
-                  break;
-        case '!':
-            next = fgetc(input);
-            if (next == '=') {
-                tok.type = TOKEN_NEQ;
-            } else {
-                ungetc(next, input);
-                tok.type = TOKEN_LOG_NOT;
-            }
-            break;
-        case '<': next = fgetc(input);
-                  tok.type = (next == '=') ? TOKEN_LE : TOKEN_LT;
-                  if (next != '=') {
-                      ungetc(next, input);
-                  }
-                  break;
-        case '>': next = fgetc(input);
-                  tok.type = (next == '=') ? TOKEN_GE : TOKEN_GT;
-                  if (next != '=') {
-                      ungetc(next, input);
-                  }
-                  break;
+        case '=': tok.type = peek_is(lex, '=') ? TOKEN_EQ : TOKEN_ASSIGN; break;
+        case '!': tok.type = peek_is(lex, '=') ? TOKEN_NEQ : TOKEN_LOG_NOT; break;
+        case '<': tok.type = peek_is(lex, '=') ? TOKEN_LE : TOKEN_LT; break;
+        case '>': tok.type = peek_is(lex, '=') ? TOKEN_GE : TOKEN_GT; break;
         case '(': tok.type = TOKEN_LPAREN; break;
         case ')': tok.type = TOKEN_RPAREN; break;
         case '{': tok.type = TOKEN_LBRACE; break;
         case '}': tok.type = TOKEN_RBRACE; break;
         case ';': tok.type = TOKEN_SEMICOLON; break;
-        case '&':
-            next = fgetc(input);
-            tok.type = (next == '&') ? TOKEN_AND : TOKEN_UNKNOWN;
-            if (next != '&') ungetc(next, input);
-            break;
-
-        case '|':
-            next = fgetc(input);
-            tok.type = (next == '|') ? TOKEN_OR : TOKEN_UNKNOWN;
-            if (next != '|') ungetc(next, input);
-            break;
+        case '&': tok.type = peek_is(lex, '&') ? TOKEN_AND : TOKEN_UNKNOWN; break;
+        case '|': tok.type = peek_is(lex, '|') ? TOKEN_OR : TOKEN_UNKNOWN; break;
 
         default:
-    fprintf(stderr, "Unknown character: '%c' (%d)\n", c, c);
     tok.type = TOKEN_UNKNOWN;
+    tok.value = c;
     break;
     }
 
@@ -1,7 +1,9 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stddef.h>
 #include <stdio.h>
+#include "intern.h"
 
 typedef enum {
     TOKEN_EOF,
@@ -43,10 +45,28 @@ typedef enum {
 typedef struct {
     TokenType type;
     int value;
-    char *text;
+    Atom atom;          // TOKEN_IDENTIFIER only
 } Token;
 
-void lexer_init(FILE *source);
-Token lexer_next_token(void);
+// Scanner state of one compilation. The whole source is scanned in
+// memory: cur walks it and end is one past the last byte. Identifiers are
+// interned into atoms.
+typedef struct {
+    const char *start;
+    const char *cur;
+    const char *end;
+    void *owned_buffer;
+    size_t mapped_size;
+    InternPool *atoms;
+} Lexer;
+
+// Scans the whole source from memory: regular files are mmap'd, other
+// streams are read into a buffer first.
+void lexer_init(Lexer *lex, FILE *source, InternPool *atoms);
+// Scans size bytes at src, which must stay valid until lexer_free.
+void lexer_init_buffer(Lexer *lex, const char *src, size_t size, InternPool *atoms);
+// TOKEN_UNKNOWN carries the offending byte in value.
+Token lexer_next_token(Lexer *lex);
+void lexer_free(Lexer *lex);
 
 #endif
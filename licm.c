@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <string.h>
+#include "licm.h"
+#include "cfg.h"
+
+#define DEF_NONE -1
+#define DEF_MULTI -2
+
+typedef struct {
+    IRList *list;
+    CFG *cfg;
+    int *def_inst;          // temp -> defining instruction, DEF_NONE or DEF_MULTI
+    int *target;            // instruction -> outermost loop it leaves, -1 if none
+    int *block_stamp;       // block -> loop stamp, marks the current loop body
+    int *var_stamp;         // var -> loop stamp, marks variables stored in it
+    int *inv_stamp;         // instruction -> loop stamp, marks invariants
+    int stamp;
+    IRInsertion *insertions;
+    int num_insertions;
+    int insertion_capacity;
+} LicmState;
+
+static void add_insertion(LicmState *s, int pos, IRInst inst) {
+    if (s->num_insertions == s->insertion_capacity) {
+        s->insertion_capacity = s->insertion_capacity ? s->insertion_capacity * 2 : 64;
+        s->insertions = realloc(s->insertions, s->insertion_capacity * sizeof(IRInsertion));
+    }
+    s->insertions[s->num_insertions].pos = pos;
+    s->insertions[s->num_insertions].inst = inst;
+    s->num_insertions++;
+}
+
+static int in_loop(LicmState *s, int inst) {
+    return s->block_stamp[s->cfg->inst_block[inst]] == s->stamp;
+}
+
+static int operand_invariant(LicmState *s, int temp) {
+    if (temp < 0) return 1;
+    int def = s->def_inst[temp];
+    if (def == DEF_NONE) return 1;
+    if (def == DEF_MULTI) return 0;
+    return !in_loop(s, def) || s->inv_stamp[def] == s->stamp;
+}
+
+static int nonzero_const(LicmState *s, int temp) {
+    int def = s->def_inst[temp];
+    return def >= 0 && s->list->insts[def].op == IR_LOAD_CONST && s->list->insts[def].value != 0;
+}
+
+static int is_invariant(LicmState *s, int i) {
+    IRInst *inst = &s->list->insts[i];
+    if (!ir_has_dest(inst->op) || inst->dest < 0 || s->def_inst[inst->dest] != i) return 0;
+    switch (inst->op) {
+        case IR_LOAD_CONST:
+            return 1;
+        case IR_LOAD_VAR:
+            return s->var_stamp[inst->var] != s->stamp;
+        case IR_DIV:
+        case IR_MOD:
+            // Hoisting runs the instruction even when the loop body would
+            // not, so only divisions that cannot trap may move.
+            if (!nonzero_const(s, inst->src2)) return 0;
+            break;
+        case IR_PHI:
+            return 0;
+        default:
+            break;
+    }
+    int srcs = ir_num_srcs(inst->op);
+    return (srcs < 1 || operand_invariant(s, inst->src1)) && (srcs < 2 || operand_invariant(s, inst->src2));
+}
+
+// Marks what is invariant in loop l as leaving it. Loops are visited from
+// the inside out, so each instruction ends up marked with the outermost
+// loop it is invariant in.
+static void mark_loop(LicmState *s, int l) {
+    IRList *list = s->list;
+    CFG *cfg = s->cfg;
+    Loop *loop = &cfg->loops[l];
+    if (list->insts[cfg->blocks[loop->header].start].op != IR_LABEL) return;
+
+    s->stamp++;
+    for (int k = 0; k < loop->num_blocks; k++) {
+        BasicBlock *bb = &cfg->blocks[loop->blocks[k]];
+        s->block_stamp[loop->blocks[k]] = s->stamp;
+        for (int i = bb->start; i < bb->end; i++) {
+            if (list->insts[i].op == IR_STORE_VAR) s->var_stamp[list->insts[i].var] = s->stamp;
+        }
+    }
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int k = 0; k < loop->num_blocks; k++) {
+            BasicBlock *bb = &cfg->blocks[loop->blocks[k]];
+            for (int i = bb->start; i < bb->end; i++) {
+                if (s->inv_stamp[i] == s->stamp || !is_invariant(s, i)) continue;
+                s->inv_stamp[i] = s->stamp;
+                changed = 1;
+            }
+        }
+    }
+
+    // Constants are only worth a register across the loop when something
+    // hoisted reads them; the rest stay next to their uses.
+    for (int k = 0; k < loop->num_blocks; k++) {
+        BasicBlock *bb = &cfg->blocks[loop->blocks[k]];
+        for (int i = bb->start; i < bb->end; i++) {
+            if (s->inv_stamp[i] == s->stamp && list->insts[i].op != IR_LOAD_CONST) s->target[i] = l;
+        }
+    }
+}
+
+// A constant read by hoisted code leaves the outermost loop its readers
+// leave that it is also inside.
+static void mark_constants(LicmState *s) {
+    IRList *list = s->list;
+    CFG *cfg = s->cfg;
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int l = s->target[i];
+        if (l < 0 || inst->op == IR_LOAD_CONST) continue;
+        int srcs = ir_num_srcs(inst->op);
+        int ops[2] = { inst->src1, inst->src2 };
+        for (int k = 0; k < srcs; k++) {
+            int def = ops[k] >= 0 ? s->def_inst[ops[k]] : DEF_NONE;
+            if (def < 0 || list->insts[def].op != IR_LOAD_CONST || !cfg_loop_contains(cfg, l, cfg->inst_block[def])) continue;
+            if (s->target[def] < 0 || cfg->loops[l].depth < cfg->loops[s->target[def]].depth) s->target[def] = l;
+        }
+    }
+}
+
+// Entries that jump to the header are redirected to a new preheader
+// label; fall-through entry reaches the hoisted code directly.
+static void add_preheader(LicmState *s, int l) {
+    IRList *list = s->list;
+    CFG *cfg = s->cfg;
+    Loop *loop = &cfg->loops[l];
+    BasicBlock *header = &cfg->blocks[loop->header];
+    int header_label = list->insts[header->start].label;
+    int pre = -1;
+    for (int p = 0; p < header->num_preds; p++) {
+        int pred = header->preds[p];
+        if (cfg_loop_contains(cfg, l, pred)) continue;
+        IRInst *term = &list->insts[cfg->blocks[pred].end - 1];
+        if ((term->op == IR_JUMP || term->op == IR_JUMP_IF_FALSE) && term->label == header_label) {
+            if (pre < 0) pre = ir_new_label(list, "preheader");
+            term->label = pre;
+        }
+    }
+    if (pre >= 0) {
+        IRInst label = { IR_LABEL, -1, -1, { .label = pre } };
+        add_insertion(s, header->start, label);
+    }
+}
+
+int ir_hoist_loop_invariants(IRList *list) {
+    CFG cfg;
+    cfg_build(&cfg, list);
+    if (cfg.num_loops == 0) {
+        cfg_free(&cfg);
+        return 0;
+    }
+
+    LicmState s;
+    memset(&s, 0, sizeof(s));
+    s.list = list;
+    s.cfg = &cfg;
+    s.def_inst = malloc((list->temp_count + 1) * sizeof(int));
+    s.target = malloc((list->count + 1) * sizeof(int));
+    s.block_stamp = calloc(cfg.num_blocks + 1, sizeof(int));
+    s.var_stamp = calloc(list->var_count + 1, sizeof(int));
+    s.inv_stamp = calloc(list->count + 1, sizeof(int));
+    for (int t = 0; t < list->temp_count; t++) s.def_inst[t] = DEF_NONE;
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        s.target[i] = -1;
+        if (!ir_has_dest(inst->op) || inst->dest < 0) continue;
+        s.def_inst[inst->dest] = s.def_inst[inst->dest] == DEF_NONE ? i : DEF_MULTI;
+    }
+
+    // Outer loops come first in cfg.loops, so walking backwards visits
+    // every inner loop before its parent.
+    for (int l = cfg.num_loops - 1; l >= 0; l--) mark_loop(&s, l);
+    mark_constants(&s);
+
+    int *leaving = calloc(cfg.num_loops, sizeof(int));
+    for (int i = 0; i < list->count; i++) {
+        if (s.target[i] >= 0) leaving[s.target[i]]++;
+    }
+    for (int l = 0; l < cfg.num_loops; l++) {
+        if (leaving[l] > 0) add_preheader(&s, l);
+    }
+    // In program order, so hoisted values are defined before hoisted
+    // code in the same preheader reads them.
+    int hoisted = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (s.target[i] < 0) continue;
+        add_insertion(&s, cfg.blocks[cfg.loops[s.target[i]].header].start, list->insts[i]);
+        list->insts[i].op = IR_NOP;
+        hoisted++;
+    }
+
+    ir_insert(list, s.insertions, s.num_insertions);
+    ir_remove_nops(list);
+    free(leaving);
+    free(s.def_inst);
+    free(s.target);
+    free(s.block_stamp);
+    free(s.var_stamp);
+    free(s.inv_stamp);
+    free(s.insertions);
+    cfg_free(&cfg);
+    return hoisted;
+}
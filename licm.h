@@ -0,0 +1,14 @@
+#ifndef LICM_H
+#define LICM_H
+
+#include "ir.h"
+
+// Loop-invariant code motion over the natural loops of the CFG. An
+// instruction is invariant when it cannot trap, loads a variable the loop
+// never stores, or only reads temps defined outside the loop or by other
+// invariant instructions. Each invariant instruction moves once, to a
+// preheader in front of the header of the outermost loop it is invariant
+// in. Returns the number of instructions hoisted.
+int ir_hoist_loop_invariants(IRList *list);
+
+#endif
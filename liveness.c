@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include "liveness.h"
+
+#define WORD_BITS (8 * (int)sizeof(unsigned long))
+
+static void set_bit(unsigned long *set, int bit) {
+    set[bit / WORD_BITS] |= 1UL << (bit % WORD_BITS);
+}
+
+static int test_bit(const unsigned long *set, int bit) {
+    return (set[bit / WORD_BITS] >> (bit % WORD_BITS)) & 1;
+}
+
+// A temp is global when it is used outside the block that defines it, or
+// defined in more than one block.
+static void find_globals(Liveness *lv, IRList *list, CFG *cfg) {
+    int n = list->temp_count;
+    int *def_block = malloc((n + 1) * sizeof(int));
+    lv->global_index = malloc((n + 1) * sizeof(int));
+    for (int t = 0; t < n; t++) {
+        def_block[t] = -1;
+        lv->global_index[t] = -1;
+    }
+
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (!ir_has_dest(inst->op) || inst->dest < 0) continue;
+        int b = cfg->inst_block[i];
+        if (def_block[inst->dest] >= 0 && def_block[inst->dest] != b) lv->global_index[inst->dest] = 0;
+        def_block[inst->dest] = b;
+    }
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int b = cfg->inst_block[i];
+        int srcs = ir_num_srcs(inst->op);
+        int ops[2] = { inst->src1, inst->src2 };
+        for (int k = 0; k < srcs; k++) {
+            if (ops[k] >= 0 && def_block[ops[k]] != b) lv->global_index[ops[k]] = 0;
+        }
+        if (inst->op == IR_PHI) {
+            for (int k = 0; k < inst->src2; k++) {
+                int t = list->phi_args[inst->src1 + k].temp;
+                if (t >= 0) lv->global_index[t] = 0;
+            }
+        }
+    }
+
+    lv->num_globals = 0;
+    for (int t = 0; t < n; t++) {
+        if (lv->global_index[t] == 0) lv->global_index[t] = lv->num_globals++;
+        else lv->global_index[t] = -1;
+    }
+    lv->global_temp = malloc((lv->num_globals + 1) * sizeof(int));
+    for (int t = 0; t < n; t++) {
+        if (lv->global_index[t] >= 0) lv->global_temp[lv->global_index[t]] = t;
+    }
+    free(def_block);
+}
+
+void liveness_build(Liveness *lv, IRList *list, CFG *cfg) {
+    find_globals(lv, list, cfg);
+    int nb = cfg->num_blocks;
+    int words = (lv->num_globals + WORD_BITS - 1) / WORD_BITS;
+    if (words == 0) words = 1;
+    lv->words = words;
+    lv->live_in = calloc((size_t)nb * words + 1, sizeof(unsigned long));
+    lv->live_out = calloc((size_t)nb * words + 1, sizeof(unsigned long));
+    unsigned long *use = calloc((size_t)nb * words + 1, sizeof(unsigned long));
+    unsigned long *def = calloc((size_t)nb * words + 1, sizeof(unsigned long));
+    unsigned long *phi_use = calloc((size_t)nb * words + 1, sizeof(unsigned long));
+
+    // Upward-exposed uses and definitions per block.
+    for (int b = 0; b < nb; b++) {
+        unsigned long *u = use + (size_t)b * words, *d = def + (size_t)b * words;
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            IRInst *inst = &list->insts[i];
+            int srcs = ir_num_srcs(inst->op);
+            int ops[2] = { inst->src1, inst->src2 };
+            for (int k = 0; k < srcs; k++) {
+                int g = ops[k] >= 0 ? lv->global_index[ops[k]] : -1;
+                if (g >= 0 && !test_bit(d, g)) set_bit(u, g);
+            }
+            if (inst->op == IR_PHI) {
+                for (int k = 0; k < inst->src2; k++) {
+                    IRPhiArg *arg = &list->phi_args[inst->src1 + k];
+                    if (arg->temp >= 0) set_bit(phi_use + (size_t)arg->pred * words, lv->global_index[arg->temp]);
+                }
+            }
+            if (ir_has_dest(inst->op) && inst->dest >= 0 && lv->global_index[inst->dest] >= 0) {
+                set_bit(d, lv->global_index[inst->dest]);
+            }
+        }
+    }
+
+    // Backward dataflow, visiting blocks in postorder.
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int r = cfg->num_rpo - 1; r >= 0; r--) {
+            int b = cfg->rpo[r];
+            unsigned long *in = lv->live_in + (size_t)b * words;
+            unsigned long *out = lv->live_out + (size_t)b * words;
+            unsigned long *u = use + (size_t)b * words, *d = def + (size_t)b * words;
+            unsigned long *pu = phi_use + (size_t)b * words;
+            for (int w = 0; w < words; w++) {
+                unsigned long o = pu[w];
+                for (int s = 0; s < cfg->blocks[b].num_succs; s++) {
+                    o |= lv->live_in[(size_t)cfg->blocks[b].succs[s] * words + w];
+                }
+                unsigned long i = u[w] | (o & ~d[w]);
+                if (o != out[w] || i != in[w]) changed = 1;
+                out[w] = o;
+                in[w] = i;
+            }
+        }
+    }
+
+    free(use);
+    free(def);
+    free(phi_use);
+}
+
+int liveness_live_in(Liveness *lv, int block, int temp) {
+    int g = lv->global_index[temp];
+    return g >= 0 && test_bit(lv->live_in + (size_t)block * lv->words, g);
+}
+
+int liveness_live_out(Liveness *lv, int block, int temp) {
+    int g = lv->global_index[temp];
+    return g >= 0 && test_bit(lv->live_out + (size_t)block * lv->words, g);
+}
+
+const unsigned long *liveness_in_set(Liveness *lv, int block) {
+    return lv->live_in + (size_t)block * lv->words;
+}
+
+const unsigned long *liveness_out_set(Liveness *lv, int block) {
+    return lv->live_out + (size_t)block * lv->words;
+}
+
+int liveness_next(Liveness *lv, const unsigned long *set, int g) {
+    int w = g / WORD_BITS;
+    if (w >= lv->words) return -1;
+    unsigned long bits = set[w] & (~0UL << (g % WORD_BITS));
+    while (bits == 0) {
+        if (++w == lv->words) return -1;
+        bits = set[w];
+    }
+    return w * WORD_BITS + __builtin_ctzl(bits);
+}
+
+void liveness_free(Liveness *lv) {
+    free(lv->global_index);
+    free(lv->global_temp);
+    free(lv->live_in);
+    free(lv->live_out);
+    memset(lv, 0, sizeof(*lv));
+}
@@ -0,0 +1,31 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include "ir.h"
+#include "cfg.h"
+
+// Block-level temp liveness. Only temps that cross a block boundary take
+// part in the dataflow; block-local temps never appear in live-in/live-out
+// sets, which keeps the bitsets small on large straight-line programs.
+typedef struct {
+    int num_globals;
+    int *global_index;      // temp -> dense index, -1 for block-local temps
+    int *global_temp;       // dense index -> temp
+    int words;              // bitset words per block
+    unsigned long *live_in;
+    unsigned long *live_out;
+} Liveness;
+
+void liveness_build(Liveness *lv, IRList *list, CFG *cfg);
+int liveness_live_in(Liveness *lv, int block, int temp);
+int liveness_live_out(Liveness *lv, int block, int temp);
+// A block's live-in or live-out bitset, indexed by dense global index.
+const unsigned long *liveness_in_set(Liveness *lv, int block);
+const unsigned long *liveness_out_set(Liveness *lv, int block);
+// The first dense index at or after g that is set, or -1. Walks a set in
+// time proportional to its words and members:
+//   for (g = liveness_next(lv, set, 0); g >= 0; g = liveness_next(lv, set, g + 1))
+int liveness_next(Liveness *lv, const unsigned long *set, int g);
+void liveness_free(Liveness *lv);
+
+#endif
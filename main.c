@@ -1,50 +1,300 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "parser.h"
+#include "lexer.h"
 #include "ir.h"
 #include "optimizer.h" // Include this only if optimizer is available
+#include "vm.h"
+#include "jit.h"
+#include "cfg.h"
+#include "regalloc.h"
+#include "tier.h"
+#include "cache.h"
+#include "irbin.h"
+#include "compile.h"
+#include "batch.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [--run | --jit | --tier | --bench-vm N | --print-cfg | --print-regalloc] [--unroll N] [--unroll-budget N] [--hot-loop N] [--osr-loop N] [--cache DIR] [--cache-limit BYTES] [--emit-ir FILE] [-v] [--stats | --stats-json] <source_file>\n"
+                    "       %s --batch [-j N] [--manifest FILE] [--unroll N] [--unroll-budget N] [--emit-ir DIR] <source_file>...\n", prog, prog);
+}
+
+static int run_program(VMProgram *prog, VMStatus (*run)(VMProgram *, int *, int *), int *result) {
+    int *vars = calloc(prog->num_vars > 0 ? prog->num_vars : 1, sizeof(int));
+    VMStatus status = run(prog, vars, result);
+    free(vars);
+    if (status == VM_ERR_DIV_ZERO) {
+        fprintf(stderr, "Runtime error: division by zero\n");
+        return 0;
+    }
+    return 1;
+}
+
+static void bench_vm(VMProgram *prog, int iterations) {
+    const char *names[] = { "switch", "threaded" };
+    VMStatus (*runners[])(VMProgram *, int *, int *) = { vm_run_switch, vm_run };
+    for (int k = 0; k < 2; k++) {
+        int result = 0;
+        clock_t start = clock();
+        for (int i = 0; i < iterations; i++) {
+            if (!run_program(prog, runners[k], &result)) return;
+        }
+        double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+        printf("%-8s dispatch: %d runs in %.3f s (result %d)\n", names[k], iterations, secs, result);
+    }
+}
+
+// Compiles every input across a thread pool and reports each file and the
+// batch as a whole. Returns the process exit status.
+static int run_batch(const char **paths, int count, int jobs, const OptOptions *options, const char *out_dir) {
+    BatchResult *results = malloc((count > 0 ? count : 1) * sizeof(BatchResult));
+    BatchStats stats;
+    batch_compile(paths, count, jobs, options, out_dir, results, &stats);
+    for (int i = 0; i < count; i++) {
+        BatchResult *r = &results[i];
+        if (r->status != 0) {
+            printf("%s: %s\n", r->path, r->error);
+        } else {
+            printf("%s: %d statements, %d instructions, %.2f ms\n", r->path, r->statements, r->insts, r->seconds * 1000);
+        }
+    }
+    double secs = stats.seconds > 0 ? stats.seconds : 1e-9;
+    printf("[Batch] %d files (%d failed) on %d threads in %.3f s: %.1f files/s, %.2f MB/s, %lld instructions\n",
+           stats.files, stats.failed, stats.threads, stats.seconds, stats.files / secs,
+           stats.bytes / secs / (1024.0 * 1024.0), stats.insts);
+    free(results);
+    return stats.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <source_file>\n", argv[0]);
+    const char *path = NULL;
+    const char **inputs = malloc(argc * sizeof(char *));
+    int num_inputs = 0;
+    int batch = 0;
+    int jobs = batch_default_jobs();
+    const char *manifest = NULL;
+    int run = 0;
+    int jit = 0;
+    int tier = 0;
+    int print_cfg = 0;
+    int print_regalloc = 0;
+    int bench_iterations = 0;
+    const char *cache_dir = NULL;
+    const char *emit_path = NULL;
+    long long cache_limit = CACHE_DEFAULT_LIMIT;
+    int verbose = 0;
+    int stats_format = 0;           // 1 for text, 2 for JSON
+    Stats stats;
+    OptOptions options;
+    opt_options_init(&options);
+    TierOptions tier_options;
+    tier_options_init(&tier_options);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--run") == 0) {
+            run = 1;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            jit = 1;
+        } else if (strcmp(argv[i], "--tier") == 0) {
+            tier = 1;
+        } else if (strcmp(argv[i], "--print-cfg") == 0) {
+            print_cfg = 1;
+        } else if (strcmp(argv[i], "--print-regalloc") == 0) {
+            print_regalloc = 1;
+        } else if (strcmp(argv[i], "--bench-vm") == 0 && i + 1 < argc) {
+            bench_iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--unroll") == 0 && i + 1 < argc) {
+            options.unroll_factor = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--unroll-budget") == 0 && i + 1 < argc) {
+            options.unroll_budget = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hot-loop") == 0 && i + 1 < argc) {
+            tier_options.hot_threshold = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--osr-loop") == 0 && i + 1 < argc) {
+            tier_options.osr_threshold = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--emit-ir") == 0 && i + 1 < argc) {
+            emit_path = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--cache-limit") == 0 && i + 1 < argc) {
+            cache_limit = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+        } else if (strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            batch = 1;
+            manifest = argv[++i];
+        } else if ((strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0) && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--verbose") == 0 || strcmp(argv[i], "-v") == 0) {
+            verbose = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats_format = 1;
+        } else if (strcmp(argv[i], "--stats-json") == 0) {
+            stats_format = 2;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            free(inputs);
+            return EXIT_FAILURE;
+        } else {
+            inputs[num_inputs++] = argv[i];
+        }
+    }
+
+    options.verbose = verbose;
+    if (stats_format) {
+        stats_init(&stats);
+        options.stats = &stats;
+    }
+
+    if (batch) {
+        // Inputs are compiled only; --emit-ir names a directory for the modules.
+        char **listed = NULL;
+        int num_listed = 0;
+        if (manifest && (num_listed = batch_read_manifest(manifest, &listed)) < 0) {
+            perror("Failed to read manifest");
+            free(inputs);
+            return EXIT_FAILURE;
+        }
+        const char **paths = malloc((num_inputs + num_listed + 1) * sizeof(char *));
+        int count = 0;
+        for (int i = 0; i < num_inputs; i++) paths[count++] = inputs[i];
+        for (int i = 0; i < num_listed; i++) paths[count++] = listed[i];
+        int status = run_batch(paths, count, jobs, &options, emit_path);
+        free(paths);
+        batch_free_manifest(listed, num_listed);
+        free(inputs);
+        return status;
+    }
+    if (num_inputs == 1) path = inputs[0];
+    free(inputs);
+    if (!path) {
+        usage(argv[0]);
         return EXIT_FAILURE;
     }
 
-    FILE *source = fopen(argv[1], "r");
+    FILE *source = fopen(path, "r");
     if (!source) {
         perror("Failed to open source file");
         return EXIT_FAILURE;
     }
 
-    parser_init(source);
+    // Precompiled modules (see --emit-ir) are loaded as they are.
+    char magic[4];
+    size_t magic_size = fread(magic, 1, sizeof(magic), source);
+    rewind(source);
+    int module = irbin_is_module(magic, magic_size);
 
-    ASTList *program = parse_program();
-    if (!program) {
-        fprintf(stderr, "Parsing failed\n");
-        fclose(source);
-        return EXIT_FAILURE;
+    IRList ir;
+    Cache cache;
+    int use_cache = !module && cache_dir && cache_open(&cache, cache_dir, cache_limit) == 0;
+    int cached = 0;
+    if (module) {
+        IRBinStatus loaded = irbin_load(&ir, path);
+        if (loaded != IRBIN_OK) {
+            fprintf(stderr, "%s: %s\n", path, irbin_status_string(loaded));
+            fclose(source);
+            return EXIT_FAILURE;
+        }
+        cached = 1;
+    } else if (use_cache) {
+        // A hit skips the whole front end and the optimizer.
+        cache_set_key(&cache, source, &options);
+        cached = cache_load_ir(&cache, &ir);
     }
-
-    int count = 0;
-    for (ASTList *p = program; p; p = p->next) {
-        count++;
+    if (!cached) {
+        CompileResult compiled;
+        if (compile_source(source, &ir, &options, &compiled) != COMPILE_OK) {
+            fprintf(stderr, "%s\n", compiled.error);
+            if (use_cache) cache_close(&cache);
+            fclose(source);
+            return EXIT_FAILURE;
+        }
+        if (use_cache) cache_store_ir(&cache, &ir);
+    }
+    // On stderr, so the program's own output stays as it is. A module or a
+    // cache hit leaves everything at zero.
+    if (stats_format == 1) stats_print(&stats, stderr);
+    else if (stats_format == 2) stats_print_json(&stats, stderr);
+    if (emit_path) {
+        IRBinStatus written = irbin_write(&ir, emit_path);
+        if (written != IRBIN_OK) fprintf(stderr, "%s: %s\n", emit_path, irbin_status_string(written));
     }
-    printf("Parsed %d statements\n", count);
-
-    // Initialize and generate IR
-    IRList ir;
-    ir_list_init(&ir);
-    ir_generate_program(&ir, program);
 
-    // Optional optimization
-    ir_optimize(&ir);  // Comment this line out if you're not using optimizer.c
+    int status = EXIT_SUCCESS;
+    if (jit) {
+        JitProgram native;
+        int loaded = use_cache && cache_load_code(&cache, &native, &ir);
+        if (loaded || jit_compile(&native, &ir) == 0) {
+            if (use_cache && !loaded) cache_store_code(&cache, &native, &ir);
+            int *vars = calloc(native.num_vars > 0 ? native.num_vars : 1, sizeof(int));
+            int trap = JIT_OK;
+            int result = native.entry(vars, &trap);
+            if (trap == JIT_ERR_DIV_ZERO) {
+                fprintf(stderr, "Runtime error: division by zero\n");
+                status = EXIT_FAILURE;
+            } else {
+                printf("Result: %d\n", result);
+            }
+            free(vars);
+            jit_free(&native);
+        } else {
+            status = EXIT_FAILURE;
+        }
+    } else if (tier) {
+        // Interpret, compiling loops to native code once they get hot.
+        TieredProgram tiered;
+        tier_compile(&tiered, &ir, &tier_options);
+        int *vars = calloc(ir.var_count > 0 ? ir.var_count : 1, sizeof(int));
+        int result = 0;
+        if (tier_run(&tiered, vars, &result) == VM_ERR_DIV_ZERO) {
+            fprintf(stderr, "Runtime error: division by zero\n");
+            status = EXIT_FAILURE;
+        } else {
+            printf("Result: %d\n", result);
+        }
+        if (verbose) printf("[Tier] %d loops compiled, %lld native entries (%lld by on-stack replacement)\n",
+               tiered.stats.compiled, tiered.stats.native_entries, tiered.stats.osr_entries);
+        free(vars);
+        tier_free(&tiered);
+    } else if (run || bench_iterations > 0) {
+        VMProgram prog;
+        vm_compile(&prog, &ir);
+        int result = 0;
+        if (bench_iterations > 0) {
+            bench_vm(&prog, bench_iterations);
+        } else if (run_program(&prog, vm_run, &result)) {
+            printf("Result: %d\n", result);
+        } else {
+            status = EXIT_FAILURE;
+        }
+        vm_free(&prog);
+    } else {
+        // Print IR
+        ir_print(&ir);
+        if (print_cfg) {
+            CFG cfg;
+            cfg_build(&cfg, &ir);
+            cfg_print(&cfg, &ir);
+            cfg_free(&cfg);
+        }
+        if (print_regalloc) {
+            RegAlloc ra;
+            regalloc_run(&ra, &ir, JIT_NUM_REGS);
+            regalloc_print(&ra);
+            regalloc_free(&ra);
+        }
+    }
 
-    // Print IR
-    ir_print(&ir);
+    if (use_cache) {
+        cache_close(&cache);
+        if (verbose) printf("[Cache] %s: %lld hits, %lld misses (total %lld hits, %lld misses, %lld evicted; %d entries, %lld bytes)\n",
+               cache.key, cache.run.hits, cache.run.misses, cache.total.hits, cache.total.misses,
+               cache.total.evicted, cache.entries, cache.bytes);
+    }
 
     // Cleanup
     ir_free(&ir);
-    ast_list_free(program);
     fclose(source);
-    return EXIT_SUCCESS;
+    return status;
 }
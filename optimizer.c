@@ -1,73 +1,297 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "optimizer.h"
+#include "ssa.h"
+#include "dce.h"
+#include "licm.h"
+#include "ivopt.h"
+#include "unroll.h"
+#include "peephole.h"
+#include "gvn.h"
 
-void ir_optimize(IRList *list) {
-    IRInst *curr = list->head;
+// Constant evaluation with the same wrapping semantics as the VM and JIT.
+// Returns 0 when the operation would trap, in which case it is left alone.
+static int fold_binop(IROp op, int a, int b, int *result) {
+    switch (op) {
+        case IR_ADD: *result = (int)((unsigned)a + (unsigned)b); return 1;
+        case IR_SUB: *result = (int)((unsigned)a - (unsigned)b); return 1;
+        case IR_MUL: *result = (int)((unsigned)a * (unsigned)b); return 1;
+        case IR_DIV:
+            if (b == 0) return 0;
+            *result = b == -1 ? (int)(0u - (unsigned)a) : a / b;
+            return 1;
+        case IR_MOD:
+            if (b == 0) return 0;
+            *result = b == -1 ? 0 : a % b;
+            return 1;
+        case IR_EQ:  *result = a == b; return 1;
+        case IR_NEQ: *result = a != b; return 1;
+        case IR_LT:  *result = a < b; return 1;
+        case IR_GT:  *result = a > b; return 1;
+        case IR_LE:  *result = a <= b; return 1;
+        case IR_GE:  *result = a >= b; return 1;
+        case IR_AND: *result = a && b; return 1;
+        case IR_OR:  *result = a || b; return 1;
+        default: return 0;
+    }
+}
 
-    printf("[Optimizer] Starting optimization pass...\n");
+static int fold_unop(IROp op, int a, int *result) {
+    switch (op) {
+        case IR_NEG: *result = (int)(0u - (unsigned)a); return 1;
+        case IR_LOG_NOT: *result = !a; return 1;
+        case IR_BIT_NOT: *result = ~a; return 1;
+        default: return 0;
+    }
+}
 
-    while (curr != NULL) {
-        // Skip control flow instructions
-        if (curr->op == IR_LABEL || curr->op == IR_JUMP || curr->op == IR_JUMP_IF_FALSE || curr->op == IR_RETURN) {
-            curr = curr->next;
-            continue;
-        }
+// A constant is recorded with the epoch (basic block) it was learned in.
+// Temps with a single definition hold their value everywhere, so they are
+// tagged CONST_ALWAYS; variables and multiply-defined temps only stay known
+// until the next label, where control flow may merge.
+#define CONST_UNKNOWN 0u
+#define CONST_ALWAYS 0xffffffffu
+
+typedef struct {
+    unsigned *epoch;
+    int *value;
+} ConstTable;
+
+static void const_table_init(ConstTable *table, int size) {
+    table->epoch = calloc(size + 1, sizeof(unsigned));
+    table->value = malloc((size + 1) * sizeof(int));
+}
+
+static void const_table_free(ConstTable *table) {
+    free(table->epoch);
+    free(table->value);
+}
+
+static int const_lookup(ConstTable *table, int index, unsigned epoch, int *value) {
+    if (index < 0) return 0;
+    unsigned e = table->epoch[index];
+    if (e == CONST_UNKNOWN || (e != CONST_ALWAYS && e != epoch)) return 0;
+    *value = table->value[index];
+    return 1;
+}
+
+static void make_const(IRInst *inst, int value) {
+    inst->op = IR_LOAD_CONST;
+    inst->src1 = -1;
+    inst->value = value;
+}
+
+// Single forward pass: every operand lookup is O(1) through the temp and
+// variable tables instead of rescanning the list for its definition.
+int ir_fold_constants(IRList *list) {
+    int folded = 0;
+    ConstTable temps, vars;
+    const_table_init(&temps, list->temp_count);
+    const_table_init(&vars, list->var_count);
+
+    unsigned char *multi_def = calloc(list->temp_count + 1, 1);
+    unsigned char *seen_def = calloc(list->temp_count + 1, 1);
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (!ir_has_dest(inst->op) || inst->dest < 0) continue;
+        if (seen_def[inst->dest]) multi_def[inst->dest] = 1;
+        seen_def[inst->dest] = 1;
+    }
+
+    unsigned epoch = 1;
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int a, b, result;
+        int known = 0;
+
+        switch (inst->op) {
+            case IR_LABEL:
+                epoch++;
+                continue;
+
+            case IR_LOAD_CONST:
+                result = inst->value;
+                known = 1;
+                break;
+
+            case IR_LOAD_VAR:
+                if (const_lookup(&vars, inst->var, epoch, &result)) {
+                    make_const(inst, result);
+                    folded++;
+                    known = 1;
+                }
+                break;
+
+            case IR_STORE_VAR:
+                if (const_lookup(&temps, inst->src1, epoch, &result)) {
+                    vars.epoch[inst->var] = epoch;
+                    vars.value[inst->var] = result;
+                } else {
+                    vars.epoch[inst->var] = CONST_UNKNOWN;
+                }
+                continue;
+
+            case IR_COPY:
+                known = const_lookup(&temps, inst->src1, epoch, &result);
+                break;
 
-        if (curr->op == IR_ADD || curr->op == IR_SUB || curr->op == IR_MUL || curr->op == IR_DIV ||
-            curr->op == IR_EQ  || curr->op == IR_NEQ || curr->op == IR_LT  || curr->op == IR_GT ||
-            curr->op == IR_LE  || curr->op == IR_GE  || curr->op == IR_AND || curr->op == IR_OR) {
-
-            IRInst *src1 = NULL, *src2 = NULL;
-            IRInst *scan = list->head;
-
-            while (scan != NULL) {
-                if (scan->dest == curr->src1) src1 = scan;
-                if (scan->dest == curr->src2) src2 = scan;
-                scan = scan->next;
-            }
-
-            if (src1 && src2 && src1->op == IR_LOAD_CONST && src2->op == IR_LOAD_CONST) {
-                int result = 0;
-                switch (curr->op) {
-                    case IR_ADD: result = src1->value + src2->value; break;
-                    case IR_SUB: result = src1->value - src2->value; break;
-                    case IR_MUL: result = src1->value * src2->value; break;
-                    case IR_DIV: result = src1->value / src2->value; break;
-                    case IR_EQ:  result = (src1->value == src2->value); break;
-                    case IR_NEQ: result = (src1->value != src2->value); break;
-                    case IR_LT:  result = (src1->value < src2->value); break;
-                    case IR_GT:  result = (src1->value > src2->value); break;
-                    case IR_LE:  result = (src1->value <= src2->value); break;
-                    case IR_GE:  result = (src1->value >= src2->value); break;
-                    case IR_MOD: result = src1->value % src2->value; break;
-                    case IR_AND: result = (src1->value && src2->value); break;
-                    case IR_OR:  result = (src1->value || src2->value); break;
-                    default: break;
+            case IR_PHI:
+                break;
+
+            case IR_NEG:
+            case IR_LOG_NOT:
+            case IR_BIT_NOT:
+                if (const_lookup(&temps, inst->src1, epoch, &a) && fold_unop(inst->op, a, &result)) {
+                    make_const(inst, result);
+                    folded++;
+                    known = 1;
                 }
+                break;
 
-                if (src1 && src1->op == IR_LOAD_CONST) {
-                    int result;
-                    switch (curr->op) {
-                        case IR_NEG: result = -src1->value; break;
-                        case IR_LOG_NOT: result = !src1->value; break;
-                        case IR_BIT_NOT: result = ~src1->value; break;
-                        default: continue;
+            case IR_JUMP_IF_FALSE:
+                if (const_lookup(&temps, inst->src1, epoch, &a)) {
+                    if (a) {
+                        inst->op = IR_NOP;
+                    } else {
+                        inst->op = IR_JUMP;
+                        inst->src1 = -1;
                     }
+                    folded++;
+                }
+                continue;
 
-                    curr->op = IR_LOAD_CONST;
-                    curr->value = result;
-                    curr->src1 = curr->src2 = -1;
+            case IR_JUMP:
+            case IR_RETURN:
+            case IR_NOP:
+                continue;
+
+            default:
+                if (const_lookup(&temps, inst->src1, epoch, &a) &&
+                    const_lookup(&temps, inst->src2, epoch, &b) &&
+                    fold_binop(inst->op, a, b, &result)) {
+                    make_const(inst, result);
+                    folded++;
+                    known = 1;
                 }
+                break;
+        }
 
-                printf("[Optimizer] Folding: t%d = %d (was t%d op t%d)\n", curr->dest, result, curr->src1, curr->src2);
+        if (inst->dest < 0) continue;
+        if (known) {
+            temps.epoch[inst->dest] = multi_def[inst->dest] ? epoch : CONST_ALWAYS;
+            temps.value[inst->dest] = result;
+        } else {
+            temps.epoch[inst->dest] = CONST_UNKNOWN;
+        }
+    }
 
-                curr->op = IR_LOAD_CONST;
-                curr->value = result;
-                curr->src1 = curr->src2 = -1;
-            }
+    ir_remove_nops(list);
+    const_table_free(&temps);
+    const_table_free(&vars);
+    free(multi_def);
+    free(seen_def);
+    return folded;
+}
+
+void opt_options_init(OptOptions *options) {
+    options->unroll_factor = UNROLL_DEFAULT_FACTOR;
+    options->unroll_budget = UNROLL_DEFAULT_BUDGET;
+    options->verbose = 0;
+    options->stats = NULL;
+}
+
+// Folding and dead code elimination run several times; each run is added
+// to the same phase.
+static int timed_fold(IRList *list, Stats *stats) {
+    StatTimer timer;
+    stats_begin(stats, &timer);
+    int folded = ir_fold_constants(list);
+    stats_end(stats, STAT_FOLD, &timer, folded);
+    return folded;
+}
+
+static int timed_dce(IRList *list, Stats *stats) {
+    StatTimer timer;
+    stats_begin(stats, &timer);
+    int dead = ir_eliminate_dead_code(list);
+    stats_end(stats, STAT_DCE, &timer, dead);
+    return dead;
+}
+
+static void timed_peephole(IRList *list, PeepholeStats *peephole, Stats *stats) {
+    StatTimer timer;
+    stats_begin(stats, &timer);
+    int rewrites = ir_peephole(list, peephole);
+    stats_end(stats, STAT_PEEPHOLE, &timer, rewrites);
+}
+
+void ir_optimize(IRList *list, const OptOptions *options) {
+    Stats *stats = options->stats;
+    StatTimer timer;
+    if (options->verbose) printf("[Optimizer] Starting optimization pass...\n");
+
+    int folded = timed_fold(list, stats);
+    if (options->verbose) printf("[Optimizer] Folded %d instructions\n", folded);
+
+    int dead = timed_dce(list, stats);
+
+    stats_begin(stats, &timer);
+    int hoisted = ir_hoist_loop_invariants(list);
+    stats_end(stats, STAT_LICM, &timer, hoisted);
+    if (options->verbose) printf("[Optimizer] Hoisted %d loop-invariant instructions\n", hoisted);
+
+    IVStats iv;
+    stats_begin(stats, &timer);
+    ir_optimize_induction_vars(list, &iv);
+    stats_end(stats, STAT_IVOPT, &timer, iv.closed_form + iv.reduced + iv.eliminated);
+    if (options->verbose) printf("[Optimizer] Induction variables: %d counted loops, %d closed forms, %d strength reductions, %d eliminated\n",
+                                 iv.counted, iv.closed_form, iv.reduced, iv.eliminated);
+    // Closed forms are built from constants the folder can now combine.
+    if (iv.closed_form > 0) timed_fold(list, stats);
+    if (iv.closed_form + iv.reduced + iv.eliminated > 0) dead += timed_dce(list, stats);
+
+    UnrollStats unrolled;
+    stats_begin(stats, &timer);
+    ir_unroll_loops(list, options->unroll_factor, options->unroll_budget, &unrolled);
+    stats_end(stats, STAT_UNROLL, &timer, unrolled.full + unrolled.partial);
+    if (options->verbose) printf("[Optimizer] Unrolled %d loops fully, %d by a factor of %d\n",
+                                 unrolled.full, unrolled.partial, options->unroll_factor);
+    // Flattened copies see the induction variable as a constant.
+    if (unrolled.full > 0) timed_fold(list, stats);
+    if (unrolled.full + unrolled.partial > 0) dead += timed_dce(list, stats);
+
+    // Once before promotion for the variable traffic unrolling and lowering
+    // leave inside blocks, once after for the copies leaving SSA adds.
+    PeepholeStats peephole;
+    memset(&peephole, 0, sizeof(peephole));
+    timed_peephole(list, &peephole, stats);
+
+    CFG cfg;
+    stats_begin(stats, &timer);
+    int promoted = ssa_enter(list, &cfg);
+    stats_end(stats, STAT_SSA, &timer, promoted);
+    if (options->verbose) printf("[Optimizer] Promoted %d variables to SSA temps\n", promoted);
+    stats_begin(stats, &timer);
+    int numbered = ir_value_number(list, &cfg);
+    stats_end(stats, STAT_GVN, &timer, numbered);
+    if (options->verbose) printf("[Optimizer] Value numbering removed %d redundant instructions\n", numbered);
+    stats_begin(stats, &timer);
+    ssa_leave(list, &cfg);
+    stats_end(stats, STAT_SSA, &timer, 0);
+
+    timed_peephole(list, &peephole, stats);
+    if (options->verbose) {
+        printf("[Optimizer] Peephole rewrites:");
+        for (int r = 0; r < PEEP_NUM_RULES; r++) {
+            printf(" %s %d%s", peephole_rule_name((PeepholeRule)r), peephole.rewrites[r], r + 1 < PEEP_NUM_RULES ? "," : "\n");
         }
-        curr = curr->next;
     }
+    if (stats) memcpy(stats->peephole_rules, peephole.rewrites, sizeof(peephole.rewrites));
+
+    // Promotion leaves copies and entry loads that nothing reads.
+    dead += timed_dce(list, stats);
+    if (options->verbose) printf("[Optimizer] Removed %d dead instructions\n", dead);
 
-    printf("[Optimizer] Optimization complete.\n");
+    if (options->verbose) printf("[Optimizer] Optimization complete.\n");
 }
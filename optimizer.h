@@ -2,7 +2,17 @@
 #define OPTIMIZER_H
 
 #include "ir.h"
+#include "stats.h"
 
-void ir_optimize(IRList *list);
+typedef struct {
+    int unroll_factor;      // copies of the body per main-loop test, 1 disables
+    int unroll_budget;      // instructions an unrolled loop body may grow to
+    int verbose;            // print a line per pass
+    Stats *stats;           // per-pass times and rewrites, NULL when off
+} OptOptions;
+
+void opt_options_init(OptOptions *options);
+int ir_fold_constants(IRList *list);
+void ir_optimize(IRList *list, const OptOptions *options);
 
 #endif
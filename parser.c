@@ -1,128 +1,170 @@
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include "parser.h"
 #include "lexer.h"
+#include "stats.h"
+
+static void parser_start(Parser *p, Arena *arena) {
+    p->arena = arena;
+    p->failed = 0;
+    p->error[0] = '\0';
+    p->nodes = 0;
+    p->stats = NULL;
+}
 
-static Token current_token;
+void parser_init(Parser *p, FILE *src, Arena *arena, InternPool *atoms) {
+    lexer_init(&p->lexer, src, atoms);
+    parser_start(p, arena);
+}
 
-void parser_init(FILE *src) {
-    lexer_init(src);
-    current_token = lexer_next_token();
+void parser_init_buffer(Parser *p, const char *src, size_t size, Arena *arena, InternPool *atoms) {
+    lexer_init_buffer(&p->lexer, src, size, atoms);
+    parser_start(p, arena);
 }
 
-static void advance() {
-    current_token = lexer_next_token();
+void parser_free(Parser *p) {
+    lexer_free(&p->lexer);
 }
 
-static void expect(TokenType type) {
-    if (current_token.type != type) {
-        fprintf(stderr, "Syntax error: expected %d but got %d\n", type, current_token.type);
-        exit(EXIT_FAILURE);
+static void advance(Parser *p) {
+    if (p->failed) return;
+    if (!p->stats) {
+        p->current = lexer_next_token(&p->lexer);
+        return;
     }
-    advance();
+    // Only the wall clock is cheap enough to read around every token.
+    double start = stats_now_ms();
+    p->current = lexer_next_token(&p->lexer);
+    StatPhaseTotals *lex = &p->stats->phases[STAT_LEX];
+    lex->wall_ms += stats_now_ms() - start - p->stats->clock_ms;
+    lex->calls++;
+    p->stats->tokens++;
 }
 
-ASTNode *new_node(ASTNodeType type) {
-    ASTNode *node = malloc(sizeof(ASTNode));
-    if (!node) {
-        perror("new_node");
-        exit(EXIT_FAILURE);
+// Keeps the first error and ends the input, so every loop in the parser
+// runs out and the caller sees failed.
+static void syntax_error(Parser *p, const char *fmt, ...) {
+    if (p->failed) return;
+    p->failed = 1;
+    if (p->current.type == TOKEN_UNKNOWN) {
+        snprintf(p->error, sizeof(p->error), "Unknown character: '%c' (%d)", p->current.value, p->current.value);
+    } else {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(p->error, sizeof(p->error), fmt, args);
+        va_end(args);
     }
+    p->current.type = TOKEN_EOF;
+}
+
+static void expect(Parser *p, TokenType type) {
+    if (p->current.type != type) {
+        syntax_error(p, "Syntax error: expected %d but got %d", type, p->current.type);
+        return;
+    }
+    advance(p);
+}
+
+ASTNode *new_node(Parser *p, ASTNodeType type) {
+    ASTNode *node = arena_alloc(p->arena, sizeof(ASTNode));
     node->type = type;
+    p->nodes++;
     return node;
 }
 
 // Expression parsing precedence declarations
-ASTNode *parse_or();
-ASTNode *parse_and();
-ASTNode *parse_equality();
-ASTNode *parse_relational();
-ASTNode *parse_additive();
-ASTNode *parse_term();
-ASTNode *parse_factor();
-
-ASTList *parse_program(void);
-ASTNode *parse_statement();
-ASTNode *parse_block();
-ASTNode *parse_expression();
-ASTNode *parse_variable();
-ASTNode *parse_declaration();
-ASTNode *parse_assignment();
-ASTNode *parse_if_statement();
-ASTNode *parse_while_statement();
-ASTNode *parse_for_statement();
-ASTNode *parse_print_statement();
-ASTNode *parse_return_statement();
-
-ASTList *parse_program(void) {
+ASTNode *parse_or(Parser *p);
+ASTNode *parse_and(Parser *p);
+ASTNode *parse_equality(Parser *p);
+ASTNode *parse_relational(Parser *p);
+ASTNode *parse_additive(Parser *p);
+ASTNode *parse_term(Parser *p);
+ASTNode *parse_factor(Parser *p);
+
+ASTList *parse_program(Parser *p);
+ASTNode *parse_statement(Parser *p);
+ASTNode *parse_block(Parser *p);
+ASTNode *parse_expression(Parser *p);
+ASTNode *parse_variable(Parser *p);
+ASTNode *parse_declaration(Parser *p);
+ASTNode *parse_assignment(Parser *p);
+ASTNode *parse_if_statement(Parser *p);
+ASTNode *parse_while_statement(Parser *p);
+ASTNode *parse_for_statement(Parser *p);
+ASTNode *parse_print_statement(Parser *p);
+ASTNode *parse_return_statement(Parser *p);
+
+ASTList *parse_program(Parser *p) {
     ASTList *head = NULL, *tail = NULL;
-    while (current_token.type != TOKEN_EOF) {
-        ASTNode *stmt = parse_statement();
-        ASTList *node = malloc(sizeof(ASTList));
+    advance(p);
+    while (p->current.type != TOKEN_EOF) {
+        ASTNode *stmt = parse_statement(p);
+        ASTList *node = arena_alloc(p->arena, sizeof(ASTList));
         node->stmt = stmt;
         node->next = NULL;
         if (tail) tail->next = node;
         else head = node;
         tail = node;
     }
-    return head;
+    return p->failed ? NULL : head;
 }
 
-ASTNode *parse_statement() {
-    if (current_token.type == TOKEN_INT) return parse_declaration();
-    if (current_token.type == TOKEN_IDENTIFIER) return parse_assignment();
-    if (current_token.type == TOKEN_IF) return parse_if_statement();
-    if (current_token.type == TOKEN_WHILE) return parse_while_statement();
-    if (current_token.type == TOKEN_FOR) return parse_for_statement();
-    if (current_token.type == TOKEN_PRINT) return parse_print_statement();
-    if (current_token.type == TOKEN_RETURN) return parse_return_statement();
-    if (current_token.type == TOKEN_LBRACE) return parse_block();
-
-    fprintf(stderr, "Unexpected token %d in statement\n", current_token.type);
-    exit(EXIT_FAILURE);
+ASTNode *parse_statement(Parser *p) {
+    if (p->current.type == TOKEN_INT) return parse_declaration(p);
+    if (p->current.type == TOKEN_IDENTIFIER) return parse_assignment(p);
+    if (p->current.type == TOKEN_IF) return parse_if_statement(p);
+    if (p->current.type == TOKEN_WHILE) return parse_while_statement(p);
+    if (p->current.type == TOKEN_FOR) return parse_for_statement(p);
+    if (p->current.type == TOKEN_PRINT) return parse_print_statement(p);
+    if (p->current.type == TOKEN_RETURN) return parse_return_statement(p);
+    if (p->current.type == TOKEN_LBRACE) return parse_block(p);
+
+    syntax_error(p, "Unexpected token %d in statement", p->current.type);
+    return NULL;
 }
 
-ASTNode *parse_block() {
-    expect(TOKEN_LBRACE);
+ASTNode *parse_block(Parser *p) {
+    expect(p, TOKEN_LBRACE);
     ASTList *stmts = NULL, *tail = NULL;
-    while (current_token.type != TOKEN_RBRACE) {
-        ASTNode *stmt = parse_statement();
-        ASTList *node = malloc(sizeof(ASTList));
+    while (p->current.type != TOKEN_RBRACE && p->current.type != TOKEN_EOF) {
+        ASTNode *stmt = parse_statement(p);
+        ASTList *node = arena_alloc(p->arena, sizeof(ASTList));
         node->stmt = stmt;
         node->next = NULL;
         if (tail) tail->next = node;
         else stmts = node;
         tail = node;
     }
-    expect(TOKEN_RBRACE);
-    ASTNode *block = new_node(AST_BLOCK);
+    expect(p, TOKEN_RBRACE);
+    ASTNode *block = new_node(p, AST_BLOCK);
     block->block.stmts = stmts;
     return block;
 }
 
-ASTNode *parse_variable() {
-    if (current_token.type != TOKEN_IDENTIFIER) {
-        fprintf(stderr, "Expected identifier\n" );
-        exit(EXIT_FAILURE);
+ASTNode *parse_variable(Parser *p) {
+    if (p->current.type != TOKEN_IDENTIFIER) {
+        syntax_error(p, "Expected identifier");
+        return NULL;
     }
-    ASTNode *node = new_node(AST_VAR);
-    node->var_name = strdup(current_token.text);
-    advance();
+    ASTNode *node = new_node(p, AST_VAR);
+    node->var = p->current.atom;
+    advance(p);
     return node;
 }
 
-ASTNode *parse_expression() {
-    return parse_or();
+ASTNode *parse_expression(Parser *p) {
+    return parse_or(p);
 }
 
-ASTNode *parse_or() {
-    ASTNode *left = parse_and();
-    while (current_token.type == TOKEN_OR) {
+ASTNode *parse_or(Parser *p) {
+    ASTNode *left = parse_and(p);
+    while (p->current.type == TOKEN_OR) {
         int op = '|';
-        advance();
-        ASTNode *right = parse_and();
-        ASTNode *node = new_node(AST_BINARY_OP);
+        advance(p);
+        ASTNode *right = parse_and(p);
+        ASTNode *node = new_node(p, AST_BINARY_OP);
         node->binop.op = op;
         node->binop.left = left;
         node->binop.right = right;
@@ -131,13 +173,13 @@ ASTNode *parse_or() {
     return left;
 }
 
-ASTNode *parse_and() {
-    ASTNode *left = parse_equality();
-    while (current_token.type == TOKEN_AND) {
+ASTNode *parse_and(Parser *p) {
+    ASTNode *left = parse_equality(p);
+    while (p->current.type == TOKEN_AND) {
         int op = '&';
-        advance();
-        ASTNode *right = parse_equality();
-        ASTNode *node = new_node(AST_BINARY_OP);
+        advance(p);
+        ASTNode *right = parse_equality(p);
+        ASTNode *node = new_node(p, AST_BINARY_OP);
         node->binop.op = op;
         node->binop.left = left;
         node->binop.right = right;
@@ -146,13 +188,13 @@ ASTNode *parse_and() {
     return left;
 }
 
-ASTNode *parse_equality() {
-    ASTNode *left = parse_relational();
-    while (current_token.type == TOKEN_EQ || current_token.type == TOKEN_NEQ) {
-        int op = (current_token.type == TOKEN_EQ) ? '=' : '!';
-        advance();
-        ASTNode *right = parse_relational();
-        ASTNode *node = new_node(AST_BINARY_OP);
+ASTNode *parse_equality(Parser *p) {
+    ASTNode *left = parse_relational(p);
+    while (p->current.type == TOKEN_EQ || p->current.type == TOKEN_NEQ) {
+        int op = (p->current.type == TOKEN_EQ) ? '=' : '!';
+        advance(p);
+        ASTNode *right = parse_relational(p);
+        ASTNode *node = new_node(p, AST_BINARY_OP);
         node->binop.op = op;
         node->binop.left = left;
         node->binop.right = right;
@@ -161,23 +203,23 @@ ASTNode *parse_equality() {
     return left;
 }
 
-ASTNode *parse_relational() {
-    ASTNode *left = parse_additive();
-    while (current_token.type == TOKEN_LT || current_token.type == TOKEN_GT ||
-           current_token.type == TOKEN_LE || current_token.type == TOKEN_GE) {
+ASTNode *parse_relational(Parser *p) {
+    ASTNode *left = parse_additive(p);
+    while (p->current.type == TOKEN_LT || p->current.type == TOKEN_GT ||
+           p->current.type == TOKEN_LE || p->current.type == TOKEN_GE) {
         int op;
-        switch (current_token.type) {
+        switch (p->current.type) {
             case TOKEN_LT: op = '<'; break;
             case TOKEN_GT: op = '>'; break;
             case TOKEN_LE: op = 'l'; break;
             case TOKEN_GE: op = 'g'; break;
             default:
-                fprintf(stderr, "Unexpected token %d in relational operator\n", current_token.type);
-                exit(EXIT_FAILURE);
+                syntax_error(p, "Unexpected token %d in relational operator", p->current.type);
+                return NULL;
         }
-        advance();
-        ASTNode *right = parse_additive();
-        ASTNode *node = new_node(AST_BINARY_OP);
+        advance(p);
+        ASTNode *right = parse_additive(p);
+        ASTNode *node = new_node(p, AST_BINARY_OP);
         node->binop.op = op;
         node->binop.left = left;
         node->binop.right = right;
@@ -186,13 +228,13 @@ ASTNode *parse_relational() {
     return left;
 }
 
-ASTNode *parse_additive() {
-    ASTNode *left = parse_term();
-    while (current_token.type == TOKEN_PLUS || current_token.type == TOKEN_MINUS) {
-        int op = (current_token.type == TOKEN_PLUS) ? '+' : '-';
-        advance();
-        ASTNode *right = parse_term();
-        ASTNode *node = new_node(AST_BINARY_OP);
+ASTNode *parse_additive(Parser *p) {
+    ASTNode *left = parse_term(p);
+    while (p->current.type == TOKEN_PLUS || p->current.type == TOKEN_MINUS) {
+        int op = (p->current.type == TOKEN_PLUS) ? '+' : '-';
+        advance(p);
+        ASTNode *right = parse_term(p);
+        ASTNode *node = new_node(p, AST_BINARY_OP);
         node->binop.op = op;
         node->binop.left = left;
         node->binop.right = right;
@@ -201,21 +243,21 @@ ASTNode *parse_additive() {
     return left;
 }
 
-ASTNode *parse_term() {
-    ASTNode *left = parse_factor();
-    while (current_token.type == TOKEN_STAR || current_token.type == TOKEN_SLASH || current_token.type == TOKEN_PERCENT) {
+ASTNode *parse_term(Parser *p) {
+    ASTNode *left = parse_factor(p);
+    while (p->current.type == TOKEN_STAR || p->current.type == TOKEN_SLASH || p->current.type == TOKEN_PERCENT) {
         int op;
-        switch (current_token.type) {
+        switch (p->current.type) {
             case TOKEN_STAR: op = '*'; break;
             case TOKEN_SLASH: op = '/'; break;
             case TOKEN_PERCENT: op = '%'; break;
             default:
-                fprintf(stderr, "Unexpected token %d in term operator\n", current_token.type);
-                exit(EXIT_FAILURE);
+                syntax_error(p, "Unexpected token %d in term operator", p->current.type);
+                return NULL;
         }
-        advance();
-        ASTNode *right = parse_factor();
-        ASTNode *node = new_node(AST_BINARY_OP);
+        advance(p);
+        ASTNode *right = parse_factor(p);
+        ASTNode *node = new_node(p, AST_BINARY_OP);
         node->binop.op = op;
         node->binop.left = left;
         node->binop.right = right;
@@ -226,130 +268,135 @@ ASTNode *parse_term() {
 
 
 
-ASTNode *parse_factor() {
-    if (current_token.type == TOKEN_MINUS || current_token.type == TOKEN_LOG_NOT || current_token.type == TOKEN_BIT_NOT) {
+ASTNode *parse_factor(Parser *p) {
+    if (p->current.type == TOKEN_MINUS || p->current.type == TOKEN_LOG_NOT || p->current.type == TOKEN_BIT_NOT) {
         int op;
-        switch (current_token.type) {
+        switch (p->current.type) {
             case TOKEN_MINUS: op = '-'; break;
             case TOKEN_LOG_NOT: op = '!'; break;
             case TOKEN_BIT_NOT: op = '~'; break;
             default:
-                fprintf(stderr, "Unexpected token %d in unary operator\n", current_token.type);
-                exit(EXIT_FAILURE);
+                syntax_error(p, "Unexpected token %d in unary operator", p->current.type);
+                return NULL;
         }
-        advance();
-        ASTNode *operand = parse_factor();
-        ASTNode *node = new_node(AST_UNARY_OP);
+        advance(p);
+        ASTNode *operand = parse_factor(p);
+        ASTNode *node = new_node(p, AST_UNARY_OP);
         node->unop.op = op;
         node->unop.operand = operand;
         return node;
-    } else if (current_token.type == TOKEN_NUMBER) {
-        ASTNode *node = new_node(AST_NUMBER);
-        node->number = current_token.value;
-        advance();
+    } else if (p->current.type == TOKEN_NUMBER) {
+        ASTNode *node = new_node(p, AST_NUMBER);
+        node->number = p->current.value;
+        advance(p);
         return node;
-    } else if (current_token.type == TOKEN_IDENTIFIER) {
-        return parse_variable();
-    } else if (current_token.type == TOKEN_LPAREN) {
-        advance();
-        ASTNode *node = parse_expression();
-        expect(TOKEN_RPAREN);
+    } else if (p->current.type == TOKEN_IDENTIFIER) {
+        return parse_variable(p);
+    } else if (p->current.type == TOKEN_LPAREN) {
+        advance(p);
+        ASTNode *node = parse_expression(p);
+        expect(p, TOKEN_RPAREN);
         return node;
     } else {
-        fprintf(stderr, "Unexpected token in factor: %d\n", current_token.type);
-        exit(EXIT_FAILURE);
+        syntax_error(p, "Unexpected token in factor: %d", p->current.type);
+        return NULL;
     }
 }
 
 
 
-ASTNode *parse_assignment() {
-    ASTNode *lhs = parse_variable();
-    expect(TOKEN_ASSIGN);
-    ASTNode *rhs = parse_expression();
-    expect(TOKEN_SEMICOLON);
-    ASTNode *node = new_node(AST_ASSIGN);
+static ASTNode *parse_assignment_expr(Parser *p) {
+    ASTNode *lhs = parse_variable(p);
+    expect(p, TOKEN_ASSIGN);
+    ASTNode *rhs = parse_expression(p);
+    ASTNode *node = new_node(p, AST_ASSIGN);
     node->assign.lhs = lhs;
     node->assign.rhs = rhs;
     return node;
 }
 
-ASTNode *parse_declaration() {
-    expect(TOKEN_INT);
-    if (current_token.type != TOKEN_IDENTIFIER) {
-        fprintf(stderr, "Expected identifier in declaration\n" );
-        exit(EXIT_FAILURE);
+ASTNode *parse_assignment(Parser *p) {
+    ASTNode *node = parse_assignment_expr(p);
+    expect(p, TOKEN_SEMICOLON);
+    return node;
+}
+
+ASTNode *parse_declaration(Parser *p) {
+    expect(p, TOKEN_INT);
+    if (p->current.type != TOKEN_IDENTIFIER) {
+        syntax_error(p, "Expected identifier in declaration");
+        return NULL;
     }
-    char *name = strdup(current_token.text);
-    advance();
+    Atom name = p->current.atom;
+    advance(p);
     ASTNode *init = NULL;
-    if (current_token.type == TOKEN_ASSIGN) {
-        advance();
-        init = parse_expression();
+    if (p->current.type == TOKEN_ASSIGN) {
+        advance(p);
+        init = parse_expression(p);
     }
-    expect(TOKEN_SEMICOLON);
-    ASTNode *decl = new_node(AST_DECL);
-    decl->decl.var_name = name;
+    expect(p, TOKEN_SEMICOLON);
+    ASTNode *decl = new_node(p, AST_DECL);
+    decl->decl.var = name;
     decl->decl.init = init;
     return decl;
 }
 
-ASTNode *parse_if_statement() {
-    expect(TOKEN_IF);
-    expect(TOKEN_LPAREN);
-    ASTNode *cond = parse_expression();
-    expect(TOKEN_RPAREN);
-    ASTNode *then_stmt = parse_statement();
-    ASTNode *stmt = new_node(AST_IF);
+ASTNode *parse_if_statement(Parser *p) {
+    expect(p, TOKEN_IF);
+    expect(p, TOKEN_LPAREN);
+    ASTNode *cond = parse_expression(p);
+    expect(p, TOKEN_RPAREN);
+    ASTNode *then_stmt = parse_statement(p);
+    ASTNode *stmt = new_node(p, AST_IF);
     stmt->if_stmt.condition = cond;
     stmt->if_stmt.then_stmt = then_stmt;
     stmt->if_stmt.else_branch = NULL;
-    if (current_token.type == TOKEN_ELSE) {
-        advance();
-        stmt->if_stmt.else_branch = parse_statement();
+    if (p->current.type == TOKEN_ELSE) {
+        advance(p);
+        stmt->if_stmt.else_branch = parse_statement(p);
     }
     return stmt;
 }
 
-ASTNode *parse_while_statement() {
-    expect(TOKEN_WHILE);
-    expect(TOKEN_LPAREN);
-    ASTNode *cond = parse_expression();
-    expect(TOKEN_RPAREN);
-    ASTNode *body = parse_statement();
-    ASTNode *stmt = new_node(AST_WHILE);
+ASTNode *parse_while_statement(Parser *p) {
+    expect(p, TOKEN_WHILE);
+    expect(p, TOKEN_LPAREN);
+    ASTNode *cond = parse_expression(p);
+    expect(p, TOKEN_RPAREN);
+    ASTNode *body = parse_statement(p);
+    ASTNode *stmt = new_node(p, AST_WHILE);
     stmt->while_stmt.condition = cond;
     stmt->while_stmt.do_stmt = body;
     return stmt;
 }
 
-ASTNode *parse_for_statement() {
-    expect(TOKEN_FOR);
-    expect(TOKEN_LPAREN);
+ASTNode *parse_for_statement(Parser *p) {
+    expect(p, TOKEN_FOR);
+    expect(p, TOKEN_LPAREN);
     ASTNode *init = NULL;
     ASTNode *cond = NULL;
     ASTNode *update = NULL;
 
-    if (current_token.type == TOKEN_INT) {
-        init = parse_declaration();
-    } else if (current_token.type != TOKEN_SEMICOLON) {
-        init = parse_assignment();
+    if (p->current.type == TOKEN_INT) {
+        init = parse_declaration(p);
+    } else if (p->current.type != TOKEN_SEMICOLON) {
+        init = parse_assignment(p);
     } else {
-        advance();
+        advance(p);
     }
 
-    if (current_token.type != TOKEN_SEMICOLON) {
-        cond = parse_expression();
+    if (p->current.type != TOKEN_SEMICOLON) {
+        cond = parse_expression(p);
     }
-    expect(TOKEN_SEMICOLON);
+    expect(p, TOKEN_SEMICOLON);
 
-    if (current_token.type != TOKEN_RPAREN) {
-        update = parse_assignment();
+    if (p->current.type != TOKEN_RPAREN) {
+        update = parse_assignment_expr(p);
     }
-    expect(TOKEN_RPAREN);
+    expect(p, TOKEN_RPAREN);
 
-    ASTNode *body = parse_statement();
-    ASTNode *stmt = new_node(AST_FOR);
+    ASTNode *body = parse_statement(p);
+    ASTNode *stmt = new_node(p, AST_FOR);
     stmt->for_stmt.init = init;
     stmt->for_stmt.condition = cond;
     stmt->for_stmt.update = update;
@@ -357,79 +404,20 @@ ASTNode *parse_for_statement() {
     return stmt;
 }
 
-ASTNode *parse_print_statement() {
-    expect(TOKEN_PRINT);
-    ASTNode *expr = parse_expression();
-    expect(TOKEN_SEMICOLON);
-    ASTNode *stmt = new_node(AST_PRINT);
+ASTNode *parse_print_statement(Parser *p) {
+    expect(p, TOKEN_PRINT);
+    ASTNode *expr = parse_expression(p);
+    expect(p, TOKEN_SEMICOLON);
+    ASTNode *stmt = new_node(p, AST_PRINT);
     stmt->print_stmt.expr = expr;
     return stmt;
 }
 
-ASTNode *parse_return_statement() {
-    expect(TOKEN_RETURN);
-    ASTNode *expr = parse_expression();
-    expect(TOKEN_SEMICOLON);
-    ASTNode *stmt = new_node(AST_RETURN);
+ASTNode *parse_return_statement(Parser *p) {
+    expect(p, TOKEN_RETURN);
+    ASTNode *expr = parse_expression(p);
+    expect(p, TOKEN_SEMICOLON);
+    ASTNode *stmt = new_node(p, AST_RETURN);
     stmt->expr = expr;
     return stmt;
 }
-
-void ast_list_free(ASTList *list) {
-    while (list) {
-        ASTList *next = list->next;
-        ast_free(list->stmt);
-        free(list);
-        list = next;
-    }
-}
-
-void ast_free(ASTNode *node) {
-    if (!node) return;
-    switch (node->type) {
-        case AST_VAR: free(node->var_name); break;
-        case AST_NUMBER: break;
-        case AST_ASSIGN:
-            ast_free(node->assign.lhs);
-            ast_free(node->assign.rhs);
-            break;
-        case AST_DECL:
-            free(node->decl.var_name);
-            ast_free(node->decl.init);
-            break;
-        case AST_BINARY_OP:
-            ast_free(node->binop.left);
-            ast_free(node->binop.right);
-            break;
-        case AST_UNARY_OP:
-            ast_free(node->unop.operand);
-            break;
-        case AST_PRINT:
-            ast_free(node->print_stmt.expr);
-            break;
-        case AST_RETURN:
-            ast_free(node->expr);
-            break;
-        case AST_IF:
-            ast_free(node->if_stmt.condition);
-            ast_free(node->if_stmt.then_stmt);
-            ast_free(node->if_stmt.else_branch);
-            break;
-        case AST_WHILE:
-            ast_free(node->while_stmt.condition);
-            ast_free(node->while_stmt.do_stmt);
-            break;
-        case AST_FOR:
-            ast_free(node->for_stmt.init);
-            ast_free(node->for_stmt.condition);
-            ast_free(node->for_stmt.update);
-            ast_free(node->for_stmt.body);
-            break;
-        case AST_BLOCK:
-            ast_list_free(node->block.stmts);
-            break;
-        default:
-            break;
-    }
-    free(node);
-}
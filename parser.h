@@ -2,6 +2,9 @@
 #define PARSER_H
 
 #include <stdio.h>
+#include "arena.h"
+#include "intern.h"
+#include "lexer.h"
 
 typedef enum {
     AST_NUMBER,
@@ -35,13 +38,13 @@ typedef struct ASTNode {
             struct ASTNode *left;
             struct ASTNode *right;
         } binop;
-        char *var_name;
+        Atom var;
         struct {
             struct ASTNode *lhs;
             struct ASTNode *rhs;
         } assign;
         struct {
-            char *var_name;
+            Atom var;
             struct ASTNode *init;
         } decl;
         struct {
@@ -76,12 +79,31 @@ typedef struct ASTNode {
     };
 } ASTNode;
 
-// Parser functions
-void parser_init(FILE *src);
-ASTList *parse_program(void);
-ASTNode *parse_variable(void);
-void ast_free(ASTNode *node);
-void ast_list_free(ASTList *list);
-ASTNode *new_node(ASTNodeType type);
+// Parser state of one compilation. After the first syntax error the
+// parser stops consuming input and failed stays set with the message in
+// error.
+typedef struct {
+    Lexer lexer;
+    Token current;
+    Arena *arena;
+    int failed;
+    char error[128];
+    long long nodes;        // AST nodes allocated
+    struct Stats *stats;    // set by the caller to time the lexer, else NULL
+} Parser;
+
+// Parser functions. Nodes and list cells are allocated from arena and
+// released together with it; there is no per-node free. Identifiers are
+// atoms from the compilation's intern pool.
+void parser_init(Parser *p, FILE *src, Arena *arena, InternPool *atoms);
+// Parses size bytes at src, which must stay valid until parser_free.
+void parser_init_buffer(Parser *p, const char *src, size_t size, Arena *arena, InternPool *atoms);
+// Reads the first token, then returns the statements in order, or NULL
+// with p->failed set.
+ASTList *parse_program(Parser *p);
+ASTNode *parse_variable(Parser *p);
+ASTNode *new_node(Parser *p, ASTNodeType type);
+// Releases the source; the AST lives on in the arena.
+void parser_free(Parser *p);
 
 #endif
@@ -0,0 +1,288 @@
+#include <stdlib.h>
+#include <string.h>
+#include "peephole.h"
+
+// How many instructions past its source a value or copy is followed. The
+// walk also ends at the block boundary.
+#define PEEPHOLE_WINDOW 16
+
+typedef struct {
+    IRList *list;
+    int *defs;          // definitions per temp
+    int *def_inst;      // the definition of single-def temps, else -1
+} Peephole;
+
+typedef int (*PeepholeFn)(Peephole *p, int i);
+
+static int is_compare(IROp op) {
+    return op >= IR_EQ && op <= IR_GE;
+}
+
+static int is_terminator(IROp op) {
+    return op == IR_JUMP || op == IR_JUMP_IF_FALSE || op == IR_RETURN;
+}
+
+static int defines(IRInst *inst, int temp) {
+    return ir_has_dest(inst->op) && inst->dest == temp;
+}
+
+// Whether the window walk stops before looking at inst.
+static int window_closed(IRInst *inst) {
+    return inst->op == IR_LABEL || inst->op == IR_PHI;
+}
+
+// The instruction defining temp when it is the only definition, so the
+// temp holds the same value wherever it is read.
+static IRInst *single_def(Peephole *p, int temp) {
+    if (temp < 0 || p->def_inst[temp] < 0) return NULL;
+    return &p->list->insts[p->def_inst[temp]];
+}
+
+static int const_of(Peephole *p, int temp, int *value) {
+    IRInst *def = single_def(p, temp);
+    if (!def || def->op != IR_LOAD_CONST) return 0;
+    *value = def->value;
+    return 1;
+}
+
+static int replace_uses(IRInst *inst, int from, int to) {
+    int n = 0, srcs = ir_num_srcs(inst->op);
+    if (srcs > 0 && inst->src1 == from) {
+        inst->src1 = to;
+        n++;
+    }
+    if (srcs > 1 && inst->src2 == from) {
+        inst->src2 = to;
+        n++;
+    }
+    return n;
+}
+
+static int make_copy(IRInst *inst, int src) {
+    inst->op = IR_COPY;
+    inst->src1 = src;
+    inst->src2 = -1;
+    return 1;
+}
+
+static int make_const(IRInst *inst, int value) {
+    inst->op = IR_LOAD_CONST;
+    inst->src1 = -1;
+    inst->value = value;
+    return 1;
+}
+
+// Later loads of var in the window read value instead.
+static int forward_var(Peephole *p, int i, int var, int value) {
+    IRList *list = p->list;
+    int n = 0;
+    for (int j = i + 1; j < list->count && j <= i + PEEPHOLE_WINDOW; j++) {
+        IRInst *inst = &list->insts[j];
+        if (window_closed(inst)) break;
+        if (inst->op == IR_LOAD_VAR && inst->var == var) {
+            inst->op = IR_COPY;
+            inst->src1 = value;
+            inst->src2 = -1;
+            n++;
+        } else if (inst->op == IR_STORE_VAR && inst->var == var) {
+            break;
+        }
+        if (defines(inst, value) || is_terminator(inst->op)) break;
+    }
+    return n;
+}
+
+static int forward_store(Peephole *p, int i) {
+    IRInst *inst = &p->list->insts[i];
+    if (inst->op != IR_STORE_VAR) return 0;
+    return forward_var(p, i, inst->var, inst->src1);
+}
+
+static int forward_load(Peephole *p, int i) {
+    IRInst *inst = &p->list->insts[i];
+    if (inst->op != IR_LOAD_VAR) return 0;
+    return forward_var(p, i, inst->var, inst->dest);
+}
+
+static int propagate_copy(Peephole *p, int i) {
+    IRList *list = p->list;
+    IRInst *copy = &list->insts[i];
+    if (copy->op != IR_COPY) return 0;
+    int dest = copy->dest, src = copy->src1;
+    if (dest == src) {
+        copy->op = IR_NOP;
+        copy->dest = copy->src1 = copy->src2 = -1;
+        return 1;
+    }
+    int n = 0;
+    for (int j = i + 1; j < list->count && j <= i + PEEPHOLE_WINDOW; j++) {
+        IRInst *inst = &list->insts[j];
+        if (window_closed(inst)) break;
+        n += replace_uses(inst, dest, src);
+        if (defines(inst, dest) || defines(inst, src) || is_terminator(inst->op)) break;
+    }
+    return n;
+}
+
+static int simplify_identity(Peephole *p, int i) {
+    IRInst *inst = &p->list->insts[i];
+    int a = 0, b = 0;
+    int ka = 0, kb = 0;
+    if (ir_is_binop(inst->op)) {
+        ka = const_of(p, inst->src1, &a);
+        kb = const_of(p, inst->src2, &b);
+    }
+    int same = ir_is_binop(inst->op) && inst->src1 == inst->src2;
+    switch (inst->op) {
+        case IR_ADD:
+            if (kb && b == 0) return make_copy(inst, inst->src1);
+            if (ka && a == 0) return make_copy(inst, inst->src2);
+            return 0;
+        case IR_SUB:
+            if (kb && b == 0) return make_copy(inst, inst->src1);
+            if (same) return make_const(inst, 0);
+            return 0;
+        case IR_MUL:
+            if ((ka && a == 0) || (kb && b == 0)) return make_const(inst, 0);
+            if (kb && b == 1) return make_copy(inst, inst->src1);
+            if (ka && a == 1) return make_copy(inst, inst->src2);
+            return 0;
+        case IR_DIV:
+            if (kb && b == 1) return make_copy(inst, inst->src1);
+            return 0;
+        case IR_MOD:
+            if (kb && (b == 1 || b == -1)) return make_const(inst, 0);
+            return 0;
+        case IR_EQ:
+        case IR_LE:
+        case IR_GE:
+            return same ? make_const(inst, 1) : 0;
+        case IR_NEQ:
+        case IR_LT:
+        case IR_GT:
+            return same ? make_const(inst, 0) : 0;
+        case IR_NEG:
+        case IR_BIT_NOT: {
+            // -(-x) and ~(~x)
+            IRInst *def = single_def(p, inst->src1);
+            if (!def || def->op != inst->op || p->defs[def->src1] != 1) return 0;
+            return make_copy(inst, def->src1);
+        }
+        default:
+            return 0;
+    }
+}
+
+static IROp invert_compare(IROp op) {
+    switch (op) {
+        case IR_EQ: return IR_NEQ;
+        case IR_NEQ: return IR_EQ;
+        case IR_LT: return IR_GE;
+        case IR_GE: return IR_LT;
+        case IR_GT: return IR_LE;
+        default: return IR_GT;      // IR_LE
+    }
+}
+
+// A temp that is zero exactly when temp is: x for "x != 0" and "!!x".
+static int truth_source(Peephole *p, int temp) {
+    IRInst *def = single_def(p, temp);
+    int k;
+    if (!def) return -1;
+    if (def->op == IR_NEQ && const_of(p, def->src2, &k) && k == 0 && p->defs[def->src1] == 1) return def->src1;
+    if (def->op == IR_NEQ && const_of(p, def->src1, &k) && k == 0 && p->defs[def->src2] == 1) return def->src2;
+    if (def->op == IR_LOG_NOT) {
+        IRInst *inner = single_def(p, def->src1);
+        if (inner && inner->op == IR_LOG_NOT && p->defs[inner->src1] == 1) return inner->src1;
+    }
+    return -1;
+}
+
+// Whether temp holds 0 or 1.
+static int is_boolean(Peephole *p, int temp) {
+    IRInst *def = single_def(p, temp);
+    return def && (is_compare(def->op) || def->op == IR_LOG_NOT || def->op == IR_AND || def->op == IR_OR);
+}
+
+static int simplify_compare(Peephole *p, int i) {
+    IRInst *inst = &p->list->insts[i];
+    int k;
+    if (inst->op == IR_JUMP_IF_FALSE) {
+        int source = truth_source(p, inst->src1);
+        return source >= 0 ? replace_uses(inst, inst->src1, source) : 0;
+    }
+    if (inst->op == IR_NEQ || inst->op == IR_EQ) {
+        // b != 0 is b itself for a boolean b; b == 0 is its negation.
+        int other = -1;
+        if (const_of(p, inst->src2, &k) && k == 0) other = inst->src1;
+        else if (const_of(p, inst->src1, &k) && k == 0) other = inst->src2;
+        if (other < 0 || !is_boolean(p, other)) return 0;
+        if (inst->op == IR_NEQ) return make_copy(inst, other);
+        inst->op = IR_LOG_NOT;
+        inst->src1 = other;
+        inst->src2 = -1;
+        return 1;
+    }
+    if (inst->op == IR_LOG_NOT) {
+        // !(a < b) becomes a >= b when a and b cannot change in between.
+        IRInst *def = single_def(p, inst->src1);
+        if (!def || !is_compare(def->op) || p->defs[def->src1] != 1 || p->defs[def->src2] != 1) return 0;
+        inst->op = invert_compare(def->op);
+        inst->src1 = def->src1;
+        inst->src2 = def->src2;
+        return 1;
+    }
+    return 0;
+}
+
+static const struct {
+    const char *name;
+    PeepholeFn apply;
+} rules[PEEP_NUM_RULES] = {
+    [PEEP_STORE_LOAD] = { "store-to-load", forward_store },
+    [PEEP_LOAD_LOAD] = { "load-to-load", forward_load },
+    [PEEP_COPY] = { "copy", propagate_copy },
+    [PEEP_IDENTITY] = { "identity", simplify_identity },
+    [PEEP_COMPARE] = { "compare", simplify_compare },
+};
+
+const char *peephole_rule_name(PeepholeRule rule) {
+    return rules[rule].name;
+}
+
+int ir_peephole(IRList *list, PeepholeStats *stats) {
+    Peephole p;
+    p.list = list;
+    p.defs = malloc((list->temp_count + 1) * sizeof(int));
+    p.def_inst = malloc((list->temp_count + 1) * sizeof(int));
+
+    int total = 0, changed;
+    do {
+        memset(p.defs, 0, (list->temp_count + 1) * sizeof(int));
+        for (int i = 0; i < list->count; i++) {
+            IRInst *inst = &list->insts[i];
+            if (ir_has_dest(inst->op) && inst->dest >= 0) {
+                p.defs[inst->dest]++;
+                p.def_inst[inst->dest] = i;
+            }
+        }
+        for (int t = 0; t < list->temp_count; t++) {
+            if (p.defs[t] != 1) p.def_inst[t] = -1;
+        }
+
+        changed = 0;
+        for (int i = 0; i < list->count; i++) {
+            for (int r = 0; r < PEEP_NUM_RULES; r++) {
+                int n = rules[r].apply(&p, i);
+                stats->rewrites[r] += n;
+                changed += n;
+            }
+        }
+        ir_remove_nops(list);
+        total += changed;
+    } while (changed);
+
+    free(p.defs);
+    free(p.def_inst);
+    return total;
+}
@@ -0,0 +1,25 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "ir.h"
+
+typedef enum {
+    PEEP_STORE_LOAD,    // store v, t ... load v  =>  copy t
+    PEEP_LOAD_LOAD,     // t = load v ... load v  =>  copy t
+    PEEP_COPY,          // d = copy s ... use d  =>  use s
+    PEEP_IDENTITY,      // x + 0, x * 1, x - x, ...  =>  copy x / constant
+    PEEP_COMPARE,       // jif (x != 0), !(a < b), ...  =>  jif x, a >= b
+    PEEP_NUM_RULES
+} PeepholeRule;
+
+typedef struct {
+    int rewrites[PEEP_NUM_RULES];
+} PeepholeStats;
+
+// Table-driven rewrites over short windows of one basic block, repeated
+// until none applies. Works before and after promotion; counts are added
+// to stats. Returns the number of rewrites.
+int ir_peephole(IRList *list, PeepholeStats *stats);
+const char *peephole_rule_name(PeepholeRule rule);
+
+#endif
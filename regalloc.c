@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "regalloc.h"
+#include "cfg.h"
+#include "liveness.h"
+
+typedef struct {
+    int temp;
+    int start;
+    int end;
+    double weight;      // spill cost: occurrences scaled by loop depth, per unit of length
+} Interval;
+
+static int compare_start(const void *a, const void *b) {
+    const Interval *x = a, *y = b;
+    if (x->start != y->start) return x->start - y->start;
+    return x->temp - y->temp;
+}
+
+static void touch(int *start, int *end, int t, int pos) {
+    if (start[t] < 0 || pos < start[t]) start[t] = pos;
+    if (pos > end[t]) end[t] = pos;
+}
+
+// Builds one conservative [start, end] range per temp: the hull of its
+// definitions, uses, and the blocks it is live into or out of.
+static Interval *build_intervals(IRList *list, int *count) {
+    CFG cfg;
+    Liveness lv;
+    cfg_build(&cfg, list);
+    liveness_build(&lv, list, &cfg);
+
+    int n = list->temp_count;
+    int *start = malloc((n + 1) * sizeof(int));
+    int *end = malloc((n + 1) * sizeof(int));
+    double *uses = calloc(n + 1, sizeof(double));
+    for (int t = 0; t < n; t++) start[t] = end[t] = -1;
+
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int depth = cfg_loop_depth(&cfg, cfg.inst_block[i]);
+        double scale = 1;
+        for (int d = 0; d < depth && d < 4; d++) scale *= 10;
+
+        int srcs = ir_num_srcs(inst->op);
+        int ops[2] = { inst->src1, inst->src2 };
+        for (int k = 0; k < srcs; k++) {
+            if (ops[k] < 0) continue;
+            touch(start, end, ops[k], i);
+            uses[ops[k]] += scale;
+        }
+        if (ir_has_dest(inst->op) && inst->dest >= 0) {
+            touch(start, end, inst->dest, i);
+            uses[inst->dest] += scale;
+        }
+    }
+
+    for (int b = 0; b < cfg.num_blocks; b++) {
+        const unsigned long *in = liveness_in_set(&lv, b), *out = liveness_out_set(&lv, b);
+        for (int g = liveness_next(&lv, in, 0); g >= 0; g = liveness_next(&lv, in, g + 1)) {
+            touch(start, end, lv.global_temp[g], cfg.blocks[b].start);
+        }
+        for (int g = liveness_next(&lv, out, 0); g >= 0; g = liveness_next(&lv, out, g + 1)) {
+            touch(start, end, lv.global_temp[g], cfg.blocks[b].end - 1);
+        }
+    }
+
+    Interval *intervals = malloc((n + 1) * sizeof(Interval));
+    int k = 0;
+    for (int t = 0; t < n; t++) {
+        if (start[t] < 0) continue;
+        intervals[k].temp = t;
+        intervals[k].start = start[t];
+        intervals[k].end = end[t];
+        intervals[k].weight = uses[t] / (end[t] - start[t] + 1);
+        k++;
+    }
+    *count = k;
+
+    free(start);
+    free(end);
+    free(uses);
+    liveness_free(&lv);
+    cfg_free(&cfg);
+    return intervals;
+}
+
+// Spilled intervals get stack slots by a second scan with unlimited slots,
+// so temps whose ranges do not overlap share a slot.
+static void assign_spill_slots(RegAlloc *ra, Interval *spilled, int count) {
+    int *slot_free_at = NULL;
+    int num_slots = 0;
+    for (int i = 0; i < count; i++) {
+        int slot = -1;
+        for (int s = 0; s < num_slots; s++) {
+            if (slot_free_at[s] < spilled[i].start) {
+                slot = s;
+                break;
+            }
+        }
+        if (slot < 0) {
+            slot = num_slots++;
+            slot_free_at = realloc(slot_free_at, num_slots * sizeof(int));
+        }
+        slot_free_at[slot] = spilled[i].end;
+        ra->spill_slot[spilled[i].temp] = slot;
+    }
+    ra->num_spill_slots = num_slots;
+    free(slot_free_at);
+}
+
+void regalloc_run(RegAlloc *ra, IRList *list, int num_regs) {
+    int n = list->temp_count;
+    ra->num_regs = num_regs;
+    ra->num_temps = n;
+    ra->reg = malloc((n + 1) * sizeof(int));
+    ra->spill_slot = malloc((n + 1) * sizeof(int));
+    ra->num_allocated = ra->num_spilled = ra->num_spill_slots = ra->max_pressure = 0;
+    for (int t = 0; t < n; t++) ra->reg[t] = ra->spill_slot[t] = -1;
+
+    int count;
+    Interval *intervals = build_intervals(list, &count);
+    qsort(intervals, count, sizeof(Interval), compare_start);
+
+    // active holds the intervals currently in registers, sorted by end.
+    Interval **active = malloc((num_regs + 1) * sizeof(Interval *));
+    int num_active = 0;
+    int *reg_free = malloc((num_regs + 1) * sizeof(int));
+    for (int r = 0; r < num_regs; r++) reg_free[r] = 1;
+    Interval *spilled = malloc((count + 1) * sizeof(Interval));
+    int num_spilled = 0;
+
+    for (int i = 0; i < count; i++) {
+        Interval *cur = &intervals[i];
+
+        int kept = 0;
+        for (int a = 0; a < num_active; a++) {
+            if (active[a]->end < cur->start) reg_free[ra->reg[active[a]->temp]] = 1;
+            else active[kept++] = active[a];
+        }
+        num_active = kept;
+        if (num_active + 1 > ra->max_pressure) ra->max_pressure = num_active + 1;
+
+        Interval *victim = NULL;
+        if (num_active == num_regs) {
+            // Evict the cheapest interval among the active ones and cur.
+            victim = cur;
+            for (int a = 0; a < num_active; a++) {
+                if (active[a]->weight < victim->weight) victim = active[a];
+            }
+            spilled[num_spilled++] = *victim;
+            if (victim == cur) continue;
+            reg_free[ra->reg[victim->temp]] = 1;
+            ra->reg[victim->temp] = -1;
+            kept = 0;
+            for (int a = 0; a < num_active; a++) {
+                if (active[a] != victim) active[kept++] = active[a];
+            }
+            num_active = kept;
+        }
+
+        int r = 0;
+        while (!reg_free[r]) r++;
+        reg_free[r] = 0;
+        ra->reg[cur->temp] = r;
+        int pos = num_active;
+        while (pos > 0 && active[pos - 1]->end > cur->end) {
+            active[pos] = active[pos - 1];
+            pos--;
+        }
+        active[pos] = cur;
+        num_active++;
+    }
+
+    qsort(spilled, num_spilled, sizeof(Interval), compare_start);
+    assign_spill_slots(ra, spilled, num_spilled);
+    for (int t = 0; t < n; t++) {
+        if (ra->reg[t] >= 0) ra->num_allocated++;
+    }
+    ra->num_spilled = num_spilled;
+
+    free(intervals);
+    free(active);
+    free(reg_free);
+    free(spilled);
+}
+
+void regalloc_print(RegAlloc *ra) {
+    printf("[RegAlloc] %d registers, %d temps in registers, %d spilled into %d slots, max pressure %d\n",
+           ra->num_regs, ra->num_allocated, ra->num_spilled, ra->num_spill_slots, ra->max_pressure);
+    for (int t = 0; t < ra->num_temps; t++) {
+        if (ra->reg[t] >= 0) printf("  t%d -> r%d\n", t, ra->reg[t]);
+        else if (ra->spill_slot[t] >= 0) printf("  t%d -> spill[%d]\n", t, ra->spill_slot[t]);
+    }
+}
+
+void regalloc_free(RegAlloc *ra) {
+    free(ra->reg);
+    free(ra->spill_slot);
+    ra->reg = ra->spill_slot = NULL;
+}
@@ -0,0 +1,23 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include "ir.h"
+
+// Linear-scan allocation of temps onto num_regs machine registers.
+// Temps that do not fit are given a stack spill slot instead.
+typedef struct {
+    int num_regs;
+    int num_temps;
+    int *reg;               // temp -> register index, -1 if spilled or unused
+    int *spill_slot;        // temp -> spill slot, -1 if in a register or unused
+    int num_spill_slots;
+    int num_allocated;      // temps kept in registers
+    int num_spilled;        // temps living in spill slots
+    int max_pressure;       // most intervals live at one point
+} RegAlloc;
+
+void regalloc_run(RegAlloc *ra, IRList *list, int num_regs);
+void regalloc_print(RegAlloc *ra);
+void regalloc_free(RegAlloc *ra);
+
+#endif
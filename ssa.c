@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ssa.h"
+
+typedef struct {
+    int *items;
+    int count;
+    int capacity;
+} IntVec;
+
+static void vec_push(IntVec *vec, int value) {
+    if (vec->count == vec->capacity) {
+        vec->capacity = vec->capacity ? vec->capacity * 2 : 4;
+        vec->items = realloc(vec->items, vec->capacity * sizeof(int));
+    }
+    vec->items[vec->count++] = value;
+}
+
+static int num_reachable_preds(CFG *cfg, int b) {
+    int n = 0;
+    for (int p = 0; p < cfg->blocks[b].num_preds; p++) {
+        if (cfg->blocks[cfg->blocks[b].preds[p]].rpo_index >= 0) n++;
+    }
+    return n;
+}
+
+// Index of the first non-label instruction of a block.
+static int block_body_start(IRList *list, CFG *cfg, int b) {
+    int start = cfg->blocks[b].start;
+    return list->insts[start].op == IR_LABEL ? start + 1 : start;
+}
+
+static void rebuild_cfg(CFG *cfg, IRList *list) {
+    cfg_free(cfg);
+    cfg_build(cfg, list);
+}
+
+// Dominance frontiers following Cooper, Harvey and Kennedy: walk up from
+// each predecessor of a join block until its immediate dominator.
+static IntVec *dominance_frontiers(CFG *cfg) {
+    IntVec *df = calloc(cfg->num_blocks, sizeof(IntVec));
+    for (int b = 0; b < cfg->num_blocks; b++) {
+        BasicBlock *bb = &cfg->blocks[b];
+        if (bb->rpo_index < 0 || bb->num_preds < 2) continue;
+        for (int p = 0; p < bb->num_preds; p++) {
+            int runner = bb->preds[p];
+            if (cfg->blocks[runner].rpo_index < 0) continue;
+            while (runner != bb->idom && runner >= 0) {
+                IntVec *set = &df[runner];
+                if (set->count == 0 || set->items[set->count - 1] != b) vec_push(set, b);
+                runner = cfg->blocks[runner].idom;
+            }
+        }
+    }
+    return df;
+}
+
+static void substitute(int *operand, const int *repl) {
+    if (*operand >= 0 && repl[*operand] != *operand) *operand = repl[*operand];
+}
+
+static int resolve(int *repl, int t) {
+    int root = t;
+    while (repl[root] != root) root = repl[root];
+    while (repl[t] != root) {
+        int next = repl[t];
+        repl[t] = root;
+        t = next;
+    }
+    return root;
+}
+
+// Folds the copies renaming produced for loads and stores, then drops phis
+// whose values never reach a real use.
+static void cleanup_ssa(IRList *list) {
+    int n = list->temp_count;
+    int *def_count = calloc(n + 1, sizeof(int));
+    int *repl = malloc((n + 1) * sizeof(int));
+    for (int t = 0; t < n; t++) repl[t] = t;
+
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (ir_has_dest(inst->op) && inst->dest >= 0) def_count[inst->dest]++;
+    }
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op == IR_COPY && def_count[inst->dest] == 1 && inst->src1 >= 0 && def_count[inst->src1] == 1) {
+            repl[inst->dest] = inst->src1;
+        }
+    }
+    for (int t = 0; t < n; t++) resolve(repl, t);
+
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op == IR_COPY && repl[inst->dest] != inst->dest) {
+            inst->op = IR_NOP;
+            continue;
+        }
+        int srcs = ir_num_srcs(inst->op);
+        if (srcs >= 1) substitute(&inst->src1, repl);
+        if (srcs >= 2) substitute(&inst->src2, repl);
+        if (inst->op == IR_PHI) {
+            for (int k = 0; k < inst->src2; k++) substitute(&list->phi_args[inst->src1 + k].temp, repl);
+        }
+    }
+
+    // Live phis are those reachable from a non-phi use through phi arguments.
+    unsigned char *live = calloc(n + 1, 1);
+    int *phi_of = malloc((n + 1) * sizeof(int));
+    int *work = malloc((n + 1) * sizeof(int));
+    int sp = 0;
+    for (int t = 0; t < n; t++) phi_of[t] = -1;
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        if (inst->op == IR_PHI) {
+            phi_of[inst->dest] = i;
+            continue;
+        }
+        int srcs = ir_num_srcs(inst->op);
+        int ops[2] = { inst->src1, inst->src2 };
+        for (int k = 0; k < srcs; k++) {
+            if (ops[k] >= 0 && !live[ops[k]]) {
+                live[ops[k]] = 1;
+                work[sp++] = ops[k];
+            }
+        }
+    }
+    while (sp > 0) {
+        int t = work[--sp];
+        if (phi_of[t] < 0) continue;
+        IRInst *phi = &list->insts[phi_of[t]];
+        for (int k = 0; k < phi->src2; k++) {
+            int arg = list->phi_args[phi->src1 + k].temp;
+            if (arg >= 0 && !live[arg]) {
+                live[arg] = 1;
+                work[sp++] = arg;
+            }
+        }
+    }
+    for (int i = 0; i < list->count; i++) {
+        if (list->insts[i].op == IR_PHI && !live[list->insts[i].dest]) list->insts[i].op = IR_NOP;
+    }
+
+    free(def_count);
+    free(repl);
+    free(live);
+    free(phi_of);
+    free(work);
+}
+
+int ssa_construct(IRList *list, CFG *cfg) {
+    int nb = cfg->num_blocks, nv = list->var_count;
+    if (nb <= 0 || nv <= 0) return 0;
+
+    // Blocks that store each variable, and which variables appear at all.
+    IntVec *def_blocks = calloc(nv, sizeof(IntVec));
+    unsigned char *promoted = calloc(nv, 1);
+    for (int b = 0; b < nb; b++) {
+        if (cfg->blocks[b].rpo_index < 0) continue;
+        for (int i = cfg->blocks[b].start; i < cfg->blocks[b].end; i++) {
+            IRInst *inst = &list->insts[i];
+            if (inst->op == IR_LOAD_VAR) promoted[inst->var] = 1;
+            if (inst->op != IR_STORE_VAR) continue;
+            promoted[inst->var] = 1;
+            IntVec *set = &def_blocks[inst->var];
+            if (set->count == 0 || set->items[set->count - 1] != b) vec_push(set, b);
+        }
+    }
+
+    // Phi placement on the iterated dominance frontier.
+    IntVec *df = dominance_frontiers(cfg);
+    int *has_phi = malloc((size_t)nb * sizeof(int));
+    int *queued = malloc((size_t)nb * sizeof(int));
+    int *work = malloc((size_t)nb * sizeof(int));
+    for (int b = 0; b < nb; b++) has_phi[b] = queued[b] = -1;
+    IntVec phi_blocks = { NULL, 0, 0 }, phi_vars = { NULL, 0, 0 };
+    for (int v = 0; v < nv; v++) {
+        int sp = 0;
+        for (int k = 0; k < def_blocks[v].count; k++) {
+            work[sp++] = def_blocks[v].items[k];
+            queued[def_blocks[v].items[k]] = v;
+        }
+        while (sp > 0) {
+            int b = work[--sp];
+            for (int k = 0; k < df[b].count; k++) {
+                int d = df[b].items[k];
+                if (has_phi[d] == v) continue;
+                has_phi[d] = v;
+                vec_push(&phi_blocks, d);
+                vec_push(&phi_vars, v);
+                if (queued[d] != v) {
+                    queued[d] = v;
+                    work[sp++] = d;
+                }
+            }
+        }
+    }
+
+    IRInsertion *phis = malloc((phi_blocks.count + 1) * sizeof(IRInsertion));
+    int *arg_var_base = malloc((phi_blocks.count + 1) * sizeof(int));
+    for (int k = 0; k < phi_blocks.count; k++) {
+        int b = phi_blocks.items[k];
+        int nargs = num_reachable_preds(cfg, b);
+        int first = ir_new_phi_args(list, nargs);
+        int j = 0;
+        for (int p = 0; p < cfg->blocks[b].num_preds; p++) {
+            int pred = cfg->blocks[b].preds[p];
+            if (cfg->blocks[pred].rpo_index < 0) continue;
+            list->phi_args[first + j].pred = pred;
+            list->phi_args[first + j].temp = -1;
+            j++;
+        }
+        phis[k].pos = block_body_start(list, cfg, b);
+        phis[k].inst.op = IR_PHI;
+        phis[k].inst.dest = list->temp_count++;
+        phis[k].inst.src1 = first;
+        phis[k].inst.src2 = nargs;
+        arg_var_base[k] = first;
+    }
+    int *arg_var = malloc((list->phi_arg_count + 1) * sizeof(int));
+    for (int k = 0; k < phi_blocks.count; k++) arg_var[arg_var_base[k]] = phi_vars.items[k];
+    ir_insert(list, phis, phi_blocks.count);
+    rebuild_cfg(cfg, list);
+
+    // Renaming walks the dominator tree keeping the current SSA temp of
+    // every variable; an undo log restores it when leaving a subtree.
+    int *cur = malloc((size_t)nv * sizeof(int));
+    int *init_temp = malloc((size_t)nv * sizeof(int));
+    unsigned char *init_used = calloc(nv, 1);
+    for (int v = 0; v < nv; v++) cur[v] = init_temp[v] = list->temp_count++;
+
+    int *first_child = malloc((size_t)nb * sizeof(int));
+    int *next_sibling = malloc((size_t)nb * sizeof(int));
+    for (int b = 0; b < nb; b++) first_child[b] = next_sibling[b] = -1;
+    for (int i = cfg->num_rpo - 1; i > 0; i--) {
+        int b = cfg->rpo[i];
+        next_sibling[b] = first_child[cfg->blocks[b].idom];
+        first_child[cfg->blocks[b].idom] = b;
+    }
+
+    IntVec undo_var = { NULL, 0, 0 }, undo_temp = { NULL, 0, 0 };
+    int *stack = malloc((size_t)nb * sizeof(int));
+    int *mark = malloc((size_t)nb * sizeof(int));
+    int sp = 0;
+    stack[sp++] = cfg->rpo[0];
+    int visiting = 1;
+    while (sp > 0) {
+        int b = stack[sp - 1];
+        if (visiting) {
+            mark[b] = undo_var.count;
+            BasicBlock *bb = &cfg->blocks[b];
+            for (int i = bb->start; i < bb->end; i++) {
+                IRInst *inst = &list->insts[i];
+                if (inst->op == IR_PHI) {
+                    int v = arg_var[inst->src1];
+                    vec_push(&undo_var, v);
+                    vec_push(&undo_temp, cur[v]);
+                    cur[v] = inst->dest;
+                } else if (inst->op == IR_LOAD_VAR) {
+                    int v = inst->var;
+                    if (cur[v] == init_temp[v]) init_used[v] = 1;
+                    inst->op = IR_COPY;
+                    inst->src1 = cur[v];
+                    inst->src2 = -1;
+                } else if (inst->op == IR_STORE_VAR) {
+                    int v = inst->var;
+                    vec_push(&undo_var, v);
+                    vec_push(&undo_temp, cur[v]);
+                    inst->op = IR_COPY;
+                    inst->dest = cur[v] = list->temp_count++;
+                    inst->src2 = -1;
+                }
+            }
+            for (int s = 0; s < bb->num_succs; s++) {
+                int succ = bb->succs[s];
+                for (int i = block_body_start(list, cfg, succ); i < cfg->blocks[succ].end && list->insts[i].op == IR_PHI; i++) {
+                    IRInst *phi = &list->insts[i];
+                    int v = arg_var[phi->src1];
+                    for (int k = 0; k < phi->src2; k++) {
+                        IRPhiArg *arg = &list->phi_args[phi->src1 + k];
+                        if (arg->pred != b) continue;
+                        arg->temp = cur[v];
+                        if (cur[v] == init_temp[v]) init_used[v] = 1;
+                    }
+                }
+            }
+        }
+        int child = first_child[b];
+        if (child >= 0) {
+            first_child[b] = next_sibling[child];
+            stack[sp++] = child;
+            visiting = 1;
+        } else {
+            while (undo_var.count > mark[b]) {
+                undo_var.count--;
+                undo_temp.count--;
+                cur[undo_var.items[undo_var.count]] = undo_temp.items[undo_temp.count];
+            }
+            sp--;
+            visiting = 0;
+        }
+    }
+
+    // Variables read before any store keep their incoming value, loaded once
+    // at entry.
+    IRInsertion *loads = malloc(nv * sizeof(IRInsertion));
+    int num_loads = 0, entry_pos = block_body_start(list, cfg, cfg->rpo[0]);
+    for (int v = 0; v < nv; v++) {
+        if (!init_used[v]) continue;
+        loads[num_loads].pos = entry_pos;
+        loads[num_loads].inst.op = IR_LOAD_VAR;
+        loads[num_loads].inst.dest = init_temp[v];
+        loads[num_loads].inst.src1 = -1;
+        loads[num_loads].inst.var = v;
+        num_loads++;
+    }
+    ir_insert(list, loads, num_loads);
+    cleanup_ssa(list);
+    rebuild_cfg(cfg, list);
+
+    int count = 0;
+    for (int v = 0; v < nv; v++) {
+        count += promoted[v];
+        free(def_blocks[v].items);
+    }
+    for (int b = 0; b < nb; b++) free(df[b].items);
+    free(def_blocks);
+    free(promoted);
+    free(df);
+    free(has_phi);
+    free(queued);
+    free(work);
+    free(phi_blocks.items);
+    free(phi_vars.items);
+    free(phis);
+    free(arg_var_base);
+    free(arg_var);
+    free(cur);
+    free(init_temp);
+    free(init_used);
+    free(first_child);
+    free(next_sibling);
+    free(undo_var.items);
+    free(undo_temp.items);
+    free(stack);
+    free(mark);
+    free(loads);
+    return count;
+}
+
+// Each phi t = phi(a1 from P1, ...) becomes "t' = a_i" at the end of every
+// P_i and "t = t'" in place of the phi. Going through a fresh t' keeps the
+// copies correct when phis of one block read each other (the swap problem)
+// and when a predecessor ends in a conditional branch.
+void ssa_destruct(IRList *list, CFG *cfg) {
+    int capacity = 64, count = 0;
+    IRInsertion *copies = malloc(capacity * sizeof(IRInsertion));
+
+    for (int i = 0; i < list->count; i++) {
+        IRInst *phi = &list->insts[i];
+        if (phi->op != IR_PHI) continue;
+        int staged = list->temp_count++;
+        for (int k = 0; k < phi->src2; k++) {
+            IRPhiArg *arg = &list->phi_args[phi->src1 + k];
+            if (arg->temp < 0) continue;
+            BasicBlock *pred = &cfg->blocks[arg->pred];
+            IROp last = list->insts[pred->end - 1].op;
+            if (count == capacity) {
+                capacity *= 2;
+                copies = realloc(copies, capacity * sizeof(IRInsertion));
+            }
+            copies[count].pos = (last == IR_JUMP || last == IR_JUMP_IF_FALSE) ? pred->end - 1 : pred->end;
+            copies[count].inst.op = IR_COPY;
+            copies[count].inst.dest = staged;
+            copies[count].inst.src1 = arg->temp;
+            copies[count].inst.src2 = -1;
+            count++;
+        }
+        phi->op = IR_COPY;
+        phi->src1 = staged;
+        phi->src2 = -1;
+    }
+
+    ir_insert(list, copies, count);
+    list->phi_arg_count = 0;
+    free(copies);
+    rebuild_cfg(cfg, list);
+}
+
+int ssa_enter(IRList *list, CFG *cfg) {
+    cfg_build(cfg, list);
+    if (cfg->num_blocks > 0 && cfg->blocks[0].num_preds > 0) {
+        // The entry needs its own block so the initial values have
+        // somewhere to come from when the first block is a loop header.
+        IRInsertion entry;
+        entry.pos = 0;
+        entry.inst.op = IR_LABEL;
+        entry.inst.dest = entry.inst.src1 = -1;
+        entry.inst.label = ir_new_label(list, "entry");
+        ir_insert(list, &entry, 1);
+        rebuild_cfg(cfg, list);
+    }
+    return ssa_construct(list, cfg);
+}
+
+void ssa_leave(IRList *list, CFG *cfg) {
+    ssa_destruct(list, cfg);
+    cfg_free(cfg);
+    ir_remove_nops(list);
+}
+
+int ir_mem2reg(IRList *list) {
+    CFG cfg;
+    int promoted = ssa_enter(list, &cfg);
+    ssa_leave(list, &cfg);
+    return promoted;
+}
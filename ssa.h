@@ -0,0 +1,25 @@
+#ifndef SSA_H
+#define SSA_H
+
+#include "ir.h"
+#include "cfg.h"
+
+// Promotes every variable into SSA temps, inserting phis at the iterated
+// dominance frontier of its stores. cfg must describe list and have an
+// entry block without predecessors; it is rebuilt to match the new layout.
+// Returns the number of promoted variables.
+int ssa_construct(IRList *list, CFG *cfg);
+
+// Lowers phis back to IR_COPY instructions at the end of each predecessor.
+void ssa_destruct(IRList *list, CFG *cfg);
+
+// Builds cfg for list and converts it to SSA form, giving the entry its own
+// block first when needed. Passes working on SSA temps run in between;
+// ssa_leave lowers the phis, frees cfg and drops the deleted instructions.
+int ssa_enter(IRList *list, CFG *cfg);
+void ssa_leave(IRList *list, CFG *cfg);
+
+// mem2reg: SSA construction followed by out-of-SSA lowering.
+int ir_mem2reg(IRList *list);
+
+#endif
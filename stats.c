@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#define STATS_MALLINFO 1
+#include <malloc.h>
+#else
+#define STATS_MALLINFO 0
+#endif
+
+static const char *phase_names[STAT_NUM_PHASES] = {
+    [STAT_LEX] = "lex",
+    [STAT_PARSE] = "parse",
+    [STAT_IRGEN] = "irgen",
+    [STAT_FOLD] = "fold",
+    [STAT_DCE] = "dce",
+    [STAT_LICM] = "licm",
+    [STAT_IVOPT] = "ivopt",
+    [STAT_UNROLL] = "unroll",
+    [STAT_PEEPHOLE] = "peephole",
+    [STAT_SSA] = "ssa",
+    [STAT_GVN] = "gvn",
+};
+
+const char *stats_phase_name(StatPhase phase) {
+    return phase_names[phase];
+}
+
+double stats_now_ms(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, now;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart * 1000.0 / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#endif
+}
+
+static double cpu_now_ms(void) {
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) / 1e4;     // 100 ns units
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+#endif
+}
+
+// Bytes the allocator has handed out and not had back.
+static long long heap_in_use(void) {
+#if STATS_MALLINFO
+    struct mallinfo2 info = mallinfo2();
+    return (long long)(info.uordblks + info.hblkhd);
+#else
+    return 0;
+#endif
+}
+
+// Lexing is timed per token from the parser, which only reads the wall
+// clock.
+static int sampled(const Stats *stats, StatPhase phase, int heap) {
+    return phase != STAT_LEX && (!heap || stats->heap_known);
+}
+
+void stats_init(Stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->heap_known = STATS_MALLINFO;
+    // The cheapest of a few back-to-back reads; a token's time would
+    // otherwise be mostly the clock's.
+    stats->clock_ms = 1.0;
+    for (int i = 0; i < 64; i++) {
+        double start = stats_now_ms(), read = stats_now_ms() - start;
+        if (read < stats->clock_ms) stats->clock_ms = read;
+    }
+}
+
+void stats_begin(Stats *stats, StatTimer *timer) {
+    if (!stats) return;
+    timer->heap_in_use = heap_in_use();
+    timer->cpu_ms = cpu_now_ms();
+    timer->wall_ms = stats_now_ms();
+}
+
+void stats_end(Stats *stats, StatPhase phase, const StatTimer *timer, long long rewrites) {
+    if (!stats) return;
+    double wall = stats_now_ms(), cpu = cpu_now_ms();
+    StatPhaseTotals *t = &stats->phases[phase];
+    t->calls++;
+    t->wall_ms += wall - timer->wall_ms;
+    t->cpu_ms += cpu - timer->cpu_ms;
+    t->net_heap_bytes += heap_in_use() - timer->heap_in_use;
+    t->rewrites += rewrites;
+}
+
+void stats_print(const Stats *stats, FILE *out) {
+    fprintf(out, "%-10s %6s %10s %10s %12s %9s\n", "phase", "calls", "wall ms", "cpu ms", "net heap", "rewrites");
+    double wall = 0, cpu = 0;
+    for (int p = 0; p < STAT_NUM_PHASES; p++) {
+        const StatPhaseTotals *t = &stats->phases[p];
+        if (t->calls == 0) continue;
+        fprintf(out, "%-10s %6d %10.3f ", phase_names[p], t->calls, t->wall_ms);
+        if (sampled(stats, p, 0)) fprintf(out, "%10.3f ", t->cpu_ms);
+        else fprintf(out, "%10s ", "-");
+        if (sampled(stats, p, 1)) fprintf(out, "%12lld ", t->net_heap_bytes);
+        else fprintf(out, "%12s ", "-");
+        fprintf(out, "%9lld\n", t->rewrites);
+        // Lexing happens inside parsing.
+        if (p != STAT_LEX) {
+            wall += t->wall_ms;
+            cpu += t->cpu_ms;
+        }
+    }
+    fprintf(out, "%-10s %6s %10.3f %10.3f\n", "total", "", wall, cpu);
+    fprintf(out, "tokens %lld, statements %d, AST nodes %lld (%lld bytes), atoms %d\n",
+            stats->tokens, stats->statements, stats->ast_nodes, stats->ast_bytes, stats->atoms);
+    fprintf(out, "IR %d instructions generated, %d after optimization; %d temps, %d variables, %d labels\n",
+            stats->ir_generated, stats->ir_optimized, stats->temps, stats->vars, stats->labels);
+    fprintf(out, "peephole");
+    for (int r = 0; r < PEEP_NUM_RULES; r++) {
+        fprintf(out, " %s %d%s", peephole_rule_name((PeepholeRule)r), stats->peephole_rules[r], r + 1 < PEEP_NUM_RULES ? "," : "\n");
+    }
+}
+
+void stats_print_json(const Stats *stats, FILE *out) {
+    fprintf(out, "{\n  \"phases\": {");
+    int first = 1;
+    for (int p = 0; p < STAT_NUM_PHASES; p++) {
+        const StatPhaseTotals *t = &stats->phases[p];
+        if (t->calls == 0) continue;
+        fprintf(out, "%s\n    \"%s\": { \"calls\": %d, \"wall_ms\": %.4f, ", first ? "" : ",", phase_names[p], t->calls, t->wall_ms);
+        if (sampled(stats, p, 0)) fprintf(out, "\"cpu_ms\": %.4f, ", t->cpu_ms);
+        else fprintf(out, "\"cpu_ms\": null, ");
+        if (sampled(stats, p, 1)) fprintf(out, "\"net_heap_bytes\": %lld, ", t->net_heap_bytes);
+        else fprintf(out, "\"net_heap_bytes\": null, ");
+        fprintf(out, "\"rewrites\": %lld }", t->rewrites);
+        first = 0;
+    }
+    fprintf(out, "\n  },\n");
+    fprintf(out, "  \"tokens\": %lld,\n  \"statements\": %d,\n  \"ast_nodes\": %lld,\n  \"ast_bytes\": %lld,\n  \"atoms\": %d,\n",
+            stats->tokens, stats->statements, stats->ast_nodes, stats->ast_bytes, stats->atoms);
+    fprintf(out, "  \"ir\": { \"generated\": %d, \"optimized\": %d, \"temps\": %d, \"vars\": %d, \"labels\": %d },\n",
+            stats->ir_generated, stats->ir_optimized, stats->temps, stats->vars, stats->labels);
+    fprintf(out, "  \"peephole\": {");
+    for (int r = 0; r < PEEP_NUM_RULES; r++) {
+        fprintf(out, " \"%s\": %d%s", peephole_rule_name((PeepholeRule)r), stats->peephole_rules[r], r + 1 < PEEP_NUM_RULES ? "," : " }\n");
+    }
+    fprintf(out, "}\n");
+}
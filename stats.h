@@ -0,0 +1,71 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "peephole.h"
+
+// Compile-time instrumentation behind --stats. Instrumented code is handed
+// a Stats pointer that is NULL unless stats were asked for, so with them
+// off a phase pays one branch.
+
+typedef enum {
+    STAT_LEX,           // lexer_next_token calls made by the parser
+    STAT_PARSE,         // parse_program, lexing included
+    STAT_IRGEN,         // ir_generate_program
+    STAT_FOLD,
+    STAT_DCE,
+    STAT_LICM,
+    STAT_IVOPT,
+    STAT_UNROLL,
+    STAT_PEEPHOLE,
+    STAT_SSA,           // promotion to SSA form and the way back
+    STAT_GVN,
+    STAT_NUM_PHASES
+} StatPhase;
+
+typedef struct {
+    int calls;
+    double wall_ms;
+    double cpu_ms;          // not sampled per token for STAT_LEX
+    // Heap in use at the end minus at the start, if heap_known: not the
+    // bytes allocated, since what the phase frees again does not show.
+    long long net_heap_bytes;
+    long long rewrites;     // instructions changed, removed or moved
+} StatPhaseTotals;
+
+typedef struct Stats {
+    StatPhaseTotals phases[STAT_NUM_PHASES];
+    int heap_known;                 // the allocator reports its use (glibc)
+    double clock_ms;                // one stats_now_ms read, taken off each token
+    long long tokens;
+    int statements;
+    long long ast_nodes;
+    long long ast_bytes;            // handed out by the AST arena
+    int atoms;
+    int ir_generated;               // instructions after lowering
+    int ir_optimized;               // and after the optimizer
+    int temps;
+    int vars;
+    int labels;
+    int peephole_rules[PEEP_NUM_RULES];
+} Stats;
+
+// Start of a phase, taken by stats_begin.
+typedef struct {
+    double wall_ms;
+    double cpu_ms;
+    long long heap_in_use;
+} StatTimer;
+
+void stats_init(Stats *stats);
+// Both do nothing when stats is NULL. stats_end adds the time since
+// stats_begin and the rewrites to phase.
+void stats_begin(Stats *stats, StatTimer *timer);
+void stats_end(Stats *stats, StatPhase phase, const StatTimer *timer, long long rewrites);
+// Monotonic wall clock in milliseconds.
+double stats_now_ms(void);
+const char *stats_phase_name(StatPhase phase);
+void stats_print(const Stats *stats, FILE *out);
+void stats_print_json(const Stats *stats, FILE *out);
+
+#endif
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "symtab.h"
+
+void symtab_init(SymbolTable *st, IRList *list, InternPool *atoms) {
+    st->list = list;
+    st->atoms = atoms;
+    st->innermost = NULL;
+    st->innermost_capacity = 0;
+    st->bindings = NULL;
+    st->num_bindings = st->binding_capacity = 0;
+    st->scope_log = NULL;
+    st->log_count = st->log_capacity = 0;
+    st->scope_marks = NULL;
+    st->depth = 0;
+    st->mark_capacity = 0;
+    st->rejected = -1;
+}
+
+// Innermost visible binding for atom, -1 if none.
+static int *innermost_entry(SymbolTable *st, Atom atom) {
+    if (atom >= st->innermost_capacity) {
+        int old = st->innermost_capacity;
+        st->innermost_capacity = atom_count(st->atoms) > atom ? atom_count(st->atoms) : atom + 1;
+        st->innermost = realloc(st->innermost, st->innermost_capacity * sizeof(int));
+        for (int a = old; a < st->innermost_capacity; a++) st->innermost[a] = -1;
+    }
+    return &st->innermost[atom];
+}
+
+static int add_binding(SymbolTable *st, Atom atom, int declared) {
+    if (st->num_bindings == st->binding_capacity) {
+        st->binding_capacity = st->binding_capacity ? st->binding_capacity * 2 : 16;
+        st->bindings = realloc(st->bindings, st->binding_capacity * sizeof(SymBinding));
+    }
+    int index = st->num_bindings++;
+    SymBinding *b = &st->bindings[index];
+
+    // Program-level variables keep their source name; nested declarations
+    // get a unique one (identifiers never contain '.').
+    const char *name = atom_name(st->atoms, atom);
+    if (st->depth == 0) {
+        b->slot = ir_var_id(st->list, name);
+    } else {
+        size_t len = strlen(name) + 16;
+        char *unique = malloc(len);
+        snprintf(unique, len, "%s.%d", name, index);
+        b->slot = ir_var_id(st->list, unique);
+        free(unique);
+    }
+    b->depth = st->depth;
+    b->declared = declared;
+    b->atom = atom;
+    int *entry = innermost_entry(st, atom);
+    b->shadowed = *entry;
+    *entry = index;
+    return index;
+}
+
+void symtab_push_scope(SymbolTable *st) {
+    if (st->depth == st->mark_capacity) {
+        st->mark_capacity = st->mark_capacity ? st->mark_capacity * 2 : 16;
+        st->scope_marks = realloc(st->scope_marks, st->mark_capacity * sizeof(int));
+    }
+    st->scope_marks[st->depth++] = st->log_count;
+}
+
+void symtab_pop_scope(SymbolTable *st) {
+    int mark = st->scope_marks[--st->depth];
+    while (st->log_count > mark) {
+        int index = st->scope_log[--st->log_count];
+        SymBinding *b = &st->bindings[index];
+        *innermost_entry(st, b->atom) = b->shadowed;
+    }
+}
+
+int symtab_declare(SymbolTable *st, Atom atom) {
+    int visible = *innermost_entry(st, atom);
+    if (visible >= 0) {
+        SymBinding *b = &st->bindings[visible];
+        if (b->depth == st->depth) {
+            st->rejected = atom;
+            return b->declared ? SYM_ERR_REDECLARED : SYM_ERR_USED_BEFORE_DECL;
+        }
+    }
+    int index = add_binding(st, atom, 1);
+    if (st->depth > 0) {
+        if (st->log_count == st->log_capacity) {
+            st->log_capacity = st->log_capacity ? st->log_capacity * 2 : 16;
+            st->scope_log = realloc(st->scope_log, st->log_capacity * sizeof(int));
+        }
+        st->scope_log[st->log_count++] = index;
+    }
+    return st->bindings[index].slot;
+}
+
+int symtab_resolve(SymbolTable *st, Atom atom) {
+    int visible = *innermost_entry(st, atom);
+    if (visible >= 0) return st->bindings[visible].slot;
+
+    // Never declared: an implicit program-level variable. It is bound at
+    // depth 0 below every open scope, so it is not logged for popping.
+    int saved_depth = st->depth;
+    st->depth = 0;
+    int index = add_binding(st, atom, 0);
+    st->depth = saved_depth;
+    return st->bindings[index].slot;
+}
+
+void symtab_free(SymbolTable *st) {
+    free(st->innermost);
+    st->innermost = NULL;
+    free(st->bindings);
+    free(st->scope_log);
+    free(st->scope_marks);
+    st->bindings = NULL;
+    st->scope_log = NULL;
+    st->scope_marks = NULL;
+    st->num_bindings = st->log_count = st->depth = 0;
+}
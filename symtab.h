@@ -0,0 +1,60 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include "ir.h"
+#include "intern.h"
+
+// Compile-time symbol table used during IR generation. Every variable
+// resolves to a dense IRList variable slot once, so executors index slots
+// directly and never look at names.
+//
+// Declarations (int x) are block scoped and may shadow outer variables;
+// each declaration gets its own slot. Names that are never declared are
+// implicit program-level variables, zero at start.
+
+typedef enum {
+    SYM_OK = 0,
+    SYM_ERR_REDECLARED = -1,        // declared twice in the same scope
+    SYM_ERR_USED_BEFORE_DECL = -2   // program-level declaration after an implicit use
+} SymStatus;
+
+typedef struct {
+    int slot;           // IRList variable id
+    int depth;          // scope depth, 0 for program level
+    int declared;       // 0 for implicit variables
+    int shadowed;       // binding this one hides, -1 if none
+    Atom atom;          // source name
+} SymBinding;
+
+typedef struct SymbolTable {
+    IRList *list;
+    InternPool *atoms;          // pool the atoms come from
+    int *innermost;             // atom -> innermost visible binding, -1 if none
+    int innermost_capacity;
+    SymBinding *bindings;
+    int num_bindings;
+    int binding_capacity;
+    int *scope_log;             // bindings declared in the open scopes, innermost last
+    int log_count;
+    int log_capacity;
+    int *scope_marks;           // scope_log length when each scope was opened
+    int depth;
+    int mark_capacity;
+    Atom rejected;              // name of the last declaration symtab_declare refused
+} SymbolTable;
+
+void symtab_init(SymbolTable *st, IRList *list, InternPool *atoms);
+void symtab_push_scope(SymbolTable *st);
+void symtab_pop_scope(SymbolTable *st);
+
+// Binds atom in the current scope to a fresh slot. Returns the slot, or a
+// negative SymStatus when the declaration is rejected.
+int symtab_declare(SymbolTable *st, Atom atom);
+
+// Returns the slot atom refers to, creating an implicit program-level
+// variable for names that were never declared.
+int symtab_resolve(SymbolTable *st, Atom atom);
+
+void symtab_free(SymbolTable *st);
+
+#endif
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "tier.h"
+
+#define END_BLOCK(cfg) ((cfg)->num_blocks)
+
+void tier_options_init(TierOptions *options) {
+    options->hot_threshold = TIER_DEFAULT_THRESHOLD;
+    options->osr_threshold = TIER_DEFAULT_OSR_THRESHOLD;
+}
+
+typedef struct {
+    TieredProgram *tp;
+    TierRegion *region;
+    unsigned char *in_loop;     // block -> 1 inside the region
+    unsigned char *defined;     // temp -> 1 if the region writes it
+    int *slot;                  // temp -> frame slot, -1 if none
+    int *exit_of;               // block (or END_BLOCK) -> exit code, -1 if none
+    int *exit_block;
+    int slot_capacity;
+    int exit_capacity;
+    int exit_slot_count;
+    int exit_slot_capacity;
+} RegionBuilder;
+
+static int slot_for(RegionBuilder *rb, int temp) {
+    TierRegion *r = rb->region;
+    if (rb->slot[temp] >= 0) return rb->slot[temp];
+    if (r->num_slots == rb->slot_capacity) {
+        rb->slot_capacity = rb->slot_capacity ? rb->slot_capacity * 2 : 16;
+        r->slot_temp = realloc(r->slot_temp, rb->slot_capacity * sizeof(int));
+    }
+    r->slot_temp[r->num_slots] = temp;
+    return rb->slot[temp] = r->num_slots++;
+}
+
+// Leaving for block b (or the end of the program) writes back the temps
+// the region changed that are still needed there.
+static void add_exit(RegionBuilder *rb, int b) {
+    TieredProgram *tp = rb->tp;
+    TierRegion *r = rb->region;
+    if (rb->exit_of[b] >= 0) return;
+    if (r->num_exits + 1 >= rb->exit_capacity) {
+        rb->exit_capacity = rb->exit_capacity ? rb->exit_capacity * 2 : 8;
+        r->exit_pc = realloc(r->exit_pc, rb->exit_capacity * sizeof(int));
+        r->exit_first = realloc(r->exit_first, rb->exit_capacity * sizeof(int));
+        rb->exit_block = realloc(rb->exit_block, rb->exit_capacity * sizeof(int));
+    }
+    int e = r->num_exits++;
+    rb->exit_of[b] = e;
+    rb->exit_block[e] = b;
+    r->exit_first[e] = rb->exit_slot_count;
+    r->exit_pc[e] = tp->inst_pc[b == END_BLOCK(&tp->cfg) ? tp->list->count : tp->cfg.blocks[b].start];
+    if (b == END_BLOCK(&tp->cfg)) {
+        r->exit_first[e + 1] = rb->exit_slot_count;
+        return;
+    }
+    const unsigned long *live = liveness_in_set(&tp->lv, b);
+    for (int g = liveness_next(&tp->lv, live, 0); g >= 0; g = liveness_next(&tp->lv, live, g + 1)) {
+        int t = tp->lv.global_temp[g];
+        if (!rb->defined[t]) continue;
+        if (rb->exit_slot_count == rb->exit_slot_capacity) {
+            rb->exit_slot_capacity = rb->exit_slot_capacity ? rb->exit_slot_capacity * 2 : 16;
+            r->exit_slots = realloc(r->exit_slots, rb->exit_slot_capacity * sizeof(int));
+        }
+        r->exit_slots[rb->exit_slot_count++] = slot_for(rb, t);
+    }
+    r->exit_first[e + 1] = rb->exit_slot_count;
+}
+
+static int falls_through(IRInst *last) {
+    return last->op != IR_JUMP && last->op != IR_RETURN;
+}
+
+static int map_label(IRList *sub, int *label_map, int label) {
+    if (label_map[label] < 0) label_map[label] = ir_new_label(sub, "tier");
+    return label_map[label];
+}
+
+static void append(IRList *sub, IROp op, int dest, int src1, int src2) {
+    IRInst inst = { op, dest, src1, { .src2 = src2 } };
+    ir_append(sub, inst);
+}
+
+// Builds the region as a standalone program over the frame layout of
+// TierRegion: load the live-in temps, run the loop blocks, and at each exit
+// store what the interpreter needs and return the exit code. A return
+// inside the loop stores its value and returns num_exits.
+static int compile_region(TieredProgram *tp, TierRegion *r) {
+    IRList *list = tp->list;
+    CFG *cfg = &tp->cfg;
+    Loop *loop = &cfg->loops[r->loop];
+    int nb = cfg->num_blocks, nv = list->var_count, n = list->temp_count;
+
+    RegionBuilder rb;
+    memset(&rb, 0, sizeof(rb));
+    rb.tp = tp;
+    rb.region = r;
+    rb.in_loop = calloc(nb + 1, 1);
+    rb.defined = calloc(n + 1, 1);
+    rb.slot = malloc((n + 1) * sizeof(int));
+    rb.exit_of = malloc((nb + 1) * sizeof(int));
+    for (int t = 0; t < n; t++) rb.slot[t] = -1;
+    for (int b = 0; b <= nb; b++) rb.exit_of[b] = -1;
+    for (int k = 0; k < loop->num_blocks; k++) {
+        BasicBlock *bb = &cfg->blocks[loop->blocks[k]];
+        rb.in_loop[loop->blocks[k]] = 1;
+        for (int i = bb->start; i < bb->end; i++) {
+            if (ir_has_dest(list->insts[i].op) && list->insts[i].dest >= 0) rb.defined[list->insts[i].dest] = 1;
+        }
+    }
+
+    const unsigned long *live = liveness_in_set(&tp->lv, loop->header);
+    for (int g = liveness_next(&tp->lv, live, 0); g >= 0; g = liveness_next(&tp->lv, live, g + 1)) {
+        slot_for(&rb, tp->lv.global_temp[g]);
+    }
+    r->num_live_in = r->num_slots;
+
+    for (int k = 0; k < loop->num_blocks; k++) {
+        int b = loop->blocks[k];
+        BasicBlock *bb = &cfg->blocks[b];
+        for (int i = bb->start; i < bb->end; i++) {
+            IRInst *inst = &list->insts[i];
+            if (inst->op != IR_JUMP && inst->op != IR_JUMP_IF_FALSE) continue;
+            int target = cfg->label_block[inst->label];
+            if (!rb.in_loop[target]) add_exit(&rb, target);
+        }
+        if (falls_through(&list->insts[bb->end - 1]) && (b + 1 == nb || !rb.in_loop[b + 1])) add_exit(&rb, b + 1);
+    }
+
+    IRList sub;
+    ir_list_init(&sub);
+    for (int v = 0; v < nv; v++) ir_var_id(&sub, ir_var_name(list, v));
+    char name[32];
+    for (int k = 0; k <= r->num_slots; k++) {
+        snprintf(name, sizeof(name), "$slot%d", k);
+        ir_var_id(&sub, name);
+    }
+    sub.temp_count = n;
+    int result_var = nv + r->num_slots;
+    int *label_map = malloc((list->label_count + 1) * sizeof(int));
+    for (int l = 0; l < list->label_count; l++) label_map[l] = -1;
+    int *stub = malloc((r->num_exits + 1) * sizeof(int));
+    for (int e = 0; e < r->num_exits; e++) stub[e] = ir_new_label(&sub, "tier_exit");
+
+    for (int k = 0; k < r->num_live_in; k++) append(&sub, IR_LOAD_VAR, r->slot_temp[k], -1, nv + k);
+    int header_label = list->insts[cfg->blocks[loop->header].start].label;
+    if (loop->blocks[0] != loop->header) append(&sub, IR_JUMP, -1, -1, map_label(&sub, label_map, header_label));
+    for (int k = 0; k < loop->num_blocks; k++) {
+        int b = loop->blocks[k];
+        BasicBlock *bb = &cfg->blocks[b];
+        for (int i = bb->start; i < bb->end; i++) {
+            IRInst inst = list->insts[i];
+            switch (inst.op) {
+                case IR_NOP:
+                    continue;
+                case IR_LABEL:
+                    inst.label = map_label(&sub, label_map, inst.label);
+                    break;
+                case IR_JUMP:
+                case IR_JUMP_IF_FALSE: {
+                    int target = cfg->label_block[inst.label];
+                    inst.label = rb.in_loop[target] ? map_label(&sub, label_map, inst.label) : stub[rb.exit_of[target]];
+                    break;
+                }
+                case IR_RETURN:
+                    append(&sub, IR_STORE_VAR, -1, inst.src1, result_var);
+                    inst.src1 = sub.temp_count++;
+                    append(&sub, IR_LOAD_CONST, inst.src1, -1, r->num_exits);
+                    break;
+                default:
+                    break;
+            }
+            ir_append(&sub, inst);
+        }
+        if (falls_through(&list->insts[bb->end - 1]) && (b + 1 == nb || !rb.in_loop[b + 1])) {
+            append(&sub, IR_JUMP, -1, -1, stub[rb.exit_of[b + 1]]);
+        }
+    }
+    for (int e = 0; e < r->num_exits; e++) {
+        append(&sub, IR_LABEL, -1, -1, stub[e]);
+        for (int k = r->exit_first[e]; k < r->exit_first[e + 1]; k++) {
+            int slot = r->exit_slots[k];
+            append(&sub, IR_STORE_VAR, -1, r->slot_temp[slot], nv + slot);
+        }
+        int code = sub.temp_count++;
+        append(&sub, IR_LOAD_CONST, code, -1, e);
+        append(&sub, IR_RETURN, -1, code, -1);
+    }
+
+    int ok = jit_compile(&r->native, &sub) == 0;
+    if (!ok) jit_free(&r->native);
+
+    ir_free(&sub);
+    free(label_map);
+    free(stub);
+    free(rb.in_loop);
+    free(rb.defined);
+    free(rb.slot);
+    free(rb.exit_of);
+    free(rb.exit_block);
+    return ok;
+}
+
+// VM loop hook: compiles the loop the first time it is found hot, then runs
+// it natively on every entry. From a back edge this is on-stack
+// replacement: the interpreter is about to start the header again, which
+// is exactly the state a region entry expects, so its live temps are
+// mapped into the frame slots and the rest of the loop runs natively.
+static int tier_enter(void *ctx, int loop, int back_edge, int *vars, int *regs, int *result, VMStatus *status) {
+    TieredProgram *tp = ctx;
+    TierRegion *r = &tp->regions[loop];
+    if (r->state == TIER_COLD) {
+        r->state = compile_region(tp, r) ? TIER_NATIVE : TIER_FAILED;
+        if (r->state == TIER_NATIVE) tp->stats.compiled++;
+        else tp->stats.failed++;
+    }
+    if (r->state != TIER_NATIVE) {
+        tp->vm.loop_counts[loop] = LLONG_MIN;
+        return VM_LOOP_STAY;
+    }
+
+    int nv = tp->list->var_count;
+    for (int k = 0; k < r->num_live_in; k++) vars[nv + k] = regs[r->slot_temp[k]];
+    int trap = JIT_OK;
+    int exit = r->native.entry(vars, &trap);
+    r->entries++;
+    tp->stats.native_entries++;
+    if (back_edge) tp->stats.osr_entries++;
+    if (trap == JIT_ERR_DIV_ZERO) {
+        *status = VM_ERR_DIV_ZERO;
+        return VM_LOOP_DONE;
+    }
+    if (exit == r->num_exits) {
+        *result = vars[nv + r->num_slots];
+        return VM_LOOP_DONE;
+    }
+    for (int k = r->exit_first[exit]; k < r->exit_first[exit + 1]; k++) {
+        int slot = r->exit_slots[k];
+        regs[r->slot_temp[slot]] = vars[nv + slot];
+    }
+    return r->exit_pc[exit];
+}
+
+void tier_compile(TieredProgram *tp, IRList *list, const TierOptions *options) {
+    memset(&tp->stats, 0, sizeof(tp->stats));
+    tp->list = list;
+    cfg_build(&tp->cfg, list);
+    liveness_build(&tp->lv, list, &tp->cfg);
+
+    // Loops whose header has a label to count at; back edges jumping to it
+    // skip the entry check.
+    int *header_loop = malloc((list->label_count + 1) * sizeof(int));
+    unsigned char *back_edge = calloc(list->count + 1, 1);
+    for (int l = 0; l < list->label_count; l++) header_loop[l] = -1;
+    tp->regions = calloc(tp->cfg.num_loops + 1, sizeof(TierRegion));
+    tp->num_regions = 0;
+    for (int l = 0; l < tp->cfg.num_loops; l++) {
+        Loop *loop = &tp->cfg.loops[l];
+        IRInst *first = &list->insts[tp->cfg.blocks[loop->header].start];
+        if (first->op != IR_LABEL || header_loop[first->label] >= 0) continue;
+        header_loop[first->label] = tp->num_regions;
+        tp->regions[tp->num_regions++].loop = l;
+        for (int k = 0; k < loop->num_latches; k++) {
+            int last = tp->cfg.blocks[loop->latches[k]].end - 1;
+            if (list->insts[last].op == IR_JUMP && list->insts[last].label == first->label) back_edge[last] = 1;
+        }
+    }
+
+    tp->inst_pc = malloc((list->count + 1) * sizeof(int));
+    VMLoopMarks marks = { header_loop, back_edge, tp->num_regions, tp->inst_pc };
+    vm_compile_marked(&tp->vm, list, &marks);
+    tp->vm.hot_threshold = options->hot_threshold;
+    tp->vm.osr_threshold = options->osr_threshold;
+    tp->vm.loop_hook = jit_available() ? tier_enter : NULL;
+    tp->vm.hook_ctx = tp;
+    // Room for the largest region's temps and its result slot.
+    tp->frame_size = list->var_count + tp->lv.num_globals + 1;
+
+    free(header_loop);
+    free(back_edge);
+}
+
+VMStatus tier_run(TieredProgram *tp, int *vars, int *result) {
+    int nv = tp->list->var_count;
+    int *frame = calloc(tp->frame_size, sizeof(int));
+    memcpy(frame, vars, nv * sizeof(int));
+    VMStatus status = vm_run(&tp->vm, frame, result);
+    memcpy(vars, frame, nv * sizeof(int));
+    free(frame);
+    return status;
+}
+
+void tier_free(TieredProgram *tp) {
+    for (int k = 0; k < tp->num_regions; k++) {
+        TierRegion *r = &tp->regions[k];
+        if (r->state == TIER_NATIVE) jit_free(&r->native);
+        free(r->slot_temp);
+        free(r->exit_pc);
+        free(r->exit_slots);
+        free(r->exit_first);
+    }
+    free(tp->regions);
+    free(tp->inst_pc);
+    vm_free(&tp->vm);
+    liveness_free(&tp->lv);
+    cfg_free(&tp->cfg);
+    tp->regions = NULL;
+    tp->num_regions = 0;
+}
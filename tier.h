@@ -0,0 +1,71 @@
+#ifndef TIER_H
+#define TIER_H
+
+#include "ir.h"
+#include "cfg.h"
+#include "liveness.h"
+#include "vm.h"
+#include "jit.h"
+
+// Header executions (entries plus iterations) after which a loop is
+// compiled to native code on its next entry.
+#define TIER_DEFAULT_THRESHOLD 1000
+// Header executions after which a loop still running in the interpreter is
+// compiled and entered at its next back edge (on-stack replacement).
+#define TIER_DEFAULT_OSR_THRESHOLD 10000
+
+typedef struct {
+    long long hot_threshold;
+    long long osr_threshold;
+} TierOptions;
+
+typedef enum {
+    TIER_COLD,          // interpreted
+    TIER_NATIVE,        // entries run the compiled region
+    TIER_FAILED         // could not be compiled, stays interpreted
+} TierState;
+
+// One natural loop as a native function over the interpreter's frame:
+// variables first, then the temps crossing the region boundary, then the
+// slot a return inside the loop leaves the program result in.
+typedef struct {
+    int loop;               // index into cfg.loops
+    TierState state;
+    JitProgram native;
+    int *slot_temp;         // frame slot num_vars + k holds slot_temp[k]
+    int num_slots;
+    int num_live_in;        // slots [0, num_live_in) are loaded on entry
+    int *exit_pc;           // exit code -> pc the interpreter resumes at
+    int *exit_slots;        // slots written back by each exit, in exit_first ranges
+    int *exit_first;
+    int num_exits;
+    long long entries;      // native runs, including on-stack replacements
+} TierRegion;
+
+typedef struct {
+    int compiled;
+    int failed;
+    long long native_entries;
+    long long osr_entries;      // native entries made from a back edge
+} TierStats;
+
+// Interprets the program, compiling each loop once it gets hot; see
+// tier_run. list must outlive the tiered program.
+typedef struct {
+    IRList *list;
+    CFG cfg;
+    Liveness lv;
+    VMProgram vm;
+    TierRegion *regions;
+    int num_regions;
+    int *inst_pc;
+    int frame_size;
+    TierStats stats;
+} TieredProgram;
+
+void tier_options_init(TierOptions *options);
+void tier_compile(TieredProgram *tp, IRList *list, const TierOptions *options);
+VMStatus tier_run(TieredProgram *tp, int *vars, int *result);
+void tier_free(TieredProgram *tp);
+
+#endif
@@ -0,0 +1,215 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "unroll.h"
+#include "cfg.h"
+#include "ivopt.h"
+
+// Flattening a long loop only trades the branch for code size.
+#define UNROLL_MAX_TRIPS 32
+
+typedef struct {
+    IRList *list;
+    int *temp_map;          // temp -> copy in the current body clone
+    int *temp_stamp;
+    int *label_map;
+    int *label_stamp;
+    int stamp;
+    IRInsertion *insertions;
+    int num_insertions;
+    int insertion_capacity;
+} UnrollState;
+
+static void add_insertion(UnrollState *s, int pos, IRInst inst) {
+    if (s->num_insertions == s->insertion_capacity) {
+        s->insertion_capacity = s->insertion_capacity ? s->insertion_capacity * 2 : 64;
+        s->insertions = realloc(s->insertions, s->insertion_capacity * sizeof(IRInsertion));
+    }
+    s->insertions[s->num_insertions].pos = pos;
+    s->insertions[s->num_insertions].inst = inst;
+    s->num_insertions++;
+}
+
+// Queues an instruction before pos; returns its fresh dest temp, if any.
+static int emit(UnrollState *s, int pos, IROp op, int src1, int src2) {
+    IRInst inst = { op, -1, src1, { .src2 = src2 } };
+    if (ir_has_dest(op)) inst.dest = s->list->temp_count++;
+    add_insertion(s, pos, inst);
+    return inst.dest;
+}
+
+static int map_temp(UnrollState *s, int temp) {
+    return temp >= 0 && s->temp_stamp[temp] == s->stamp ? s->temp_map[temp] : temp;
+}
+
+static int map_label(UnrollState *s, int label) {
+    if (s->label_stamp[label] != s->stamp) {
+        s->label_stamp[label] = s->stamp;
+        s->label_map[label] = ir_new_label(s->list, "unroll");
+    }
+    return s->label_map[label];
+}
+
+// Queues one copy of insts[from, to) before pos with fresh temps and labels.
+static void copy_body(UnrollState *s, int pos, int from, int to) {
+    s->stamp++;
+    for (int i = from; i < to; i++) {
+        IRInst inst = s->list->insts[i];
+        if (inst.op == IR_NOP) continue;
+        if (inst.op == IR_LABEL || inst.op == IR_JUMP || inst.op == IR_JUMP_IF_FALSE) {
+            inst.label = map_label(s, inst.label);
+        }
+        int srcs = ir_num_srcs(inst.op);
+        if (srcs > 0) inst.src1 = map_temp(s, inst.src1);
+        if (srcs > 1) inst.src2 = map_temp(s, inst.src2);
+        if (ir_has_dest(inst.op) && inst.dest >= 0) {
+            s->temp_stamp[inst.dest] = s->stamp;
+            s->temp_map[inst.dest] = s->list->temp_count++;
+            inst.dest = s->temp_map[inst.dest];
+        }
+        add_insertion(s, pos, inst);
+    }
+}
+
+static int is_pure(IRList *list, const int *const_def, IRInst *inst) {
+    if (inst->op == IR_DIV || inst->op == IR_MOD) {
+        return const_def[inst->src2] >= 0 && list->insts[const_def[inst->src2]].value != 0;
+    }
+    return ir_is_binop(inst->op) || ir_is_unop(inst->op) || inst->op == IR_COPY ||
+           inst->op == IR_LOAD_CONST || inst->op == IR_LOAD_VAR;
+}
+
+// Instructions the body adds per copy, or -1 when the loop's shape does not
+// allow copying: its blocks must follow the header contiguously, the last
+// one being the only latch, and the header must only compute the test.
+static int body_size(IRList *list, CFG *cfg, const int *const_def, int l) {
+    Loop *loop = &cfg->loops[l];
+    for (int k = 0; k < loop->num_blocks; k++) {
+        if (loop->blocks[k] != loop->header + k) return -1;
+    }
+    BasicBlock *header = &cfg->blocks[loop->header];
+    BasicBlock *last = &cfg->blocks[loop->header + loop->num_blocks - 1];
+    IRInst *back = &list->insts[last->end - 1];
+    if (loop->num_blocks < 2 || loop->num_latches != 1 || back->op != IR_JUMP ||
+        back->label != list->insts[header->start].label) return -1;
+    for (int i = header->start + 1; i < header->end - 1; i++) {
+        if (!is_pure(list, const_def, &list->insts[i])) return -1;
+    }
+    int size = 0;
+    for (int i = header->end; i < last->end - 1; i++) {
+        if (list->insts[i].op != IR_LABEL) size++;
+    }
+    return size;
+}
+
+// Main loop running factor iterations per test while var stays far enough
+// from the bound that none of them can cross it, then the original loop:
+//     [if (bound near the int limit) goto rest]
+//     limit = bound -/+ (factor - 1) * |step|
+//   main:
+//     if (!(var <cmp> limit)) goto rest
+//     body x factor
+//     goto main
+//   rest:
+//     original loop
+static int unroll_partial(UnrollState *s, CFG *cfg, const int *const_def, CountedLoop *c, int l, int factor) {
+    IRList *list = s->list;
+    Loop *loop = &cfg->loops[l];
+    int up = (c->cmp == IR_LT || c->cmp == IR_LE) && c->step > 0;
+    int down = (c->cmp == IR_GT || c->cmp == IR_GE) && c->step < 0;
+    if (!up && !down) return 0;
+    long long gap = (long long)(factor - 1) * (up ? c->step : -(long long)c->step);
+    if (gap > INT_MAX / 2) return 0;
+    long long safe = up ? (long long)INT_MIN + gap : (long long)INT_MAX - gap;
+
+    BasicBlock *header = &cfg->blocks[loop->header];
+    BasicBlock *last = &cfg->blocks[loop->header + loop->num_blocks - 1];
+    int pos = header->start;
+    int bound = c->bound_temp;
+    int def = const_def[bound];
+    int constant = def >= 0;
+    if (constant && (up ? list->insts[def].value < safe : list->insts[def].value > safe)) return 0;
+
+    int main_label = ir_new_label(list, "unroll_main");
+    int rest_label = ir_new_label(list, "unroll_rest");
+    int limit;
+    if (constant) {
+        long long value = list->insts[def].value;
+        limit = emit(s, pos, IR_LOAD_CONST, -1, (int)(up ? value - gap : value + gap));
+    } else {
+        int fits = emit(s, pos, up ? IR_GE : IR_LE, bound, emit(s, pos, IR_LOAD_CONST, -1, (int)safe));
+        emit(s, pos, IR_JUMP_IF_FALSE, fits, rest_label);
+        limit = emit(s, pos, up ? IR_SUB : IR_ADD, bound, emit(s, pos, IR_LOAD_CONST, -1, (int)gap));
+    }
+    emit(s, pos, IR_LABEL, -1, main_label);
+    int cond = emit(s, pos, (IROp)c->cmp, emit(s, pos, IR_LOAD_VAR, -1, c->var), limit);
+    emit(s, pos, IR_JUMP_IF_FALSE, cond, rest_label);
+    for (int k = 0; k < factor; k++) copy_body(s, pos, header->end, last->end - 1);
+    emit(s, pos, IR_JUMP, -1, main_label);
+    emit(s, pos, IR_LABEL, -1, rest_label);
+    return 1;
+}
+
+void ir_unroll_loops(IRList *list, int factor, int budget, UnrollStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    CFG cfg;
+    cfg_build(&cfg, list);
+    if (cfg.num_loops == 0) {
+        cfg_free(&cfg);
+        return;
+    }
+
+    // Only innermost loops are unrolled, so only they are analysed.
+    unsigned char *has_inner = calloc(cfg.num_loops, 1);
+    for (int l = 0; l < cfg.num_loops; l++) {
+        if (cfg.loops[l].parent >= 0) has_inner[cfg.loops[l].parent] = 1;
+    }
+    int *def_inst = iv_find_defs(list);
+    CountedLoop counted;
+    int *const_def = malloc((list->temp_count + 1) * sizeof(int));
+    for (int t = 0; t < list->temp_count; t++) const_def[t] = -1;
+    for (int i = 0; i < list->count; i++) {
+        if (list->insts[i].op == IR_LOAD_CONST) const_def[list->insts[i].dest] = i;
+    }
+
+    UnrollState s;
+    memset(&s, 0, sizeof(s));
+    s.list = list;
+    s.temp_map = malloc((list->temp_count + 1) * sizeof(int));
+    s.temp_stamp = calloc(list->temp_count + 1, sizeof(int));
+    s.label_map = malloc((list->label_count + 1) * sizeof(int));
+    s.label_stamp = calloc(list->label_count + 1, sizeof(int));
+
+    for (int l = 0; l < cfg.num_loops; l++) {
+        if (has_inner[l]) continue;
+        CountedLoop *c = &counted;
+        iv_find_counted(list, &cfg, def_inst, l, c);
+        if (c->var < 0 || iv_preheader_block(list, &cfg, l) < 0) continue;
+        int size = body_size(list, &cfg, const_def, l);
+        if (size < 0) continue;
+        Loop *loop = &cfg.loops[l];
+        BasicBlock *header = &cfg.blocks[loop->header];
+        BasicBlock *last = &cfg.blocks[loop->header + loop->num_blocks - 1];
+
+        if (c->trips >= 0 && c->trips <= UNROLL_MAX_TRIPS && c->trips * size <= budget) {
+            // The header test is known to pass exactly trips times.
+            for (long long k = 0; k < c->trips; k++) copy_body(&s, header->start, header->end, last->end - 1);
+            emit(&s, header->start, IR_JUMP, -1, c->exit_label);
+            stats->full++;
+        } else if (factor > 1 && (long long)size * factor <= budget &&
+                   unroll_partial(&s, &cfg, const_def, c, l, factor)) {
+            stats->partial++;
+        }
+    }
+
+    ir_insert(list, s.insertions, s.num_insertions);
+    free(s.temp_map);
+    free(s.temp_stamp);
+    free(s.label_map);
+    free(s.label_stamp);
+    free(s.insertions);
+    free(const_def);
+    free(has_inner);
+    free(def_inst);
+    cfg_free(&cfg);
+}
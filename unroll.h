@@ -0,0 +1,21 @@
+#ifndef UNROLL_H
+#define UNROLL_H
+
+#include "ir.h"
+
+#define UNROLL_DEFAULT_FACTOR 4
+#define UNROLL_DEFAULT_BUDGET 96
+
+typedef struct {
+    int full;           // loops replaced by straight-line copies of the body
+    int partial;        // loops given an unrolled main loop and a remainder
+} UnrollStats;
+
+// Unrolls innermost loops whose header tests an induction variable (see
+// ivopt.h) over memory-form IR. A loop with a constant trip count is
+// flattened when all of its copies fit in budget instructions; otherwise,
+// when factor copies of the body fit, a main loop runs factor iterations
+// per header test while the original loop is kept to finish the rest.
+void ir_unroll_loops(IRList *list, int factor, int budget, UnrollStats *stats);
+
+#endif
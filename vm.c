@@ -0,0 +1,348 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#else
+#define VM_THREADED 0
+#endif
+
+static VMOp vm_op_for(IROp op) {
+    switch (op) {
+        case IR_LOAD_CONST: return VM_LOAD_CONST;
+        case IR_LOAD_VAR: return VM_LOAD_VAR;
+        case IR_STORE_VAR: return VM_STORE_VAR;
+        case IR_ADD: return VM_ADD;
+        case IR_SUB: return VM_SUB;
+        case IR_MUL: return VM_MUL;
+        case IR_DIV: return VM_DIV;
+        case IR_MOD: return VM_MOD;
+        case IR_NEG: return VM_NEG;
+        case IR_LOG_NOT: return VM_LOG_NOT;
+        case IR_BIT_NOT: return VM_BIT_NOT;
+        case IR_EQ: return VM_EQ;
+        case IR_NEQ: return VM_NEQ;
+        case IR_LT: return VM_LT;
+        case IR_GT: return VM_GT;
+        case IR_LE: return VM_LE;
+        case IR_GE: return VM_GE;
+        case IR_AND: return VM_AND;
+        case IR_OR: return VM_OR;
+        case IR_JUMP: return VM_JUMP;
+        case IR_JUMP_IF_FALSE: return VM_JUMP_IF_FALSE;
+        case IR_RETURN: return VM_RETURN;
+        case IR_COPY: return VM_COPY;
+        default:
+            fprintf(stderr, "VM: cannot lower IR op %d\n", op);
+            exit(1);
+    }
+}
+
+// Arithmetic wraps like the hardware does instead of invoking C overflow UB.
+static inline int vm_wrap_add(int a, int b) { return (int)((unsigned)a + (unsigned)b); }
+static inline int vm_wrap_sub(int a, int b) { return (int)((unsigned)a - (unsigned)b); }
+static inline int vm_wrap_mul(int a, int b) { return (int)((unsigned)a * (unsigned)b); }
+static inline int vm_div(int a, int b) { return b == -1 ? vm_wrap_sub(0, a) : a / b; }
+static inline int vm_mod(int a, int b) { return b == -1 ? 0 : a % b; }
+
+static VMStatus vm_exec(const VMProgram *prog, int *vars, int *result, const void *const **table_out);
+
+static int vm_header_loop(const VMLoopMarks *marks, IRInst *inst) {
+    return marks && inst->op == IR_LABEL ? marks->header_loop[inst->label] : -1;
+}
+
+void vm_compile(VMProgram *prog, IRList *list) {
+    vm_compile_marked(prog, list, NULL);
+}
+
+void vm_compile_marked(VMProgram *prog, IRList *list, const VMLoopMarks *marks) {
+    int *label_pos = malloc((list->label_count + 1) * sizeof(int));
+    for (int i = 0; i < list->label_count; i++) label_pos[i] = -1;
+
+    // Marked loop headers keep their label as a VM_LOOP_ENTRY instruction.
+    int count = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (marks && marks->inst_pc) marks->inst_pc[i] = count;
+        if (list->insts[i].op == IR_LABEL) {
+            label_pos[list->insts[i].label] = count;
+            if (vm_header_loop(marks, &list->insts[i]) >= 0) count++;
+        } else if (list->insts[i].op != IR_NOP) {
+            count++;
+        }
+    }
+    if (marks && marks->inst_pc) marks->inst_pc[list->count] = count;
+
+    prog->code = malloc((count + 1) * sizeof(VMInst));
+    prog->count = count + 1;
+    prog->num_regs = list->temp_count > 0 ? list->temp_count : 1;
+    prog->num_vars = list->var_count;
+    prog->var_names = malloc((list->var_count + 1) * sizeof(char *));
+    for (int i = 0; i < list->var_count; i++) prog->var_names[i] = strdup(ir_var_name(list, i));
+    prog->num_loops = marks ? marks->num_loops : 0;
+    prog->loop_counts = calloc(prog->num_loops + 1, sizeof(long long));
+    prog->hot_threshold = 0;
+    prog->osr_threshold = 0;
+    prog->loop_hook = NULL;
+    prog->hook_ctx = NULL;
+
+    VMInst *out = prog->code;
+    for (int i = 0; i < list->count; i++) {
+        IRInst *inst = &list->insts[i];
+        int loop = vm_header_loop(marks, inst);
+        if (loop >= 0) {
+            out->op = VM_LOOP_ENTRY;
+            out->dest = out->b = 0;
+            out->a = loop;
+            out++;
+            continue;
+        }
+        if (inst->op == IR_LABEL || inst->op == IR_NOP) continue;
+        out->op = vm_op_for(inst->op);
+        out->dest = inst->dest;
+        out->a = inst->src1;
+        out->b = inst->src2;
+
+        switch (inst->op) {
+            case IR_LOAD_CONST:
+                out->a = inst->value;
+                break;
+            case IR_LOAD_VAR:
+                out->a = inst->var;
+                break;
+            case IR_JUMP:
+            case IR_JUMP_IF_FALSE: {
+                int target = label_pos[inst->label];
+                if (target < 0) {
+                    fprintf(stderr, "VM: jump to undefined label %s\n", ir_label_name(list, inst->label));
+                    exit(1);
+                }
+                if (inst->op == IR_JUMP_IF_FALSE) {
+                    out->b = target;
+                } else if (marks && marks->back_edge[i]) {
+                    out->op = VM_LOOP_BACK;
+                    out->a = target + 1;
+                    out->b = marks->header_loop[inst->label];
+                } else {
+                    out->a = target;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+        out++;
+    }
+    // Falling off the end of the program returns 0.
+    out->op = VM_HALT;
+    out->dest = out->a = out->b = 0;
+
+    const void *const *table = NULL;
+    vm_exec(NULL, NULL, NULL, &table);
+    for (int i = 0; i < prog->count; i++) {
+        prog->code[i].handler = table ? table[prog->code[i].op] : NULL;
+    }
+
+    free(label_pos);
+}
+
+int vm_var_slot(VMProgram *prog, const char *name) {
+    for (int i = 0; i < prog->num_vars; i++) {
+        if (strcmp(prog->var_names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+// Threaded interpreter. Called with table_out set (and no program) it only
+// reports the handler addresses so vm_compile can pre-resolve them.
+static VMStatus vm_exec(const VMProgram *prog, int *vars, int *result, const void *const **table_out) {
+#if VM_THREADED
+    static const void *const handlers[VM_OP_COUNT] = {
+        [VM_LOAD_CONST] = &&op_load_const,
+        [VM_LOAD_VAR] = &&op_load_var,
+        [VM_STORE_VAR] = &&op_store_var,
+        [VM_ADD] = &&op_add,
+        [VM_SUB] = &&op_sub,
+        [VM_MUL] = &&op_mul,
+        [VM_DIV] = &&op_div,
+        [VM_MOD] = &&op_mod,
+        [VM_NEG] = &&op_neg,
+        [VM_LOG_NOT] = &&op_log_not,
+        [VM_BIT_NOT] = &&op_bit_not,
+        [VM_EQ] = &&op_eq,
+        [VM_NEQ] = &&op_neq,
+        [VM_LT] = &&op_lt,
+        [VM_GT] = &&op_gt,
+        [VM_LE] = &&op_le,
+        [VM_GE] = &&op_ge,
+        [VM_AND] = &&op_and,
+        [VM_OR] = &&op_or,
+        [VM_JUMP] = &&op_jump,
+        [VM_JUMP_IF_FALSE] = &&op_jump_if_false,
+        [VM_RETURN] = &&op_return,
+        [VM_COPY] = &&op_copy,
+        [VM_LOOP_ENTRY] = &&op_loop_entry,
+        [VM_LOOP_BACK] = &&op_loop_back,
+        [VM_HALT] = &&op_halt,
+    };
+    if (table_out) {
+        *table_out = handlers;
+        return VM_OK;
+    }
+
+    VMStatus status = VM_OK;
+    int *r = malloc(prog->num_regs * sizeof(int));
+    const VMInst *code = prog->code;
+    const VMInst *pc = code;
+
+#define DISPATCH() goto *pc->handler
+#define NEXT() do { pc++; DISPATCH(); } while (0)
+#define BINOP(expr) do { int x = r[pc->a], y = r[pc->b]; (void)x; (void)y; r[pc->dest] = (expr); NEXT(); } while (0)
+
+    DISPATCH();
+
+op_load_const: r[pc->dest] = pc->a; NEXT();
+op_load_var: r[pc->dest] = vars[pc->a]; NEXT();
+op_store_var: vars[pc->b] = r[pc->a]; NEXT();
+op_add: BINOP(vm_wrap_add(x, y));
+op_sub: BINOP(vm_wrap_sub(x, y));
+op_mul: BINOP(vm_wrap_mul(x, y));
+op_div:
+    if (r[pc->b] == 0) { status = VM_ERR_DIV_ZERO; goto done; }
+    BINOP(vm_div(x, y));
+op_mod:
+    if (r[pc->b] == 0) { status = VM_ERR_DIV_ZERO; goto done; }
+    BINOP(vm_mod(x, y));
+op_copy: r[pc->dest] = r[pc->a]; NEXT();
+op_neg: r[pc->dest] = vm_wrap_sub(0, r[pc->a]); NEXT();
+op_log_not: r[pc->dest] = !r[pc->a]; NEXT();
+op_bit_not: r[pc->dest] = ~r[pc->a]; NEXT();
+op_eq: BINOP(x == y);
+op_neq: BINOP(x != y);
+op_lt: BINOP(x < y);
+op_gt: BINOP(x > y);
+op_le: BINOP(x <= y);
+op_ge: BINOP(x >= y);
+op_and: BINOP(x && y);
+op_or: BINOP(x || y);
+op_jump: pc = code + pc->a; DISPATCH();
+op_jump_if_false:
+    if (!r[pc->a]) { pc = code + pc->b; DISPATCH(); }
+    NEXT();
+op_loop_entry:
+    if (++prog->loop_counts[pc->a] >= prog->hot_threshold && prog->loop_hook) {
+        int next = prog->loop_hook(prog->hook_ctx, pc->a, 0, vars, r, result, &status);
+        if (next == VM_LOOP_DONE) goto done;
+        if (next != VM_LOOP_STAY) { pc = code + next; DISPATCH(); }
+    }
+    NEXT();
+op_loop_back:
+    if (++prog->loop_counts[pc->b] >= prog->osr_threshold && prog->loop_hook) {
+        int next = prog->loop_hook(prog->hook_ctx, pc->b, 1, vars, r, result, &status);
+        if (next == VM_LOOP_DONE) goto done;
+        if (next != VM_LOOP_STAY) { pc = code + next; DISPATCH(); }
+    }
+    pc = code + pc->a;
+    DISPATCH();
+op_return: *result = r[pc->a]; goto done;
+op_halt: *result = 0; goto done;
+
+#undef BINOP
+#undef NEXT
+#undef DISPATCH
+
+done:
+    free(r);
+    return status;
+#else
+    if (table_out) {
+        *table_out = NULL;
+        return VM_OK;
+    }
+    return vm_run_switch((VMProgram *)prog, vars, result);
+#endif
+}
+
+VMStatus vm_run(VMProgram *prog, int *vars, int *result) {
+    return vm_exec(prog, vars, result, NULL);
+}
+
+// Reference interpreter with a plain switch loop, kept for benchmarking the
+// threaded dispatch and for compilers without computed goto.
+VMStatus vm_run_switch(VMProgram *prog, int *vars, int *result) {
+    VMStatus status = VM_OK;
+    int *r = malloc(prog->num_regs * sizeof(int));
+    const VMInst *code = prog->code;
+    int pc = 0;
+
+    for (;;) {
+        const VMInst *inst = &code[pc++];
+#define A r[inst->a]
+#define B r[inst->b]
+        switch (inst->op) {
+            case VM_LOAD_CONST: r[inst->dest] = inst->a; break;
+            case VM_LOAD_VAR: r[inst->dest] = vars[inst->a]; break;
+            case VM_STORE_VAR: vars[inst->b] = A; break;
+            case VM_ADD: r[inst->dest] = vm_wrap_add(A, B); break;
+            case VM_SUB: r[inst->dest] = vm_wrap_sub(A, B); break;
+            case VM_MUL: r[inst->dest] = vm_wrap_mul(A, B); break;
+            case VM_DIV:
+                if (B == 0) { status = VM_ERR_DIV_ZERO; goto done; }
+                r[inst->dest] = vm_div(A, B);
+                break;
+            case VM_MOD:
+                if (B == 0) { status = VM_ERR_DIV_ZERO; goto done; }
+                r[inst->dest] = vm_mod(A, B);
+                break;
+            case VM_COPY: r[inst->dest] = A; break;
+            case VM_NEG: r[inst->dest] = vm_wrap_sub(0, A); break;
+            case VM_LOG_NOT: r[inst->dest] = !A; break;
+            case VM_BIT_NOT: r[inst->dest] = ~A; break;
+            case VM_EQ: r[inst->dest] = A == B; break;
+            case VM_NEQ: r[inst->dest] = A != B; break;
+            case VM_LT: r[inst->dest] = A < B; break;
+            case VM_GT: r[inst->dest] = A > B; break;
+            case VM_LE: r[inst->dest] = A <= B; break;
+            case VM_GE: r[inst->dest] = A >= B; break;
+            case VM_AND: r[inst->dest] = A && B; break;
+            case VM_OR: r[inst->dest] = A || B; break;
+            case VM_JUMP: pc = inst->a; break;
+            case VM_JUMP_IF_FALSE: if (!A) pc = inst->b; break;
+            case VM_LOOP_ENTRY:
+                if (++prog->loop_counts[inst->a] >= prog->hot_threshold && prog->loop_hook) {
+                    int next = prog->loop_hook(prog->hook_ctx, inst->a, 0, vars, r, result, &status);
+                    if (next == VM_LOOP_DONE) goto done;
+                    if (next != VM_LOOP_STAY) pc = next;
+                }
+                break;
+            case VM_LOOP_BACK:
+                pc = inst->a;
+                if (++prog->loop_counts[inst->b] >= prog->osr_threshold && prog->loop_hook) {
+                    int next = prog->loop_hook(prog->hook_ctx, inst->b, 1, vars, r, result, &status);
+                    if (next == VM_LOOP_DONE) goto done;
+                    if (next != VM_LOOP_STAY) pc = next;
+                }
+                break;
+            case VM_RETURN: *result = A; goto done;
+            case VM_HALT: *result = 0; goto done;
+        }
+#undef A
+#undef B
+    }
+
+done:
+    free(r);
+    return status;
+}
+
+void vm_free(VMProgram *prog) {
+    for (int i = 0; i < prog->num_vars; i++) free(prog->var_names[i]);
+    free(prog->var_names);
+    free(prog->code);
+    free(prog->loop_counts);
+    prog->code = NULL;
+    prog->var_names = NULL;
+    prog->loop_counts = NULL;
+    prog->count = prog->num_vars = prog->num_loops = 0;
+}
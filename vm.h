@@ -0,0 +1,92 @@
+#ifndef VM_H
+#define VM_H
+
+#include "ir.h"
+
+typedef enum {
+    VM_LOAD_CONST,
+    VM_LOAD_VAR,
+    VM_STORE_VAR,
+    VM_ADD,
+    VM_SUB,
+    VM_MUL,
+    VM_DIV,
+    VM_MOD,
+    VM_NEG,
+    VM_LOG_NOT,
+    VM_BIT_NOT,
+    VM_EQ,
+    VM_NEQ,
+    VM_LT,
+    VM_GT,
+    VM_LE,
+    VM_GE,
+    VM_AND,
+    VM_OR,
+    VM_JUMP,
+    VM_JUMP_IF_FALSE,
+    VM_RETURN,
+    VM_COPY,
+    VM_LOOP_ENTRY,      // a = loop; header of a marked loop, entered from outside
+    VM_LOOP_BACK,       // a = target, b = loop; back edge jumping past VM_LOOP_ENTRY
+    VM_HALT,
+    VM_OP_COUNT
+} VMOp;
+
+// Pre-decoded instruction: temps are register indices, variables are slots
+// and jump targets are instruction offsets.
+typedef struct {
+    const void *handler;    // computed-goto target, filled in by vm_compile
+    int op;
+    int dest;
+    int a;
+    int b;
+} VMInst;
+
+typedef enum {
+    VM_OK,
+    VM_ERR_DIV_ZERO
+} VMStatus;
+
+#define VM_LOOP_STAY -1     // keep interpreting the loop
+#define VM_LOOP_DONE -2     // the program ended in the hook
+
+// Called by VM_LOOP_ENTRY once the loop's header has run hot_threshold
+// times, and by VM_LOOP_BACK (with back_edge set) once it has run
+// osr_threshold times, so a loop entered only once can still leave the
+// interpreter mid-run. Either way execution is about to start the header.
+// Returns the pc to resume at, VM_LOOP_STAY, or VM_LOOP_DONE with *result
+// or *status set. vars and regs are the interpreter's own state.
+typedef int (*VMLoopHook)(void *ctx, int loop, int back_edge, int *vars, int *regs, int *result, VMStatus *status);
+
+typedef struct {
+    VMInst *code;
+    int count;
+    int num_regs;
+    int num_vars;
+    char **var_names;
+    long long *loop_counts;     // header executions per marked loop
+    int num_loops;
+    long long hot_threshold;
+    long long osr_threshold;
+    VMLoopHook loop_hook;
+    void *hook_ctx;
+} VMProgram;
+
+// Loops to instrument for tiered execution, indexed by IR label and
+// instruction. Back edges must be IR_JUMPs to their header's label.
+typedef struct {
+    const int *header_loop;             // label -> loop, -1 for other labels
+    const unsigned char *back_edge;     // instruction -> 1 for back-edge jumps
+    int num_loops;
+    int *inst_pc;                       // out, optional: instruction -> pc
+} VMLoopMarks;
+
+void vm_compile(VMProgram *prog, IRList *list);
+void vm_compile_marked(VMProgram *prog, IRList *list, const VMLoopMarks *marks);
+int vm_var_slot(VMProgram *prog, const char *name);
+VMStatus vm_run(VMProgram *prog, int *vars, int *result);
+VMStatus vm_run_switch(VMProgram *prog, int *vars, int *result);
+void vm_free(VMProgram *prog);
+
+#endif